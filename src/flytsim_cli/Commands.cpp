@@ -1,8 +1,175 @@
 #include "Commands.hpp"
 #include "Base32.hpp"
+#include "Jpeg.hpp"
+#include "Qoi.hpp"
+#include <sstream>
+#include <iomanip>
+#include <cstring>
 
 namespace cli { namespace cmd {
 
+  namespace {
+
+    //copies every tile of the delta into the image it was computed against
+    bool patchImage(Image &image, response::Image const &resImg, std::vector<std::uint8_t> const &tiles)
+    {
+      if(!resImg.tile || resImg.tile.get() <= 0 || !image.width || !image.height ||
+        image.seq != resImg.delta.get() || image.width != resImg.width || image.height != resImg.height ||
+        image.encoding != (resImg.encoding ? resImg.encoding.get() : std::string()))
+        return false;
+
+      std::size_t width = image.width, height = image.height, tile = resImg.tile.get();
+      std::size_t pixelSize = image.data.size() / (width * height);
+      std::size_t columns = (width + tile - 1) / tile;
+      std::size_t count = columns * ((height + tile - 1) / tile);
+
+      std::size_t offset = 0;
+      while(offset < tiles.size())
+      {
+        if(offset + 4 > tiles.size())
+          return false;
+        std::size_t t = (std::size_t(tiles[offset]) << 24) | (std::size_t(tiles[offset + 1]) << 16) | (std::size_t(tiles[offset + 2]) << 8) | tiles[offset + 3];
+        offset += 4;
+        if(t >= count)
+          return false;
+
+        std::size_t x = (t % columns) * tile, y = (t / columns) * tile;
+        std::size_t rowSize = std::min(tile, width - x) * pixelSize;
+        std::size_t rows = std::min(tile, height - y);
+        if(offset + rowSize * rows > tiles.size())
+          return false;
+
+        for(std::size_t r = 0; r < rows; ++r, offset += rowSize)
+          std::memcpy(image.data.data() + ((y + r) * width + x) * pixelSize, tiles.data() + offset, rowSize);
+      }
+      return true;
+    }
+
+    //arrived is when the line was read, latency gets the stages of the frame once it is delivered
+    system::error_code decodeImage(std::string const &line, double arrived, GetImage::Callback const &callback, std::shared_ptr<Image> const &delta, FrameLatency *latency)
+    {
+      response::Image resImg;
+
+      if(system::error_code pe = response::parseImage(line, resImg))
+      {
+        //nothing newer than the frame asked with since
+        response::NotModified resNotModified;
+        if(!response::parseNotModified(line, resNotModified))
+          return system::error_code();
+
+        return make_error_code(system::errc::invalid_argument);
+      }
+
+      if(callback || delta)
+      {
+        std::shared_ptr<Image> img = std::make_shared<Image>();
+        img->seq = resImg.seq ? resImg.seq.get() : 0;
+        img->stamp = resImg.stamp ? resImg.stamp.get() : 0.0;
+        img->width = resImg.width;
+        img->height = resImg.height;
+        img->encoding = resImg.encoding ? resImg.encoding.get() : std::string();
+        img->timing.received = resImg.received.get_value_or(0.0);
+        img->timing.encodeStart = resImg.encode_start.get_value_or(0.0);
+        img->timing.encodeEnd = resImg.encode_end.get_value_or(0.0);
+        img->timing.sent = resImg.sent.get_value_or(0.0);
+        img->timing.arrived = arrived;
+        img->data.resize(resImg.size);
+        if(!base32::decode(resImg.data.data(), resImg.data.size(), img->data.data(), img->data.size()))
+          return system::error_code();
+
+        if(resImg.format && resImg.format.get() == "jpeg")
+        {
+          std::vector<std::uint8_t> compressed;
+          compressed.swap(img->data);
+          if(system::error_code de = jpeg::decompress(compressed.data(), compressed.size(), *img))
+            return de;
+        }
+        else if(resImg.format && resImg.format.get() == "qoi")
+        {
+          //the encoding is kept, qoi does not reorder channels
+          std::uint32_t channels = 3;
+          if(img->encoding == "mono8")
+            channels = 1;
+          else if(img->encoding == "rgba8" || img->encoding == "bgra8")
+            channels = 4;
+
+          std::vector<std::uint8_t> compressed;
+          compressed.swap(img->data);
+          std::uint32_t width = 0, height = 0;
+          if(!qoi::decode(compressed.data(), compressed.size(), channels, img->data, width, height))
+            return make_error_code(system::errc::invalid_argument);
+          img->width = static_cast<int>(width);
+          img->height = static_cast<int>(height);
+        }
+
+        if(delta)
+        {
+          //a response without delta: is a full frame replacing the held one
+          if(!resImg.delta)
+            *delta = std::move(*img);
+          else if(!patchImage(*delta, resImg, img->data))
+          {
+            //the next request asks for a full frame
+            delta->seq = 0;
+            return make_error_code(system::errc::invalid_argument);
+          }
+          delta->seq = img->seq;
+          delta->stamp = img->stamp;
+          delta->timing = img->timing;
+          img = delta;
+        }
+        img->timing.decoded = wallTime();
+
+        //the callback sees delivered unset, it is when the callback returned
+        if(callback)
+          callback(img);
+        img->timing.delivered = wallTime();
+        if(latency)
+          latency->record(img->timing, img->stamp);
+      }
+      return system::error_code();
+    }
+
+    system::error_code readImage(std::istream &is, GetImage::Callback const &callback, std::shared_ptr<Image> const &delta, FrameLatency *latency)
+    {
+      std::string line;
+      if(system::error_code rle = Command::readLine(is, line))
+        return rle;
+
+      return decodeImage(line, wallTime(), callback, delta, latency);
+    }
+
+    void writeImageParams(std::ostream &os, ImageParams const &image)
+    {
+      if(image.width)
+      {
+        os << " width:" << image.width.get();
+      }
+      if(image.height)
+      {
+        os << " height:" << image.height.get();
+      }
+      if(image.roi)
+      {
+        Roi const &roi = image.roi.get();
+        os << " roi:{" << roi.x << "," << roi.y << "," << roi.w << "," << roi.h << "}";
+      }
+      if(image.encoding)
+      {
+        os << " encoding:" << image.encoding.get();
+      }
+      if(image.format)
+      {
+        os << " format:" << image.format.get();
+      }
+      if(image.quality)
+      {
+        os << " quality:" << image.quality.get();
+      }
+    }
+
+  } //namespace anonymous
+
   Command::Command()
     : m_ResponseResult()
   {
@@ -39,6 +206,11 @@ namespace cli { namespace cmd {
     if(system::error_code rle = readLine(is, line))
       return rle;
 
+    return parseResponseResult(line);
+  }
+
+  system::error_code Command::parseResponseResult(std::string const &line)
+  {
     if(system::error_code pe = response::parseResult(line, m_ResponseResult))
     {
       return make_error_code(system::errc::invalid_argument);
@@ -58,6 +230,27 @@ namespace cli { namespace cmd {
 
   }
 
+  std::string Command::subscribesTopic() const
+  {
+    return std::string();
+  }
+
+  std::string Command::unsubscribesTopic() const
+  {
+    return std::string();
+  }
+
+  system::error_code Command::readPushData(std::istream &is)
+  {
+    std::string line;
+    return readLine(is, line);
+  }
+
+  bool Command::succeeded() const
+  {
+    return m_ResponseResult.result == 0;
+  }
+
   Arm::Arm()
     : Command()
   {
@@ -152,48 +345,272 @@ namespace cli { namespace cmd {
     return system::error_code();
   }
 
-  GetImage::GetImage(Callback callback)
+  GetImage::GetImage(Callback callback, optional<std::uint64_t> since, optional<std::uint32_t> timeout)
     : Command()
     , callback(callback)
+    , since(since)
+    , timeout(timeout)
+    , seq()
+    , stamp()
+    , delta()
+    , latency()
+    , image()
   {
 
   }
 
   system::error_code GetImage::writeRequest(std::ostream &os)
   {
-    os << "get_image\r\n";
+    os << "get_image";
+    if(since)
+    {
+      os << " since:" << since.get();
+    }
+    if(timeout)
+    {
+      os << " timeout:" << timeout.get();
+    }
+    if(seq)
+    {
+      os << " seq:" << seq.get();
+    }
+    if(stamp)
+    {
+      //formatted aside, the request stream keeps its default float format
+      std::ostringstream oss;
+      oss << std::fixed << std::setprecision(9) << stamp.get();
+      os << " stamp:" << oss.str();
+    }
+    //in the order of the server grammar
+    if(delta)
+    {
+      os << " delta:" << delta->seq;
+    }
+    writeImageParams(os, image);
+    os << "\r\n";
     os.flush();
     return system::error_code();
   }
 
   system::error_code GetImage::readResponseData(std::istream &is)
+  {
+    return readImage(is, callback, delta, latency.get());
+  }
+
+  GetImages::GetImages(Callback callback, std::vector<std::uint32_t> cameras)
+    : Command()
+    , callback(callback)
+    , cameras(cameras)
+    , latency()
+    , image()
+  {
+
+  }
+
+  system::error_code GetImages::writeRequest(std::ostream &os)
+  {
+    os << "get_images cameras:[";
+    for(std::size_t i = 0; i < cameras.size(); ++i)
+    {
+      if(i)
+        os << ",";
+      os << cameras[i];
+    }
+    os << "]";
+    writeImageParams(os, image);
+    os << "\r\n";
+    os.flush();
+    return system::error_code();
+  }
+
+  system::error_code GetImages::readResponseData(std::istream &is)
   {
     std::string line;
-    if(system::error_code rle = readLine(is, line))
+    if(system::error_code rle = Command::readLine(is, line))
       return rle;
 
-    response::Image resImg;
+    response::Images resImages;
+    if(system::error_code pe = response::parseImages(line, resImages))
+      return pe;
 
-    if(system::error_code pe = response::parseImage(line, resImg))
+    //every image line is read even without a callback to keep the stream in sync
+    std::vector< std::shared_ptr<Image> > images;
+    images.reserve(resImages.count);
+    GetImage::Callback collect = [&images](std::shared_ptr<Image> img) { images.push_back(img); };
+    for(std::uint32_t i = 0; i < resImages.count; ++i)
     {
-      return make_error_code(system::errc::invalid_argument);
+      if(system::error_code rie = readImage(is, collect, std::shared_ptr<Image>(), latency.get()))
+        return rie;
     }
 
+    if(images.size() != resImages.count)
+      return make_error_code(system::errc::invalid_argument);
+
     if(callback)
+      callback(images, resImages.skew);
+    return system::error_code();
+  }
+
+  SubscribeImage::SubscribeImage(Callback callback, optional<float> max_fps, optional<std::uint32_t> queue, optional<bool> keep_latest)
+    : Command()
+    , callback(callback)
+    , max_fps(max_fps)
+    , queue(queue)
+    , keep_latest(keep_latest)
+    , adaptive()
+    , target_latency()
+    , adaptiveCallback()
+    , latency()
+    , image()
+  {
+  }
+
+  system::error_code SubscribeImage::writeRequest(std::ostream &os)
+  {
+    os << "subscribe_image";
+    if(max_fps)
+    {
+      os << " max_fps:" << max_fps.get();
+    }
+    if(queue)
+    {
+      os << " queue:" << queue.get();
+    }
+    if(keep_latest)
+    {
+      os << " keep_latest:" << (keep_latest.get() ? "true" : "false");
+    }
+    if(adaptive)
+    {
+      os << " adaptive:" << (adaptive.get() ? "true" : "false");
+    }
+    if(target_latency)
+    {
+      os << " target_latency:" << target_latency.get();
+    }
+    writeImageParams(os, image);
+    os << "\r\n";
+    os.flush();
+    return system::error_code();
+  }
+
+  std::string SubscribeImage::subscribesTopic() const
+  {
+    return "image";
+  }
+
+  system::error_code SubscribeImage::readPushData(std::istream &is)
+  {
+    std::string line;
+    if(system::error_code rle = Command::readLine(is, line))
+      return rle;
+    double arrived = wallTime();
+
+    //the operating point is pushed in order with the frames it applies to
+    response::Adaptive resAdaptive;
+    if(!response::parseAdaptive(line, resAdaptive))
     {
-      std::shared_ptr<Image> img = std::make_shared<Image>();
-      img->width = resImg.width;
-      img->height = resImg.height;
-      img->data.resize(resImg.size);
-      std::istringstream iss(resImg.data);
-      if(base32::decode(img->data.data(), img->data.size(), iss))
+      if(adaptiveCallback)
       {
-        callback(img);
+        OperatingPoint point;
+        point.level = resAdaptive.level;
+        point.width = resAdaptive.width;
+        point.height = resAdaptive.height;
+        point.format = resAdaptive.format;
+        point.quality = resAdaptive.quality;
+        point.max_fps = resAdaptive.max_fps;
+        point.goodput = resAdaptive.goodput;
+        point.delay = resAdaptive.delay;
+        adaptiveCallback(point);
       }
+      return system::error_code();
+    }
+
+    return decodeImage(line, arrived, callback, std::shared_ptr<Image>(), latency.get());
+  }
+
+  UnsubscribeImage::UnsubscribeImage()
+    : Command()
+  {
+  }
+
+  system::error_code UnsubscribeImage::writeRequest(std::ostream &os)
+  {
+    os << "unsubscribe_image\r\n";
+    os.flush();
+    return system::error_code();
+  }
+
+  std::string UnsubscribeImage::unsubscribesTopic() const
+  {
+    return "image";
+  }
+
+  SubscribeTelemetry::SubscribeTelemetry(Callback callback, std::vector<std::string> topics, optional<float> rate)
+    : Command()
+    , callback(callback)
+    , topics(topics)
+    , rate(rate)
+  {
+
+  }
+
+  system::error_code SubscribeTelemetry::writeRequest(std::ostream &os)
+  {
+    os << "subscribe_telemetry topics:[";
+    for(std::size_t i = 0; i < topics.size(); ++i)
+    {
+      if(i)
+        os << ",";
+      os << topics[i];
     }
+    os << "]";
+    if(rate)
+    {
+      os << " rate:" << rate.get();
+    }
+    os << "\r\n";
+    os.flush();
+    return system::error_code();
+  }
+
+  std::string SubscribeTelemetry::subscribesTopic() const
+  {
+    return "telemetry";
+  }
+
+  system::error_code SubscribeTelemetry::readPushData(std::istream &is)
+  {
+    std::string line;
+    if(system::error_code rle = Command::readLine(is, line))
+      return rle;
+
+    Telemetry telemetry;
+    if(system::error_code pe = response::parseTelemetry(line, telemetry))
+      return pe;
+
+    if(callback)
+      callback(telemetry);
     return system::error_code();
   }
-  
+
+  UnsubscribeTelemetry::UnsubscribeTelemetry()
+    : Command()
+  {
+  }
+
+  system::error_code UnsubscribeTelemetry::writeRequest(std::ostream &os)
+  {
+    os << "unsubscribe_telemetry\r\n";
+    os.flush();
+    return system::error_code();
+  }
+
+  std::string UnsubscribeTelemetry::unsubscribesTopic() const
+  {
+    return "telemetry";
+  }
+
 
 } //namespace cmd
 } //namespace cli
\ No newline at end of file
@@ -4,9 +4,26 @@
 #include "Config.hpp"
 #include "ResponseParser.hpp"
 #include "Image.hpp"
+#include "Latency.hpp"
 
 namespace cli { namespace cmd {
 
+  struct Roi
+  {
+    std::uint32_t x, y, w, h;
+  };
+
+  //asks the server to crop the region first and then scale it, a missing width or height keeps the aspect ratio
+  struct ImageParams
+  {
+    optional<std::uint32_t> width;
+    optional<std::uint32_t> height;
+    optional<Roi> roi;
+    optional<std::string> encoding;   //mono8, rgb8, bgr8 or yuv420
+    optional<std::string> format;     //raw, jpeg or qoi, compressed images are decoded before the callback
+    optional<std::uint32_t> quality;  //jpeg quality 1 to 100
+  };
+
   class Command
   {
   public:
@@ -17,9 +34,17 @@ namespace cli { namespace cmd {
 
     virtual system::error_code writeRequest(std::ostream &os) = 0;
     virtual system::error_code readResponseResult(std::istream &is);
+    virtual system::error_code parseResponseResult(std::string const &line);
     virtual system::error_code readResponseData(std::istream &is);
     virtual void handleIOError(system::error_code ioe);
 
+    //after a successful response a subscription receives every "push:<topic>" message
+    virtual std::string subscribesTopic() const;
+    virtual std::string unsubscribesTopic() const;
+    virtual system::error_code readPushData(std::istream &is);
+
+    bool succeeded() const;
+
   protected:
     response::Result m_ResponseResult;
   };
@@ -96,12 +121,120 @@ namespace cli { namespace cmd {
   public:
     typedef std::function<void(std::shared_ptr<Image>)> Callback;
 
-    GetImage(Callback callback);
+    //with since the callback is only called for a newer frame, the server waits up to timeout milliseconds for it
+    GetImage(Callback callback, optional<std::uint64_t> since = optional<std::uint64_t>(), optional<std::uint32_t> timeout = optional<std::uint32_t>());
 
     system::error_code writeRequest(std::ostream &os);
     system::error_code readResponseData(std::istream &is);
 
     Callback callback;
+    optional<std::uint64_t> since;
+    optional<std::uint32_t> timeout;
+    optional<std::uint64_t> seq;    //a frame from the server history
+    optional<double> stamp;         //the history frame closest to the stamp in seconds
+    std::shared_ptr<Image> delta;   //the image last received, the server only sends the tiles changed since and it is patched in place
+    std::shared_ptr<FrameLatency> latency;   //gets the stages of every image received, shared by commands to aggregate them
+    ImageParams image;
+  };
+
+  class GetImages
+    : public Command
+  {
+  public:
+    //the images are in the order of the cameras, skew is the seconds between their oldest and newest stamps
+    typedef std::function<void(std::vector< std::shared_ptr<Image> > const &, double)> Callback;
+
+    GetImages(Callback callback, std::vector<std::uint32_t> cameras);
+
+    system::error_code writeRequest(std::ostream &os);
+    system::error_code readResponseData(std::istream &is);
+
+    Callback callback;
+    std::vector<std::uint32_t> cameras;
+    std::shared_ptr<FrameLatency> latency;
+    ImageParams image;
+  };
+
+  //size, format and rate an adaptive subscription switched to
+  struct OperatingPoint
+  {
+    int level;                        //0 is the subscribed params, higher levels cost less bandwidth
+    optional<int> width;
+    optional<int> height;
+    std::string format;
+    optional<std::uint32_t> quality;
+    optional<float> max_fps;
+    double goodput;                   //bytes per second, 0 until the link was the bottleneck
+    double delay;                     //milliseconds a command waits behind pushed frames
+  };
+
+  class SubscribeImage
+    : public Command
+  {
+  public:
+    typedef GetImage::Callback Callback;
+    typedef std::function<void(OperatingPoint const &)> AdaptiveCallback;
+
+    SubscribeImage(
+      Callback callback,
+      optional<float> max_fps = optional<float>(),
+      optional<std::uint32_t> queue = optional<std::uint32_t>(),
+      optional<bool> keep_latest = optional<bool>()
+    );
+
+    system::error_code writeRequest(std::ostream &os);
+    std::string subscribesTopic() const;
+    system::error_code readPushData(std::istream &is);
+
+    Callback callback;
+    optional<float> max_fps;
+    optional<std::uint32_t> queue;
+    optional<bool> keep_latest;
+    optional<bool> adaptive;                  //the server lowers size, quality and rate to keep commands responsive
+    optional<std::uint32_t> target_latency;   //milliseconds
+    AdaptiveCallback adaptiveCallback;        //called when the server changes the operating point
+    std::shared_ptr<FrameLatency> latency;
+    ImageParams image;
+  };
+
+  class UnsubscribeImage
+    : public Command
+  {
+  public:
+    UnsubscribeImage();
+
+    system::error_code writeRequest(std::ostream &os);
+    std::string unsubscribesTopic() const;
+  };
+
+  typedef response::Telemetry Telemetry;
+
+  class SubscribeTelemetry
+    : public Command
+  {
+  public:
+    typedef std::function<void(Telemetry const &)> Callback;
+
+    //topics are position, attitude, imu, battery and global, rate limits the updates per second of each
+    SubscribeTelemetry(Callback callback, std::vector<std::string> topics, optional<float> rate = optional<float>());
+
+    system::error_code writeRequest(std::ostream &os);
+    std::string subscribesTopic() const;
+    system::error_code readPushData(std::istream &is);
+
+    Callback callback;
+    std::vector<std::string> topics;
+    optional<float> rate;
+  };
+
+  class UnsubscribeTelemetry
+    : public Command
+  {
+  public:
+    UnsubscribeTelemetry();
+
+    system::error_code writeRequest(std::ostream &os);
+    std::string unsubscribesTopic() const;
   };
 
 } //namespace cmd
@@ -6,6 +6,7 @@
 #include <thread>
 #include <mutex>
 #include <deque>
+#include <map>
 
 
 #include <boost/atomic.hpp>
@@ -9,13 +9,17 @@ namespace cli {
     : m_Socket(Service::instance().ios())
     , m_GetBuffer()
     , m_PutBuffer()
-    , m_Stream(this)
+    , m_InputStream(this)
+    , m_OutputStream(this)
     , m_ProcessCommands(false)
     , m_ProcessCommandsStrand(Service::instance().ios())
     , m_ProcessCommandsYieldContext(nullptr)
+    , m_ProcessResponsesYieldContext(nullptr)
     , m_CommandsBufferMutex()
     , m_CommandsBufferDeque()
+    , m_AwaitingResponseDeque()
     , m_CommandsBufferSignal(Service::instance().ios())
+    , m_Subscriptions()
   {
     initBuffers();
   }
@@ -74,11 +78,21 @@ namespace cli {
     return system::error_code();
   }
 
+  std::size_t Connection::pendingCommandsCount()
+  {
+    std::lock_guard<std::mutex> lock(m_CommandsBufferMutex);
+    return m_CommandsBufferDeque.size() + m_AwaitingResponseDeque.size();
+  }
+
   void Connection::startProcessingCommands()
   {
     system::error_code err;
     m_CommandsBufferSignal.expires_at(asio::steady_timer::time_point::max(), err);
     m_CommandsBufferDeque.clear();
+    m_AwaitingResponseDeque.clear();
+    m_Subscriptions.clear();
+    m_InputStream.clear();
+    m_OutputStream.clear();
 
     m_ProcessCommands = true;
     asio::spawn(
@@ -89,6 +103,14 @@ namespace cli {
         std::placeholders::_1
       )
     );
+    asio::spawn(
+      m_ProcessCommandsStrand,
+      std::bind(
+        &Connection::processResponses,
+        shared_from_this(),
+        std::placeholders::_1
+      )
+    );
   }
 
   void Connection::stopProcessingCommands()
@@ -96,7 +118,7 @@ namespace cli {
     m_ProcessCommands = false;
     system::error_code err;
     m_CommandsBufferSignal.cancel(err);
-    while(m_ProcessCommandsYieldContext)
+    while(m_ProcessCommandsYieldContext || m_ProcessResponsesYieldContext)
       std::this_thread::yield();
   }
 
@@ -122,16 +144,13 @@ namespace cli {
             else
             {
               command = m_CommandsBufferDeque.front();
+              m_CommandsBufferDeque.pop_front();
+              m_AwaitingResponseDeque.push_back(command);
             }
           }
 
-          //here handle the command
-          command->writeRequest(m_Stream);
-          command->readResponseResult(m_Stream);
-          command->readResponseData(m_Stream);
-          
-          std::lock_guard<std::mutex> lock(m_CommandsBufferMutex);
-          m_CommandsBufferDeque.pop_front();
+          //the response is picked up by processResponses
+          command->writeRequest(m_OutputStream);
         }
       }
 
@@ -141,9 +160,69 @@ namespace cli {
     m_ProcessCommandsYieldContext = nullptr;
   }
 
+  void Connection::processResponses(asio::yield_context yctx)
+  {
+    static std::string const pushPrefix = "push:";
+
+    m_ProcessResponsesYieldContext = &yctx;
+    while(m_ProcessCommands)
+    {
+      std::string line;
+      if(system::error_code rle = readLine(line))
+        break;
+
+      if(line.compare(0, pushPrefix.size(), pushPrefix) == 0)
+      {
+        std::map< std::string, std::shared_ptr<cmd::Command> >::iterator subscription =
+          m_Subscriptions.find(line.substr(pushPrefix.size()));
+
+        if(subscription != m_Subscriptions.end())
+        {
+          subscription->second->readPushData(m_InputStream);
+        }
+        else
+        {
+          std::string data;
+          readLine(data);
+        }
+        continue;
+      }
+
+      std::shared_ptr<cmd::Command> command;
+      {
+        std::lock_guard<std::mutex> lock(m_CommandsBufferMutex);
+        if(m_AwaitingResponseDeque.empty())
+          continue;
+        command = m_AwaitingResponseDeque.front();
+      }
+
+      command->parseResponseResult(line);
+      command->readResponseData(m_InputStream);
+      updateSubscriptions(command);
+
+      std::lock_guard<std::mutex> lock(m_CommandsBufferMutex);
+      m_AwaitingResponseDeque.pop_front();
+    }
+    m_ProcessResponsesYieldContext = nullptr;
+  }
+
+  void Connection::updateSubscriptions(std::shared_ptr<cmd::Command> const &command)
+  {
+    if(!command->succeeded())
+      return;
+
+    std::string subscribes = command->subscribesTopic();
+    if(!subscribes.empty())
+      m_Subscriptions[subscribes] = command;
+
+    std::string unsubscribes = command->unsubscribesTopic();
+    if(!unsubscribes.empty())
+      m_Subscriptions.erase(unsubscribes);
+  }
+
   system::error_code Connection::readLine(std::string &line)
   {
-    return cmd::Command::readLine(m_Stream, line);
+    return cmd::Command::readLine(m_InputStream, line);
   }
 
   void Connection::initBuffers()
@@ -154,7 +233,7 @@ namespace cli {
 
   Connection::int_type Connection::underflow()
   {
-    BOOST_ASSERT(m_ProcessCommandsYieldContext);
+    BOOST_ASSERT(m_ProcessResponsesYieldContext);
     if(!m_ProcessCommands)
       return traits_type::eof();
 
@@ -163,7 +242,7 @@ namespace cli {
       system::error_code err;
       std::size_t bytes = m_Socket.async_read_some(
         asio::buffer(asio::buffer(m_GetBuffer) + PUTBACK_MAX),
-        (*m_ProcessCommandsYieldContext)[err]
+        (*m_ProcessResponsesYieldContext)[err]
       );
 
       if(err)
@@ -26,7 +26,7 @@ namespace cli {
 
     
     system::error_code asyncSendCommand(std::shared_ptr<cmd::Command> command);
-    std::size_t pendingCommandsCount() { return m_CommandsBufferDeque.size(); }
+    std::size_t pendingCommandsCount();
     /*void asyncArm(CommandHandler handler = CommandHandler());
     void asyncDisarm(CommandHandler handler = CommandHandler());
     void asyncTakeOff(float altitude, CommandHandler handler = CommandHandler());
@@ -37,7 +37,11 @@ namespace cli {
   private:
     void startProcessingCommands();
     void stopProcessingCommands();
+
+    //requests are written by one coroutine while another reads responses and pushes
     void processCommands(asio::yield_context yctx);
+    void processResponses(asio::yield_context yctx);
+    void updateSubscriptions(std::shared_ptr<cmd::Command> const &command);
     
 
     //void handleWriteCommandRequest(CommandHandler handler, system::error_code const &e, std::size_t bytes);
@@ -62,15 +66,20 @@ namespace cli {
     asio::detail::array<char, BUFFER_SIZE> m_GetBuffer;
     asio::detail::array<char, BUFFER_SIZE> m_PutBuffer;
 
-    std::iostream m_Stream;
+    std::istream m_InputStream;
+    std::ostream m_OutputStream;
 
     bool m_ProcessCommands;
     asio::strand m_ProcessCommandsStrand;
     asio::yield_context *m_ProcessCommandsYieldContext;
+    asio::yield_context *m_ProcessResponsesYieldContext;
 
     std::mutex m_CommandsBufferMutex;
     std::deque< std::shared_ptr<cmd::Command> > m_CommandsBufferDeque;
+    std::deque< std::shared_ptr<cmd::Command> > m_AwaitingResponseDeque;
     asio::steady_timer m_CommandsBufferSignal;
+
+    std::map< std::string, std::shared_ptr<cmd::Command> > m_Subscriptions;
   };
   
 } //namespace cli
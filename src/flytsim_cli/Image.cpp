@@ -2,9 +2,24 @@
 
 namespace cli {
 
+  FrameTiming::FrameTiming()
+    : received(0.0)
+    , encodeStart(0.0)
+    , encodeEnd(0.0)
+    , sent(0.0)
+    , arrived(0.0)
+    , decoded(0.0)
+    , delivered(0.0)
+  {
+  }
+
   Image::Image()
-    : width(0)
+    : seq(0)
+    , stamp(0.0)
+    , timing()
+    , width(0)
     , height(0)
+    , encoding()
     , data()
   {
   }
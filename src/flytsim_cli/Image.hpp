@@ -5,13 +5,31 @@
 
 namespace cli {
 
+  //wall clock seconds of a frame on its way to the client, 0 when not known
+  struct FrameTiming
+  {
+    FrameTiming();
+
+    double received;      //the server got the frame from ROS
+    double encodeStart;
+    double encodeEnd;     //the response body was ready
+    double sent;          //the server started writing the response
+    double arrived;       //the client read the response
+    double decoded;       //the pixels were ready
+    double delivered;     //the callback returned
+  };
+
   class Image
   {
   public:
     Image();
   
+    std::uint64_t seq;    //0 if the server does not number frames
+    double stamp;         //ROS header stamp in seconds
+    FrameTiming timing;
     int width;
     int height;
+    std::string encoding; //ROS encoding or yuv420, empty if the server does not send it
     std::vector<std::uint8_t> data;
   };
 
@@ -0,0 +1,83 @@
+#include "Jpeg.hpp"
+#include <csetjmp>
+#include <cstdio>
+#include <jpeglib.h>
+
+namespace cli { namespace jpeg {
+
+namespace {
+
+	//libjpeg exits the process on errors unless the handler jumps out
+	struct ErrorManager
+	{
+		jpeg_error_mgr base;
+		std::jmp_buf jump;
+	};
+
+	void onError(j_common_ptr cinfo)
+	{
+		std::longjmp(reinterpret_cast<ErrorManager *>(cinfo->err)->jump, 1);
+	}
+
+	void onMessage(j_common_ptr)
+	{
+	}
+
+} //namespace anonymous
+
+system::error_code decompress(std::uint8_t const *data, std::size_t size, Image &image)
+{
+	//alpha does not survive the compression, without libjpeg-turbo extensions color comes out as rgb
+#ifdef JCS_EXTENSIONS
+	J_COLOR_SPACE space = JCS_EXT_BGR;
+	std::string encoding = "bgr8";
+#else
+	J_COLOR_SPACE space = JCS_RGB;
+	std::string encoding = "rgb8";
+#endif
+	if(image.encoding == "mono8")
+	{
+		space = JCS_GRAYSCALE;
+		encoding = "mono8";
+	}
+	else if(image.encoding == "rgb8" || image.encoding == "rgba8")
+	{
+		space = JCS_RGB;
+		encoding = "rgb8";
+	}
+
+	jpeg_decompress_struct cinfo;
+	ErrorManager errors;
+	cinfo.err = jpeg_std_error(&errors.base);
+	errors.base.error_exit = &onError;
+	errors.base.output_message = &onMessage;
+	if(setjmp(errors.jump))
+	{
+		jpeg_destroy_decompress(&cinfo);
+		return make_error_code(system::errc::invalid_argument);
+	}
+
+	jpeg_create_decompress(&cinfo);
+	jpeg_mem_src(&cinfo, const_cast<unsigned char *>(data), static_cast<unsigned long>(size));
+	jpeg_read_header(&cinfo, TRUE);
+	cinfo.out_color_space = space;
+	jpeg_start_decompress(&cinfo);
+
+	std::size_t step = std::size_t(cinfo.output_width) * cinfo.output_components;
+	image.width = static_cast<int>(cinfo.output_width);
+	image.height = static_cast<int>(cinfo.output_height);
+	image.encoding = encoding;
+	image.data.resize(step * cinfo.output_height);
+	while(cinfo.output_scanline < cinfo.output_height)
+	{
+		JSAMPROW row = image.data.data() + std::size_t(cinfo.output_scanline) * step;
+		jpeg_read_scanlines(&cinfo, &row, 1);
+	}
+
+	jpeg_finish_decompress(&cinfo);
+	jpeg_destroy_decompress(&cinfo);
+	return system::error_code();
+}
+
+} //namespace jpeg
+} //namespace cli
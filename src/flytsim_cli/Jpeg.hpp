@@ -0,0 +1,15 @@
+#ifndef JPEG_HPP
+#define JPEG_HPP
+
+#include "Config.hpp"
+#include "Image.hpp"
+
+namespace cli { namespace jpeg {
+
+	//image.encoding is the one the server compressed, it becomes mono8, rgb8 or bgr8
+	extern system::error_code decompress(std::uint8_t const *data, std::size_t size, Image &image);
+
+} //namespace jpeg
+} //namespace cli
+
+#endif //JPEG_HPP
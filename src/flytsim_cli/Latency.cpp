@@ -0,0 +1,135 @@
+#include "Latency.hpp"
+#include <chrono>
+
+namespace cli {
+
+  double wallTime()
+  {
+    return std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+  }
+
+  LatencyHistogram::LatencyHistogram()
+    : m_Buckets()
+    , m_Count(0)
+    , m_TotalUs(0)
+    , m_MaxUs(0)
+  {
+    reset();
+  }
+
+  void LatencyHistogram::record(double seconds)
+  {
+    //clocks of different hosts may put a stage below zero
+    std::uint64_t us = seconds > 0.0 ? static_cast<std::uint64_t>(seconds * 1e6) : 0;
+    std::size_t index = 0;
+    while(index < BUCKETS - 1 && (std::uint64_t(1) << index) <= us)
+      ++index;
+
+    m_Buckets[index].fetch_add(1, boost::memory_order_relaxed);
+    m_Count.fetch_add(1, boost::memory_order_relaxed);
+    m_TotalUs.fetch_add(us, boost::memory_order_relaxed);
+
+    std::uint64_t max = m_MaxUs.load(boost::memory_order_relaxed);
+    while(us > max && !m_MaxUs.compare_exchange_weak(max, us, boost::memory_order_relaxed))
+    {
+    }
+  }
+
+  void LatencyHistogram::reset()
+  {
+    for(std::size_t b = 0; b < BUCKETS; ++b)
+      m_Buckets[b].store(0, boost::memory_order_relaxed);
+    m_Count.store(0, boost::memory_order_relaxed);
+    m_TotalUs.store(0, boost::memory_order_relaxed);
+    m_MaxUs.store(0, boost::memory_order_relaxed);
+  }
+
+  std::uint64_t LatencyHistogram::count() const
+  {
+    return m_Count.load(boost::memory_order_relaxed);
+  }
+
+  std::uint64_t LatencyHistogram::bucket(std::size_t index) const
+  {
+    return m_Buckets[index].load(boost::memory_order_relaxed);
+  }
+
+  double LatencyHistogram::mean() const
+  {
+    std::uint64_t count = m_Count.load(boost::memory_order_relaxed);
+    return count ? m_TotalUs.load(boost::memory_order_relaxed) * 1e-6 / count : 0.0;
+  }
+
+  double LatencyHistogram::max() const
+  {
+    return m_MaxUs.load(boost::memory_order_relaxed) * 1e-6;
+  }
+
+  double LatencyHistogram::percentile(double fraction) const
+  {
+    std::uint64_t counts[BUCKETS];
+    std::uint64_t total = 0;
+    for(std::size_t b = 0; b < BUCKETS; ++b)
+    {
+      counts[b] = m_Buckets[b].load(boost::memory_order_relaxed);
+      total += counts[b];
+    }
+    if(!total)
+      return 0.0;
+
+    std::uint64_t rank = static_cast<std::uint64_t>(fraction * total);
+    std::uint64_t seen = 0;
+    for(std::size_t b = 0; b < BUCKETS; ++b)
+    {
+      seen += counts[b];
+      if(seen > rank)
+        return (std::uint64_t(1) << b) * 1e-6;
+    }
+    return max();
+  }
+
+  FrameLatency::FrameLatency()
+    : m_Histograms()
+  {
+  }
+
+  char const* FrameLatency::stageName(Stage stage)
+  {
+    switch(stage)
+    {
+    case CAMERA: return "camera";
+    case QUEUE: return "queue";
+    case ENCODE: return "encode";
+    case SEND: return "send";
+    case NETWORK: return "network";
+    case DECODE: return "decode";
+    case DELIVERY: return "delivery";
+    case TOTAL: return "total";
+    default: return "unknown";
+    }
+  }
+
+  void FrameLatency::record(FrameTiming const &timing, double stamp)
+  {
+    double const times[] = { stamp, timing.received, timing.encodeStart, timing.encodeEnd, timing.sent, timing.arrived, timing.decoded, timing.delivered };
+    for(int s = CAMERA; s < TOTAL; ++s)
+    {
+      if(times[s] > 0.0 && times[s + 1] > 0.0)
+        m_Histograms[s].record(times[s + 1] - times[s]);
+    }
+    if(timing.received > 0.0 && timing.delivered > 0.0)
+      m_Histograms[TOTAL].record(timing.delivered - timing.received);
+  }
+
+  void FrameLatency::reset()
+  {
+    for(int s = 0; s < STAGES; ++s)
+      m_Histograms[s].reset();
+  }
+
+  LatencyHistogram const& FrameLatency::histogram(Stage stage) const
+  {
+    return m_Histograms[stage];
+  }
+
+} //namespace cli
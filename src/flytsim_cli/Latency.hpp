@@ -0,0 +1,71 @@
+#ifndef LATENCY_HPP
+#define LATENCY_HPP
+
+#include "Config.hpp"
+#include "Image.hpp"
+
+namespace cli {
+
+  //seconds since the epoch on the wall clock, the server stamps frames on the same clock
+  extern double wallTime();
+
+  //latencies counted in power of two microsecond buckets, recorded and read from any thread
+  class LatencyHistogram
+  {
+  public:
+    enum { BUCKETS = 32 };
+
+    LatencyHistogram();
+
+    void record(double seconds);
+    void reset();
+
+    std::uint64_t count() const;
+    //latencies below 2^index microseconds and not below the previous bucket
+    std::uint64_t bucket(std::size_t index) const;
+    double mean() const;
+    double max() const;
+    //upper bound in seconds of the bucket holding the fraction of the latencies, 0 without any
+    double percentile(double fraction) const;
+
+  private:
+    atomic<std::uint64_t> m_Buckets[BUCKETS];
+    atomic<std::uint64_t> m_Count;
+    atomic<std::uint64_t> m_TotalUs;
+    atomic<std::uint64_t> m_MaxUs;
+  };
+
+  //where the time of a frame went between the camera and the callback
+  class FrameLatency
+  {
+  public:
+    enum Stage
+    {
+      CAMERA,       //ROS stamp to server receive, meaningful when ROS time is wall time
+      QUEUE,        //server receive to encode start
+      ENCODE,       //transform, compress and serialize
+      SEND,         //encode end to the server writing the response
+      NETWORK,      //server write to client read, includes the offset between the clocks
+      DECODE,
+      DELIVERY,     //decoded to the callback returning
+      TOTAL,        //server receive to the callback
+      STAGES
+    };
+
+    FrameLatency();
+
+    static char const* stageName(Stage stage);
+
+    //stages missing either time are not recorded
+    void record(FrameTiming const &timing, double stamp);
+    void reset();
+
+    LatencyHistogram const& histogram(Stage stage) const;
+
+  private:
+    LatencyHistogram m_Histograms[STAGES];
+  };
+
+} //namespace cli
+
+#endif //LATENCY_HPP
@@ -0,0 +1,149 @@
+#include "Qoi.hpp"
+#include <cstring>
+
+namespace cli { namespace qoi {
+
+namespace {
+
+	std::uint8_t const OP_INDEX = 0x00;
+	std::uint8_t const OP_DIFF = 0x40;
+	std::uint8_t const OP_LUMA = 0x80;
+	std::uint8_t const OP_RGB = 0xfe;
+	std::uint8_t const OP_RGBA = 0xff;
+	std::uint8_t const MASK = 0xc0;
+
+	std::size_t const HEADER_SIZE = 14;
+	std::size_t const PADDING_SIZE = 8;
+
+	//larger images are rejected by the decoder, as by the reference one
+	std::uint64_t const MAX_PIXELS = 400000000;
+
+	//r, g, b and a packed from the low byte up
+	typedef std::uint32_t Pixel;
+
+	inline Pixel pack(std::uint32_t r, std::uint32_t g, std::uint32_t b, std::uint32_t a)
+	{
+		return r | (g << 8) | (b << 16) | (a << 24);
+	}
+
+	inline std::uint32_t channel(Pixel px, int c)
+	{
+		return (px >> (8 * c)) & 0xff;
+	}
+
+	inline std::uint32_t hash(Pixel px)
+	{
+		return (channel(px, 0) * 3 + channel(px, 1) * 5 + channel(px, 2) * 7 + channel(px, 3) * 11) % 64;
+	}
+
+	inline std::uint32_t read32(std::uint8_t const *in)
+	{
+		return (std::uint32_t(in[0]) << 24) | (std::uint32_t(in[1]) << 16) | (std::uint32_t(in[2]) << 8) | in[3];
+	}
+
+	template <std::uint32_t Channels>
+	inline void store(std::uint8_t *p, Pixel px)
+	{
+		p[0] = static_cast<std::uint8_t>(channel(px, 0));
+		if(Channels == 1)
+			return;
+		p[1] = static_cast<std::uint8_t>(channel(px, 1));
+		p[2] = static_cast<std::uint8_t>(channel(px, 2));
+		if(Channels == 4)
+			p[3] = static_cast<std::uint8_t>(channel(px, 3));
+	}
+
+	//the stream ends with 8 bytes of padding, an op never reads past them
+	template <std::uint32_t Channels>
+	bool decodePixels(std::uint8_t const *in, std::uint8_t const *end, std::uint8_t *out, std::size_t count)
+	{
+		Pixel index[64] = {};
+		Pixel px = pack(0, 0, 0, 255);
+		std::uint32_t run = 0;
+
+		for(std::size_t i = 0; i < count; ++i, out += Channels)
+		{
+			if(run)
+			{
+				--run;
+			}
+			else if(in < end)
+			{
+				std::uint8_t op = *in++;
+				if(op == OP_RGB)
+				{
+					px = pack(in[0], in[1], in[2], channel(px, 3));
+					in += 3;
+				}
+				else if(op == OP_RGBA)
+				{
+					px = pack(in[0], in[1], in[2], in[3]);
+					in += 4;
+				}
+				else if((op & MASK) == OP_INDEX)
+				{
+					px = index[op];
+				}
+				else if((op & MASK) == OP_DIFF)
+				{
+					px = pack(
+						(channel(px, 0) + ((op >> 4) & 0x03) - 2) & 0xff,
+						(channel(px, 1) + ((op >> 2) & 0x03) - 2) & 0xff,
+						(channel(px, 2) + (op & 0x03) - 2) & 0xff,
+						channel(px, 3)
+					);
+				}
+				else if((op & MASK) == OP_LUMA)
+				{
+					std::uint8_t next = *in++;
+					std::int32_t vg = static_cast<std::int32_t>(op & 0x3f) - 32;
+					px = pack(
+						(channel(px, 0) + vg - 8 + ((next >> 4) & 0x0f)) & 0xff,
+						(channel(px, 1) + vg) & 0xff,
+						(channel(px, 2) + vg - 8 + (next & 0x0f)) & 0xff,
+						channel(px, 3)
+					);
+				}
+				else
+				{
+					run = op & 0x3f;
+				}
+				index[hash(px)] = px;
+			}
+			else
+			{
+				return false;
+			}
+			store<Channels>(out, px);
+		}
+		return true;
+	}
+
+} //namespace anonymous
+
+bool decode(std::uint8_t const *data, std::size_t size, std::uint32_t channels, std::vector<std::uint8_t> &pixels, std::uint32_t &width, std::uint32_t &height)
+{
+	if(size < HEADER_SIZE + PADDING_SIZE || std::memcmp(data, "qoif", 4))
+		return false;
+
+	width = read32(data + 4);
+	height = read32(data + 8);
+	if(!width || !height || std::uint64_t(width) * height > MAX_PIXELS)
+		return false;
+
+	std::size_t count = std::size_t(width) * height;
+	pixels.resize(count * channels);
+
+	std::uint8_t const *in = data + HEADER_SIZE;
+	std::uint8_t const *end = data + size - PADDING_SIZE;
+	if(channels == 1)
+		return decodePixels<1>(in, end, pixels.data(), count);
+	if(channels == 3)
+		return decodePixels<3>(in, end, pixels.data(), count);
+	if(channels == 4)
+		return decodePixels<4>(in, end, pixels.data(), count);
+	return false;
+}
+
+} //namespace qoi
+} //namespace cli
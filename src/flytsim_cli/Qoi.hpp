@@ -0,0 +1,14 @@
+#ifndef QOI_HPP
+#define QOI_HPP
+
+#include "Config.hpp"
+
+namespace cli { namespace qoi {
+
+	//pixels get channels bytes per pixel, false for a malformed stream
+	extern bool decode(std::uint8_t const *data, std::size_t size, std::uint32_t channels, std::vector<std::uint8_t> &pixels, std::uint32_t &width, std::uint32_t &height);
+
+} //namespace qoi
+} //namespace cli
+
+#endif //QOI_HPP
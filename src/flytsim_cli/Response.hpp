@@ -13,12 +13,77 @@ namespace cli { namespace response {
     
   struct Image
   {
+    optional<double> sent;
+    optional<std::uint64_t> seq;
+    optional<double> stamp;
+    optional<double> received;
+    optional<double> encode_start;
+    optional<double> encode_end;
     int width;
     int height;
+    optional<std::string> encoding;
+    optional<std::string> format;
+    optional<std::uint64_t> delta;
+    optional<int> tile;
+    optional<int> tiles;
     int size;
     std::string data;
   };
 
+  struct NotModified
+  {
+    std::uint64_t seq;
+  };
+
+  struct Adaptive
+  {
+    int level;
+    optional<int> width;
+    optional<int> height;
+    std::string format;
+    optional<std::uint32_t> quality;
+    optional<float> max_fps;
+    double goodput;
+    double delay;
+  };
+
+  struct Images
+  {
+    std::uint32_t count;
+    double skew;
+  };
+
+  struct Vector3
+  {
+    double x, y, z;
+  };
+
+  struct Quaternion
+  {
+    double x, y, z, w;
+  };
+
+  //a pushed telemetry update, only the fields of its topic are set
+  struct Telemetry
+  {
+    std::string topic;
+    std::uint64_t seq;                      //counts the updates of the topic the server pushed to anyone
+    double stamp;
+    optional<Vector3> position;             //position: local position in meters
+    optional<Vector3> velocity;
+    optional<Vector3> rpy;                  //attitude: radians
+    optional<Vector3> rates;
+    optional<Quaternion> orientation;       //imu
+    optional<Vector3> angular_velocity;
+    optional<Vector3> linear_acceleration;
+    optional<double> voltage;               //battery
+    optional<double> current;
+    optional<double> remaining;             //0 to 1
+    optional<double> latitude;              //global: degrees
+    optional<double> longitude;
+    optional<double> altitude;              //meters
+  };
+
 }
 }
 
@@ -25,12 +25,81 @@ BOOST_FUSION_ADAPT_STRUCT(
 
 BOOST_FUSION_ADAPT_STRUCT(
   cli::response::Image,
+  (boost::optional<double>, sent)
+  (boost::optional<std::uint64_t>, seq)
+  (boost::optional<double>, stamp)
+  (boost::optional<double>, received)
+  (boost::optional<double>, encode_start)
+  (boost::optional<double>, encode_end)
   (int, width)
   (int, height)
+  (boost::optional<std::string>, encoding)
+  (boost::optional<std::string>, format)
+  (boost::optional<std::uint64_t>, delta)
+  (boost::optional<int>, tile)
+  (boost::optional<int>, tiles)
   (int, size)
   (std::string, data)
 )
 
+BOOST_FUSION_ADAPT_STRUCT(
+  cli::response::NotModified,
+  (std::uint64_t, seq)
+)
+
+BOOST_FUSION_ADAPT_STRUCT(
+  cli::response::Adaptive,
+  (int, level)
+  (boost::optional<int>, width)
+  (boost::optional<int>, height)
+  (std::string, format)
+  (boost::optional<std::uint32_t>, quality)
+  (boost::optional<float>, max_fps)
+  (double, goodput)
+  (double, delay)
+)
+
+BOOST_FUSION_ADAPT_STRUCT(
+  cli::response::Images,
+  (std::uint32_t, count)
+  (double, skew)
+)
+
+BOOST_FUSION_ADAPT_STRUCT(
+  cli::response::Vector3,
+  (double, x)
+  (double, y)
+  (double, z)
+)
+
+BOOST_FUSION_ADAPT_STRUCT(
+  cli::response::Quaternion,
+  (double, x)
+  (double, y)
+  (double, z)
+  (double, w)
+)
+
+BOOST_FUSION_ADAPT_STRUCT(
+  cli::response::Telemetry,
+  (std::string, topic)
+  (std::uint64_t, seq)
+  (double, stamp)
+  (boost::optional<cli::response::Vector3>, position)
+  (boost::optional<cli::response::Vector3>, velocity)
+  (boost::optional<cli::response::Vector3>, rpy)
+  (boost::optional<cli::response::Vector3>, rates)
+  (boost::optional<cli::response::Quaternion>, orientation)
+  (boost::optional<cli::response::Vector3>, angular_velocity)
+  (boost::optional<cli::response::Vector3>, linear_acceleration)
+  (boost::optional<double>, voltage)
+  (boost::optional<double>, current)
+  (boost::optional<double>, remaining)
+  (boost::optional<double>, latitude)
+  (boost::optional<double>, longitude)
+  (boost::optional<double>, altitude)
+)
+
 
 namespace cli { namespace response {
 
@@ -71,18 +140,131 @@ namespace cli { namespace response {
         : ImageRule::base_type(r_Image)
       {
         r_Image =
+          -( qi::lit("sent:") >> qi::double_ ) >>
+          -( qi::lit("seq:")  >> qi::ulong_long ) >>
+          -( qi::lit("stamp:") >> qi::double_ ) >>
+          -( qi::lit("received:") >> qi::double_ ) >>
+          -( qi::lit("encode_start:") >> qi::double_ ) >>
+          -( qi::lit("encode_end:") >> qi::double_ ) >>
           qi::lit("width:")   >> qi::int_ >>
           qi::lit("height:")  >> qi::int_ >>
+          -( qi::lit("encoding:") >> r_Encoding ) >>
+          -( qi::lit("format:") >> r_Encoding ) >>
+          -( qi::lit("delta:") >> qi::ulong_long ) >>
+          -( qi::lit("tile:") >> qi::int_ ) >>
+          -( qi::lit("tiles:") >> qi::int_ ) >>
           qi::lit("size:")    >> qi::int_ >>
           qi::lit("data:")    >> r_Base32;
 
+        r_Encoding = qi::lexeme[ +qi::char_("a-zA-Z0-9_") ];
         r_Base32 = *qi::char_("ABCDEFGHIJKLMNOPQRSTUVWXYZ234567");
       }
 
       qi::rule<Iterator, Image(), ascii::space_type > r_Image;
+      qi::rule<Iterator, std::string(), ascii::space_type > r_Encoding;
       qi::rule<Iterator, std::string(), ascii::space_type > r_Base32;
     };
 
+    template <typename Iterator>
+    struct NotModifiedRule : qi::grammar < Iterator, NotModified(), ascii::space_type >
+    {
+      NotModifiedRule()
+        : NotModifiedRule::base_type(r_NotModified)
+      {
+        r_NotModified =
+          qi::lit("seq:") >> qi::ulong_long >>
+          qi::lit("not_modified");
+      }
+
+      qi::rule<Iterator, NotModified(), ascii::space_type > r_NotModified;
+    };
+
+    template <typename Iterator>
+    struct AdaptiveRule : qi::grammar < Iterator, Adaptive(), ascii::space_type >
+    {
+      AdaptiveRule()
+        : AdaptiveRule::base_type(r_Adaptive)
+      {
+        r_Adaptive =
+          qi::lit("adaptive") >>
+          qi::lit("level:")   >> qi::int_ >>
+          -( qi::lit("width:") >> qi::int_ ) >>
+          -( qi::lit("height:") >> qi::int_ ) >>
+          qi::lit("format:")  >> r_Format >>
+          -( qi::lit("quality:") >> qi::uint_ ) >>
+          -( qi::lit("max_fps:") >> qi::float_ ) >>
+          qi::lit("goodput:") >> qi::double_ >>
+          qi::lit("delay:")   >> qi::double_;
+
+        r_Format = qi::lexeme[ +qi::char_("a-zA-Z0-9_") ];
+      }
+
+      qi::rule<Iterator, Adaptive(), ascii::space_type > r_Adaptive;
+      qi::rule<Iterator, std::string(), ascii::space_type > r_Format;
+    };
+
+    template <typename Iterator>
+    struct ImagesRule : qi::grammar < Iterator, Images(), ascii::space_type >
+    {
+      ImagesRule()
+        : ImagesRule::base_type(r_Images)
+      {
+        r_Images =
+          qi::lit("images:") >> qi::uint_ >>
+          qi::lit("skew:")   >> qi::double_;
+      }
+
+      qi::rule<Iterator, Images(), ascii::space_type > r_Images;
+    };
+
+    template <typename Iterator>
+    struct TelemetryRule : qi::grammar < Iterator, Telemetry(), ascii::space_type >
+    {
+      TelemetryRule()
+        : TelemetryRule::base_type(r_Telemetry)
+      {
+        r_Telemetry =
+          qi::lit("topic:") >> r_Topic >>
+          qi::lit("seq:")   >> qi::ulong_long >>
+          qi::lit("stamp:") >> qi::double_ >>
+          -( qi::lit("position:") >> r_Vector3 ) >>
+          -( qi::lit("velocity:") >> r_Vector3 ) >>
+          -( qi::lit("rpy:") >> r_Vector3 ) >>
+          -( qi::lit("rates:") >> r_Vector3 ) >>
+          -( qi::lit("orientation:") >> r_Quaternion ) >>
+          -( qi::lit("angular_velocity:") >> r_Vector3 ) >>
+          -( qi::lit("linear_acceleration:") >> r_Vector3 ) >>
+          -( qi::lit("voltage:") >> qi::double_ ) >>
+          -( qi::lit("current:") >> qi::double_ ) >>
+          -( qi::lit("remaining:") >> qi::double_ ) >>
+          -( qi::lit("latitude:") >> qi::double_ ) >>
+          -( qi::lit("longitude:") >> qi::double_ ) >>
+          -( qi::lit("altitude:") >> qi::double_ );
+
+        r_Vector3 =
+          qi::lit("{") >>
+          qi::double_ >> qi::lit(",") >>
+          qi::double_ >> qi::lit(",") >>
+          qi::double_ >>
+          qi::lit("}");
+
+        r_Quaternion =
+          qi::lit("{") >>
+          qi::double_ >> qi::lit(",") >>
+          qi::double_ >> qi::lit(",") >>
+          qi::double_ >> qi::lit(",") >>
+          qi::double_ >>
+          qi::lit("}");
+
+        r_Topic = qi::lexeme[ +qi::char_("a-z0-9_") ];
+      }
+
+      qi::rule<Iterator, Telemetry(), ascii::space_type > r_Telemetry;
+      qi::rule<Iterator, Vector3(), ascii::space_type > r_Vector3;
+      qi::rule<Iterator, Quaternion(), ascii::space_type > r_Quaternion;
+      qi::rule<Iterator, std::string(), ascii::space_type > r_Topic;
+    };
+
   } //namespace grammar
 
   system::error_code parseResult(std::string const &str, Result &result)
@@ -109,6 +291,53 @@ namespace cli { namespace response {
     return system::error_code();
   }
 
+  system::error_code parseNotModified(std::string const &str, NotModified &notModified)
+  {
+    std::string::const_iterator begin = str.begin();
+    std::string::const_iterator end = str.end();
+    grammar::NotModifiedRule<std::string::const_iterator> rule;
+
+    if(!grammar::qi::phrase_parse(begin, end, rule, grammar::ascii::space, notModified))
+      return make_error_code(system::errc::invalid_argument);
+
+    return system::error_code();
+  }
+
+  system::error_code parseAdaptive(std::string const &str, Adaptive &adaptive)
+  {
+    std::string::const_iterator begin = str.begin();
+    std::string::const_iterator end = str.end();
+    grammar::AdaptiveRule<std::string::const_iterator> rule;
+
+    if(!grammar::qi::phrase_parse(begin, end, rule, grammar::ascii::space, adaptive))
+      return make_error_code(system::errc::invalid_argument);
+
+    return system::error_code();
+  }
+
+  system::error_code parseImages(std::string const &str, Images &images)
+  {
+    std::string::const_iterator begin = str.begin();
+    std::string::const_iterator end = str.end();
+    grammar::ImagesRule<std::string::const_iterator> rule;
+
+    if(!grammar::qi::phrase_parse(begin, end, rule, grammar::ascii::space, images))
+      return make_error_code(system::errc::invalid_argument);
+
+    return system::error_code();
+  }
+
+  system::error_code parseTelemetry(std::string const &str, Telemetry &telemetry)
+  {
+    std::string::const_iterator begin = str.begin();
+    std::string::const_iterator end = str.end();
+    grammar::TelemetryRule<std::string::const_iterator> rule;
+
+    if(!grammar::qi::phrase_parse(begin, end, rule, grammar::ascii::space, telemetry))
+      return make_error_code(system::errc::invalid_argument);
+
+    return system::error_code();
+  }
 
 } //namespace response
 } //namespace cli
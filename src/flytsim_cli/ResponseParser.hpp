@@ -8,6 +8,10 @@ namespace cli { namespace response {
 
   extern system::error_code parseResult(std::string const &str, Result &result);
   extern system::error_code parseImage(std::string const &str, Image &image);
+  extern system::error_code parseNotModified(std::string const &str, NotModified &notModified);
+  extern system::error_code parseAdaptive(std::string const &str, Adaptive &adaptive);
+  extern system::error_code parseImages(std::string const &str, Images &images);
+  extern system::error_code parseTelemetry(std::string const &str, Telemetry &telemetry);
 
 
 } //namespace response
@@ -2,6 +2,25 @@
 
 namespace cli { namespace example {
 
+  namespace {
+
+    //frames from servers that do not send the encoding are bgr8
+    GLenum pixelFormat(std::string const &encoding)
+    {
+      if(encoding == "rgb8")
+        return GL_RGB;
+      if(encoding == "rgba8")
+        return GL_RGBA;
+      if(encoding == "bgra8")
+        return GL_BGRA;
+      //the Y plane of yuv420 comes first and is shown as grayscale
+      if(encoding == "mono8" || encoding == "yuv420")
+        return GL_LUMINANCE;
+      return GL_BGR;
+    }
+
+  } //namespace anonymous
+
   CameraView::CameraView(QWidget *parent)
     : QOpenGLWidget(parent)
     , m_Guard()
@@ -88,7 +107,7 @@ namespace cli { namespace example {
       m_VideoFrame->width,
       m_VideoFrame->height,
       0,
-      GL_BGR,
+      pixelFormat(m_VideoFrame->encoding),
       GL_UNSIGNED_BYTE,
       m_VideoFrame->data.data()
     );
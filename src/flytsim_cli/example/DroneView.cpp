@@ -7,16 +7,11 @@ namespace cli { namespace example {
 DroneView::DroneView(QMainWindow *mw)
   : QWidget(mw)
   , Ui::DroneView()
-  , m_ImageTimer(new QTimer(this))
   , m_Connection(std::make_shared<Connection>())
   , m_newDPAD(0)
   , m_prevDPAD(0)
 {
 
-  m_ImageTimer->setInterval(100);
-  connect(m_ImageTimer, SIGNAL(timeout()), SLOT(onImageTimer()));
-
-
   setupUi(this);
 
   m_TakeOffAltitudeLineEdit->setValidator(new QDoubleValidator(0.0, std::numeric_limits<float>::max(), 2));
@@ -158,13 +153,12 @@ void DroneView::onConnectDisconnect()
 {
   if(m_Connection->isConnected())
   {
-    m_ImageTimer->stop();
     m_Connection->disconnect();
   }
   else
   {
     if(!m_Connection->connect(m_ServerAddressLineEdit->text().toStdString()))
-      m_ImageTimer->start();
+      subscribeImage();
   }
 
   updateUI();
@@ -204,10 +198,12 @@ void DroneView::onLand()
   m_Connection->asyncSendCommand(std::make_shared<cmd::Land>(m_LandAsyncronouslyCheckBox->isChecked()));
 }
 
-void DroneView::onImageTimer()
+void DroneView::subscribeImage()
 {
-  m_Connection->asyncSendCommand(std::make_shared<cmd::GetImage>(
-    std::bind(&DroneView::onImageReceived, this, std::placeholders::_1)
+  //frames are pushed by the server as they arrive, at most 10 per second
+  m_Connection->asyncSendCommand(std::make_shared<cmd::SubscribeImage>(
+    std::bind(&DroneView::onImageReceived, this, std::placeholders::_1),
+    10.0f
   ));
 }
 
@@ -46,14 +46,12 @@ namespace cli { namespace example {
     void onTakeoff();
     void onLand();
 
-    void onImageTimer();
-
   private:
     void sendVelocitySetpoint();
+    void subscribeImage();
     void onImageReceived(std::shared_ptr<Image> img);
 
   private:
-    QTimer *m_ImageTimer;
     std::shared_ptr<Connection> m_Connection;
     uint32_t m_newDPAD;
     uint32_t m_prevDPAD;
@@ -0,0 +1,88 @@
+#include "Affinity.hpp"
+#include <algorithm>
+#include <sstream>
+#include <pthread.h>
+#include <sched.h>
+
+namespace srv {
+
+system::error_code parseCpuSet(std::string const &str, CpuSet &cpus)
+{
+	//accepts lists like "2", "0,2" or "0-3,6"
+	cpus.clear();
+	std::istringstream iss(str);
+	std::string item;
+	while(std::getline(iss, item, ','))
+	{
+		if(item.empty())
+			continue;
+
+		unsigned first = 0, last = 0;
+		char dash = 0;
+		std::istringstream is(item);
+		if(!(is >> first))
+			return make_error_code(system::errc::invalid_argument);
+
+		last = first;
+		if(is >> dash)
+		{
+			if(dash != '-' || !(is >> last) || last < first)
+				return make_error_code(system::errc::invalid_argument);
+		}
+
+		if(last >= CPU_SETSIZE)
+			return make_error_code(system::errc::invalid_argument);
+
+		for(unsigned cpu = first; cpu <= last; ++cpu)
+			cpus.push_back(cpu);
+	}
+
+	std::sort(cpus.begin(), cpus.end());
+	cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+	return system::error_code();
+}
+
+std::string formatCpuSet(CpuSet const &cpus)
+{
+	if(cpus.empty())
+		return "any";
+
+	std::ostringstream oss;
+	for(std::size_t c = 0; c < cpus.size(); ++c)
+		oss << (c ? "," : "") << cpus[c];
+	return oss.str();
+}
+
+system::error_code getThreadAffinity(CpuSet &cpus)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if(int err = ::pthread_getaffinity_np(::pthread_self(), sizeof(set), &set))
+		return system::error_code(err, system::system_category());
+
+	cpus.clear();
+	for(unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+	{
+		if(CPU_ISSET(cpu, &set))
+			cpus.push_back(cpu);
+	}
+	return system::error_code();
+}
+
+system::error_code setThreadAffinity(CpuSet const &cpus)
+{
+	if(cpus.empty())
+		return system::error_code();
+
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for(unsigned cpu : cpus)
+		CPU_SET(cpu, &set);
+
+	if(int err = ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set))
+		return system::error_code(err, system::system_category());
+
+	return system::error_code();
+}
+
+} //namespace srv
@@ -0,0 +1,21 @@
+#ifndef AFFINITY_HPP
+#define AFFINITY_HPP
+
+#include "Config.hpp"
+#include <string>
+#include <vector>
+
+namespace srv {
+
+	//sorted list of cpu indices, empty means "not restricted"
+	typedef std::vector<unsigned> CpuSet;
+
+	extern system::error_code parseCpuSet(std::string const &str, CpuSet &cpus);
+	extern std::string formatCpuSet(CpuSet const &cpus);
+
+	extern system::error_code getThreadAffinity(CpuSet &cpus);
+	extern system::error_code setThreadAffinity(CpuSet const &cpus);
+
+} //namespace srv
+
+#endif //AFFINITY_HPP
@@ -0,0 +1,104 @@
+#include "Allocations.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined(FLYTSIM_COUNT_ALLOCATIONS)
+
+namespace {
+
+	std::atomic<std::uint64_t> g_ProcessCount(0);
+	std::atomic<std::uint64_t> g_ProcessBytes(0);
+	thread_local std::uint64_t g_ThreadCount = 0;
+	thread_local std::uint64_t g_ThreadBytes = 0;
+
+	void* countedAllocate(std::size_t size)
+	{
+		g_ProcessCount.fetch_add(1, std::memory_order_relaxed);
+		g_ProcessBytes.fetch_add(size, std::memory_order_relaxed);
+		++g_ThreadCount;
+		g_ThreadBytes += size;
+		return std::malloc(size ? size : 1);
+	}
+
+} //namespace anonymous
+
+void* operator new(std::size_t size)
+{
+	if(void *p = countedAllocate(size))
+		return p;
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+	if(void *p = countedAllocate(size))
+		return p;
+	throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::nothrow_t const &) noexcept
+{
+	return countedAllocate(size);
+}
+
+void* operator new[](std::size_t size, std::nothrow_t const &) noexcept
+{
+	return countedAllocate(size);
+}
+
+void operator delete(void *p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void *p, std::nothrow_t const &) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void *p, std::nothrow_t const &) noexcept
+{
+	std::free(p);
+}
+
+#endif //FLYTSIM_COUNT_ALLOCATIONS
+
+namespace srv { namespace allocations {
+
+bool enabled()
+{
+#if defined(FLYTSIM_COUNT_ALLOCATIONS)
+	return true;
+#else
+	return false;
+#endif
+}
+
+Counters process()
+{
+	Counters counters = {0, 0};
+#if defined(FLYTSIM_COUNT_ALLOCATIONS)
+	counters.count = g_ProcessCount.load(std::memory_order_relaxed);
+	counters.bytes = g_ProcessBytes.load(std::memory_order_relaxed);
+#endif
+	return counters;
+}
+
+Counters thread()
+{
+	Counters counters = {0, 0};
+#if defined(FLYTSIM_COUNT_ALLOCATIONS)
+	counters.count = g_ThreadCount;
+	counters.bytes = g_ThreadBytes;
+#endif
+	return counters;
+}
+
+} //namespace allocations
+} //namespace srv
@@ -0,0 +1,22 @@
+#ifndef ALLOCATIONS_HPP
+#define ALLOCATIONS_HPP
+
+#include "Config.hpp"
+
+namespace srv { namespace allocations {
+
+	//global operator new calls, counted only in builds with FLYTSIM_COUNT_ALLOCATIONS
+	struct Counters
+	{
+		std::uint64_t count;
+		std::uint64_t bytes;
+	};
+
+	extern bool enabled();
+	extern Counters process();
+	extern Counters thread();
+
+} //namespace allocations
+} //namespace srv
+
+#endif //ALLOCATIONS_HPP
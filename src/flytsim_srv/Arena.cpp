@@ -0,0 +1,203 @@
+#include "Arena.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace srv {
+
+namespace {
+
+	std::size_t alignUp(std::size_t value, std::size_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	std::size_t roundCapacity(std::size_t size)
+	{
+		std::size_t capacity = Arena::INITIAL_SIZE;
+		while(capacity < size)
+			capacity *= 2;
+		return capacity;
+	}
+
+} //namespace anonymous
+
+Arena::Arena()
+	: m_Buffer(nullptr)
+	, m_Capacity(0)
+	, m_Used(0)
+	, m_Overflow(nullptr)
+	, m_OverflowUsed(0)
+	, m_OverflowTotal(0)
+	, m_RecentPeak(0)
+	, m_Releases(0)
+	, m_UpstreamAllocations(0)
+{
+}
+
+Arena::~Arena()
+{
+	release();
+	::operator delete(m_Buffer);
+}
+
+void* Arena::allocate(std::size_t size, std::size_t alignment)
+{
+	if(!m_Buffer)
+		resize(roundCapacity(size + alignment));
+
+	std::size_t offset = alignUp(reinterpret_cast<std::uintptr_t>(m_Buffer) + m_Used, alignment) - reinterpret_cast<std::uintptr_t>(m_Buffer);
+	if(!m_Overflow && offset + size <= m_Capacity)
+	{
+		m_Used = offset + size;
+		return m_Buffer + offset;
+	}
+	return allocateOverflow(size, alignment);
+}
+
+void* Arena::allocateOverflow(std::size_t size, std::size_t alignment)
+{
+	if(m_Overflow)
+	{
+		char *base = reinterpret_cast<char*>(m_Overflow + 1);
+		std::size_t offset = alignUp(reinterpret_cast<std::uintptr_t>(base) + m_OverflowUsed, alignment) - reinterpret_cast<std::uintptr_t>(base);
+		if(offset + size <= m_Overflow->size)
+		{
+			m_OverflowTotal += offset + size - m_OverflowUsed;
+			m_OverflowUsed = offset + size;
+			return base + offset;
+		}
+	}
+
+	//chunks grow geometrically, the next release() folds them into the primary block
+	std::size_t chunkSize = std::max(size + alignment, std::max<std::size_t>(m_Capacity, m_Overflow ? 2 * m_Overflow->size : 0));
+	Chunk *chunk = static_cast<Chunk*>(::operator new(sizeof(Chunk) + chunkSize));
+	++m_UpstreamAllocations;
+	chunk->next = m_Overflow;
+	chunk->size = chunkSize;
+	m_Overflow = chunk;
+	m_OverflowUsed = 0;
+	return allocateOverflow(size, alignment);
+}
+
+void Arena::release()
+{
+	std::size_t peak = m_Used + m_OverflowTotal;
+	m_RecentPeak = std::max(m_RecentPeak, peak);
+
+	if(m_Overflow)
+	{
+		while(m_Overflow)
+		{
+			Chunk *next = m_Overflow->next;
+			::operator delete(m_Overflow);
+			m_Overflow = next;
+		}
+		resize(roundCapacity(peak));
+	}
+	else
+	if(++m_Releases >= SHRINK_PERIOD)
+	{
+		//give back memory held since a burst of large responses
+		if(m_Capacity > 4 * roundCapacity(m_RecentPeak))
+			resize(roundCapacity(m_RecentPeak));
+		m_Releases = 0;
+		m_RecentPeak = 0;
+	}
+
+	m_Used = 0;
+	m_OverflowUsed = 0;
+	m_OverflowTotal = 0;
+}
+
+void Arena::resize(std::size_t capacity)
+{
+	::operator delete(m_Buffer);
+	m_Buffer = static_cast<char*>(::operator new(capacity));
+	m_Capacity = capacity;
+	m_Used = 0;
+	++m_UpstreamAllocations;
+}
+
+std::size_t Arena::capacity() const
+{
+	return m_Capacity;
+}
+
+std::size_t Arena::used() const
+{
+	return m_Used + m_OverflowTotal;
+}
+
+std::uint64_t Arena::upstreamAllocations() const
+{
+	return m_UpstreamAllocations;
+}
+
+ArenaStreamBuf::ArenaStreamBuf(Arena &arena)
+	: std::streambuf()
+	, m_Arena(arena)
+	, m_Segments(ArenaAllocator<asio::const_buffer>(arena))
+	, m_SegmentSize(SEGMENT_MIN / 2)
+{
+	m_Segments.reserve(8);
+}
+
+ArenaStreamBuf::Segments const& ArenaStreamBuf::segments()
+{
+	flushSegment();
+	return m_Segments;
+}
+
+std::size_t ArenaStreamBuf::size()
+{
+	flushSegment();
+	std::size_t total = 0;
+	for(asio::const_buffer const &segment : m_Segments)
+		total += asio::buffer_size(segment);
+	return total;
+}
+
+ArenaStreamBuf::int_type ArenaStreamBuf::overflow(int_type c)
+{
+	if(traits_type::eq_int_type(c, traits_type::eof()))
+		return traits_type::not_eof(c);
+
+	nextSegment(1);
+	*pptr() = traits_type::to_char_type(c);
+	pbump(1);
+	return c;
+}
+
+std::streamsize ArenaStreamBuf::xsputn(char_type const *s, std::streamsize n)
+{
+	std::streamsize left = n;
+	while(left > 0)
+	{
+		if(pptr() == epptr())
+			nextSegment(static_cast<std::size_t>(left));
+
+		std::streamsize chunk = std::min<std::streamsize>(left, epptr() - pptr());
+		std::memcpy(pptr(), s, static_cast<std::size_t>(chunk));
+		pbump(static_cast<int>(chunk));
+		s += chunk;
+		left -= chunk;
+	}
+	return n;
+}
+
+void ArenaStreamBuf::flushSegment()
+{
+	if(pptr() != pbase())
+		m_Segments.push_back(asio::const_buffer(pbase(), pptr() - pbase()));
+	setp(pptr(), epptr());
+}
+
+void ArenaStreamBuf::nextSegment(std::size_t minSize)
+{
+	flushSegment();
+	m_SegmentSize = std::max(minSize, std::min<std::size_t>(2 * m_SegmentSize, SEGMENT_MAX));
+	char *segment = static_cast<char*>(m_Arena.allocate(m_SegmentSize, 1));
+	setp(segment, segment + m_SegmentSize);
+}
+
+} //namespace srv
@@ -0,0 +1,108 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include "Config.hpp"
+#include <streambuf>
+
+namespace srv {
+
+//monotonic allocator released as a whole, the primary block adapts to the peak usage
+//so a steady stream of similar requests is served without touching the global heap
+class Arena
+{
+public:
+	enum { INITIAL_SIZE = 4096 };
+	enum { SHRINK_PERIOD = 64 };
+
+	Arena();
+	~Arena();
+
+	void* allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+	void release();
+
+	std::size_t capacity() const;
+	std::size_t used() const;
+	std::uint64_t upstreamAllocations() const;
+
+private:
+	Arena(Arena const &);
+	Arena& operator=(Arena const &);
+
+	struct Chunk
+	{
+		Chunk *next;
+		std::size_t size;
+	};
+
+	void* allocateOverflow(std::size_t size, std::size_t alignment);
+	void resize(std::size_t capacity);
+
+private:
+	char *m_Buffer;
+	std::size_t m_Capacity;
+	std::size_t m_Used;
+
+	Chunk *m_Overflow;
+	std::size_t m_OverflowUsed;
+	std::size_t m_OverflowTotal;
+
+	std::size_t m_RecentPeak;
+	std::size_t m_Releases;
+	std::uint64_t m_UpstreamAllocations;
+};
+
+template <typename T>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+
+	template <typename U> struct rebind { typedef ArenaAllocator<U> other; };
+
+	explicit ArenaAllocator(Arena &arena) : m_Arena(&arena) {}
+	template <typename U> ArenaAllocator(ArenaAllocator<U> const &other) : m_Arena(other.arena()) {}
+
+	T* allocate(std::size_t n) { return static_cast<T*>(m_Arena->allocate(n * sizeof(T), alignof(T))); }
+	void deallocate(T *, std::size_t) {}
+
+	Arena* arena() const { return m_Arena; }
+
+	template <typename U> bool operator==(ArenaAllocator<U> const &other) const { return m_Arena == other.arena(); }
+	template <typename U> bool operator!=(ArenaAllocator<U> const &other) const { return m_Arena != other.arena(); }
+
+private:
+	Arena *m_Arena;
+};
+
+//output stream buffer writing into a chain of arena segments, ready for a gather write
+class ArenaStreamBuf
+	: public std::streambuf
+{
+public:
+	enum { SEGMENT_MIN = 256 };
+	enum { SEGMENT_MAX = 256 * 1024 };
+
+	typedef std::vector< asio::const_buffer, ArenaAllocator<asio::const_buffer> > Segments;
+
+	ArenaStreamBuf(Arena &arena);
+
+	Segments const& segments();
+	std::size_t size();
+
+protected:
+	int_type overflow(int_type c);
+	std::streamsize xsputn(char_type const *s, std::streamsize n);
+
+private:
+	void flushSegment();
+	void nextSegment(std::size_t minSize);
+
+private:
+	Arena &m_Arena;
+	Segments m_Segments;
+	std::size_t m_SegmentSize;
+};
+
+} //namespace srv
+
+#endif //ARENA_HPP
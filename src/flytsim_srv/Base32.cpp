@@ -1,37 +1,405 @@
 #include "Base32.hpp"
+#include <cstring>
+#include <algorithm>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define BASE32_X86_KERNELS
+#include <immintrin.h>
+#endif
 
 namespace srv { namespace base32 {
 
-bool encode(void const *data, std::size_t size, std::ostream &os)
-{
-	uint8_t const *bytes = reinterpret_cast<uint8_t const *>(data);
+namespace {
+
+	char const ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+
+	//the kernels code whole blocks and return the bytes they consumed, the scalar code does the rest
+	typedef std::size_t (*EncodeKernel)(std::uint8_t const *bytes, std::size_t size, char *out);
+	typedef std::size_t (*DecodeKernel)(char const *text, std::size_t length, std::uint8_t *bytes);
+
+	//40 bits make 8 characters
+	std::size_t encodeScalar(std::uint8_t const *bytes, std::size_t size, char *out)
+	{
+		std::size_t whole = size / 5 * 5;
+		for(std::size_t i = 0; i < whole; i += 5, out += 8)
+		{
+			std::uint64_t block =
+				std::uint64_t(bytes[i]) << 32 | std::uint64_t(bytes[i + 1]) << 24 | std::uint64_t(bytes[i + 2]) << 16 |
+				std::uint64_t(bytes[i + 3]) << 8 | bytes[i + 4];
+			for(int c = 0; c < 8; ++c)
+				out[c] = ALPHABET[(block >> (35 - c * 5)) & 0x1F];
+		}
+		return whole;
+	}
 
-	if(size > 0)
+	//0xFF for characters that are not digits
+	struct DigitTable
 	{
-		int buffer = bytes[0];
-		std::size_t next = 1;
-		std::size_t bitsLeft = 8;
-		while(bitsLeft > 0 || next < size)
+		DigitTable()
 		{
-			if(bitsLeft < 5)
+			for(int ch = 0; ch < 256; ++ch)
+				values[ch] = 0xFF;
+			for(int ch = 'A'; ch <= 'Z'; ++ch)
+				values[ch] = values[ch + 'a' - 'A'] = static_cast<std::uint8_t>(ch - 'A');
+			for(int ch = '2'; ch <= '7'; ++ch)
+				values[ch] = static_cast<std::uint8_t>(ch - '2' + 26);
+		}
+
+		std::uint8_t values[256];
+	};
+
+	DigitTable const DIGITS;
+
+	std::uint8_t digitValue(char ch)
+	{
+		return DIGITS.values[static_cast<std::uint8_t>(ch)];
+	}
+
+	std::size_t decodeScalar(char const *text, std::size_t length, std::uint8_t *bytes)
+	{
+		std::size_t blocks = length / 8;
+		for(std::size_t b = 0; b < blocks; ++b, text += 8, bytes += 5)
+		{
+			//a non digit sets the high bits
+			std::uint64_t block = 0;
+			std::uint8_t invalid = 0;
+			for(int c = 0; c < 8; ++c)
 			{
-				if(next < size)
-				{
-					buffer <<= 8;
-					buffer |= bytes[next++] & 0xFF;
-					bitsLeft += 8;
-				}
-				else
-				{
-					int pad = 5 - bitsLeft;
-					buffer <<= pad;
-					bitsLeft += pad;
-				}
+				std::uint8_t value = digitValue(text[c]);
+				invalid |= value;
+				block = block << 5 | (value & 0x1F);
 			}
+			if(invalid & 0xE0)
+				return b * 5;
+
+			for(int i = 0; i < 5; ++i)
+				bytes[i] = static_cast<std::uint8_t>(block >> (32 - i * 8));
+		}
+		return blocks * 5;
+	}
+
+#if defined(BASE32_X86_KERNELS)
+
+	//every 16 bit lane gets the two bytes holding one character big endian, a multiply shifts
+	//the 5 bits down to the lane bottom, 10 bytes make 16 characters
+	__attribute__((target("ssse3")))
+	inline __m128i digitsToText(__m128i digits)
+	{
+		//'A' + v up to 25, '2' + v - 26 above
+		__m128i above = _mm_and_si128(_mm_cmpgt_epi8(digits, _mm_set1_epi8(25)), _mm_set1_epi8('A' - '2' + 26));
+		return _mm_sub_epi8(_mm_add_epi8(digits, _mm_set1_epi8('A')), above);
+	}
+
+	__attribute__((target("ssse3")))
+	inline __m128i spreadBlocks(__m128i in)
+	{
+		__m128i const first = _mm_setr_epi8(1, 0, 1, 0, 2, 1, 2, 1, 3, 2, 4, 3, 4, 3, 5, 4);
+		__m128i const second = _mm_setr_epi8(6, 5, 6, 5, 7, 6, 7, 6, 8, 7, 9, 8, 9, 8, 10, 9);
+		//x >> s as the high half of x * 2^(16 - s), s is 11, 6, 9, 4, 7, 10, 5, 8
+		__m128i const shifts = _mm_setr_epi16(1 << 5, 1 << 10, 1 << 7, 1 << 12, 1 << 9, 1 << 6, 1 << 11, 1 << 8);
+		__m128i const mask = _mm_set1_epi16(0x1F);
+
+		__m128i lo = _mm_and_si128(_mm_mulhi_epu16(_mm_shuffle_epi8(in, first), shifts), mask);
+		__m128i hi = _mm_and_si128(_mm_mulhi_epu16(_mm_shuffle_epi8(in, second), shifts), mask);
+		return _mm_packus_epi16(lo, hi);
+	}
+
+	__attribute__((target("ssse3")))
+	std::size_t encodeSsse3(std::uint8_t const *bytes, std::size_t size, char *out)
+	{
+		//16 bytes are loaded for 10, the last block is left to the scalar code
+		std::size_t done = 0;
+		for(; done + 16 <= size; done += 10, out += 16)
+		{
+			__m128i in = _mm_loadu_si128(reinterpret_cast<__m128i const *>(bytes + done));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(out), digitsToText(spreadBlocks(in)));
+		}
+		return done;
+	}
+
+	__attribute__((target("avx2")))
+	std::size_t encodeAvx2(std::uint8_t const *bytes, std::size_t size, char *out)
+	{
+		__m256i const first = _mm256_setr_epi8(
+			1, 0, 1, 0, 2, 1, 2, 1, 3, 2, 4, 3, 4, 3, 5, 4,
+			1, 0, 1, 0, 2, 1, 2, 1, 3, 2, 4, 3, 4, 3, 5, 4);
+		__m256i const second = _mm256_setr_epi8(
+			6, 5, 6, 5, 7, 6, 7, 6, 8, 7, 9, 8, 9, 8, 10, 9,
+			6, 5, 6, 5, 7, 6, 7, 6, 8, 7, 9, 8, 9, 8, 10, 9);
+		__m256i const shifts = _mm256_setr_epi16(
+			1 << 5, 1 << 10, 1 << 7, 1 << 12, 1 << 9, 1 << 6, 1 << 11, 1 << 8,
+			1 << 5, 1 << 10, 1 << 7, 1 << 12, 1 << 9, 1 << 6, 1 << 11, 1 << 8);
+		__m256i const mask = _mm256_set1_epi16(0x1F);
+
+		//20 bytes make 32 characters, each 128 bit lane codes 10 of them
+		std::size_t done = 0;
+		for(; done + 26 <= size; done += 20, out += 32)
+		{
+			__m256i in = _mm256_inserti128_si256(
+				_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<__m128i const *>(bytes + done))),
+				_mm_loadu_si128(reinterpret_cast<__m128i const *>(bytes + done + 10)), 1);
+
+			__m256i lo = _mm256_and_si256(_mm256_mulhi_epu16(_mm256_shuffle_epi8(in, first), shifts), mask);
+			__m256i hi = _mm256_and_si256(_mm256_mulhi_epu16(_mm256_shuffle_epi8(in, second), shifts), mask);
+			__m256i digits = _mm256_packus_epi16(lo, hi);
+
+			__m256i above = _mm256_and_si256(_mm256_cmpgt_epi8(digits, _mm256_set1_epi8(25)), _mm256_set1_epi8('A' - '2' + 26));
+			__m256i text = _mm256_sub_epi8(_mm256_add_epi8(digits, _mm256_set1_epi8('A')), above);
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(out), text);
+		}
+		return done + encodeSsse3(bytes + done, size - done, out);
+	}
+
+	//false if any of the 16 characters is not a digit, whitespace included
+	__attribute__((target("ssse3")))
+	inline bool textToDigits(__m128i text, __m128i &digits)
+	{
+		__m128i letter = _mm_or_si128(
+			_mm_and_si128(_mm_cmpgt_epi8(text, _mm_set1_epi8('A' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('Z' + 1), text)),
+			_mm_and_si128(_mm_cmpgt_epi8(text, _mm_set1_epi8('a' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('z' + 1), text)));
+		__m128i digit = _mm_and_si128(_mm_cmpgt_epi8(text, _mm_set1_epi8('1')), _mm_cmpgt_epi8(_mm_set1_epi8('8'), text));
+		if(_mm_movemask_epi8(_mm_or_si128(letter, digit)) != 0xFFFF)
+			return false;
+
+		__m128i letterValue = _mm_sub_epi8(_mm_and_si128(text, _mm_set1_epi8(0x1F)), _mm_set1_epi8(1));
+		__m128i digitValue = _mm_sub_epi8(text, _mm_set1_epi8('2' - 26));
+		digits = _mm_or_si128(_mm_and_si128(letter, letterValue), _mm_andnot_si128(letter, digitValue));
+		return true;
+	}
+
+	//joins 16 digits into two 40 bit blocks in the low bytes of the 64 bit lanes, then reverses them
+	__attribute__((target("ssse3")))
+	inline __m128i joinBlocks(__m128i digits)
+	{
+		__m128i pairs = _mm_maddubs_epi16(digits, _mm_set1_epi16(0x0120));
+		__m128i quads = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00010400));
+		__m128i blocks = _mm_or_si128(
+			_mm_slli_epi64(_mm_and_si128(quads, _mm_set_epi32(0, -1, 0, -1)), 20),
+			_mm_srli_epi64(quads, 32));
+		return _mm_shuffle_epi8(blocks, _mm_setr_epi8(4, 3, 2, 1, 0, 12, 11, 10, 9, 8, -1, -1, -1, -1, -1, -1));
+	}
+
+	__attribute__((target("ssse3")))
+	std::size_t decodeSsse3(char const *text, std::size_t length, std::uint8_t *bytes)
+	{
+		//16 bytes are stored for 10 while there is room, the last block goes through a copy
+		std::size_t done = 0;
+		for(std::size_t t = 0; t + 16 <= length; t += 16, done += 10)
+		{
+			__m128i digits;
+			if(!textToDigits(_mm_loadu_si128(reinterpret_cast<__m128i const *>(text + t)), digits))
+				break;
+
+			__m128i blocks = joinBlocks(digits);
+			if(t + 32 <= length)
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(bytes + done), blocks);
+			else
+			{
+				std::uint8_t last[16];
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(last), blocks);
+				std::memcpy(bytes + done, last, 10);
+			}
+		}
+		return done;
+	}
+
+	__attribute__((target("avx2")))
+	std::size_t decodeAvx2(char const *text, std::size_t length, std::uint8_t *bytes)
+	{
+		__m256i const upperA = _mm256_set1_epi8('A' - 1), upperZ = _mm256_set1_epi8('Z' + 1);
+		__m256i const lowerA = _mm256_set1_epi8('a' - 1), lowerZ = _mm256_set1_epi8('z' + 1);
+		__m256i const digit1 = _mm256_set1_epi8('1'), digit8 = _mm256_set1_epi8('8');
+
+		//32 characters make 20 bytes, written as two 16 byte stores overlapping by 6
+		std::size_t done = 0;
+		std::size_t t = 0;
+		for(; t + 48 <= length; t += 32, done += 20)
+		{
+			__m256i in = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(text + t));
+			__m256i letter = _mm256_or_si256(
+				_mm256_and_si256(_mm256_cmpgt_epi8(in, upperA), _mm256_cmpgt_epi8(upperZ, in)),
+				_mm256_and_si256(_mm256_cmpgt_epi8(in, lowerA), _mm256_cmpgt_epi8(lowerZ, in)));
+			__m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(in, digit1), _mm256_cmpgt_epi8(digit8, in));
+			if(_mm256_movemask_epi8(_mm256_or_si256(letter, digit)) != -1)
+				break;
+
+			__m256i letterValue = _mm256_sub_epi8(_mm256_and_si256(in, _mm256_set1_epi8(0x1F)), _mm256_set1_epi8(1));
+			__m256i digitValue = _mm256_sub_epi8(in, _mm256_set1_epi8('2' - 26));
+			__m256i digits = _mm256_or_si256(_mm256_and_si256(letter, letterValue), _mm256_andnot_si256(letter, digitValue));
+
+			__m256i pairs = _mm256_maddubs_epi16(digits, _mm256_set1_epi16(0x0120));
+			__m256i quads = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00010400));
+			__m256i blocks = _mm256_or_si256(
+				_mm256_slli_epi64(_mm256_and_si256(quads, _mm256_set1_epi64x(0xFFFFFFFF)), 20),
+				_mm256_srli_epi64(quads, 32));
+			blocks = _mm256_shuffle_epi8(blocks, _mm256_setr_epi8(
+				4, 3, 2, 1, 0, 12, 11, 10, 9, 8, -1, -1, -1, -1, -1, -1,
+				4, 3, 2, 1, 0, 12, 11, 10, 9, 8, -1, -1, -1, -1, -1, -1));
+
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(bytes + done), _mm256_castsi256_si128(blocks));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(bytes + done + 10), _mm256_extracti128_si256(blocks, 1));
+		}
+		return done + decodeSsse3(text + t, length - t, bytes + done);
+	}
+
+#endif //BASE32_X86_KERNELS
 
-			int index = 0x1F & (buffer >> (bitsLeft - 5));
-			bitsLeft -= 5;
-			os << "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567"[index];
+	Kernel fastestKernel()
+	{
+		Kernel fastest = SCALAR;
+		for(int k = SCALAR; k < KERNELS; ++k)
+			if(isSupported(static_cast<Kernel>(k)))
+				fastest = static_cast<Kernel>(k);
+		return fastest;
+	}
+
+	atomic<int>& selectedKernel()
+	{
+		static atomic<int> selected(fastestKernel());
+		return selected;
+	}
+
+	EncodeKernel encodeKernel()
+	{
+		switch(selectedKernel().load(boost::memory_order_relaxed))
+		{
+#if defined(BASE32_X86_KERNELS)
+		case SSSE3: return &encodeSsse3;
+		case AVX2: return &encodeAvx2;
+#endif
+		default: return &encodeScalar;
+		}
+	}
+
+	DecodeKernel decodeKernel()
+	{
+		switch(selectedKernel().load(boost::memory_order_relaxed))
+		{
+#if defined(BASE32_X86_KERNELS)
+		case SSSE3: return &decodeSsse3;
+		case AVX2: return &decodeAvx2;
+#endif
+		default: return &decodeScalar;
+		}
+	}
+
+} //namespace
+
+bool isSupported(Kernel kernel)
+{
+	switch(kernel)
+	{
+	case SCALAR: return true;
+#if defined(BASE32_X86_KERNELS)
+	case SSSE3: return __builtin_cpu_supports("ssse3");
+	case AVX2: return __builtin_cpu_supports("avx2");
+#endif
+	default: return false;
+	}
+}
+
+Kernel getKernel()
+{
+	return static_cast<Kernel>(selectedKernel().load(boost::memory_order_relaxed));
+}
+
+bool setKernel(Kernel kernel)
+{
+	if(!isSupported(kernel))
+		return false;
+	selectedKernel().store(kernel, boost::memory_order_relaxed);
+	return true;
+}
+
+char const* kernelName(Kernel kernel)
+{
+	switch(kernel)
+	{
+	case SCALAR: return "scalar";
+	case SSSE3: return "ssse3";
+	case AVX2: return "avx2";
+	default: return "unknown";
+	}
+}
+
+bool encode(void const *data, std::size_t size, std::ostream &os)
+{
+	//coded in chunks of whole blocks on the stack
+	std::uint8_t const *bytes = reinterpret_cast<std::uint8_t const *>(data);
+	char text[8192];
+	std::size_t const CHUNK = sizeof(text) / 8 * 5;
+	for(std::size_t offset = 0; offset < size; offset += CHUNK)
+	{
+		std::size_t chunk = std::min(CHUNK, size - offset);
+		encode(bytes + offset, chunk, text);
+		os.write(text, encodedSize(chunk));
+	}
+	return true;
+}
+
+std::size_t encodedSize(std::size_t size)
+{
+	return (size * 8 + 4) / 5;
+}
+
+void encode(void const *data, std::size_t size, char *out)
+{
+	std::uint8_t const *bytes = reinterpret_cast<std::uint8_t const *>(data);
+	std::size_t done = encodeKernel()(bytes, size, out);
+	done += encodeScalar(bytes + done, size - done, out + done / 5 * 8);
+	out += done / 5 * 8;
+
+	//the tail bits left aligned, no padding characters
+	std::size_t tail = size - done;
+	if(tail > 0)
+	{
+		std::uint64_t block = 0;
+		for(std::size_t b = 0; b < tail; ++b)
+			block |= std::uint64_t(bytes[done + b]) << (32 - b * 8);
+		std::size_t chars = encodedSize(tail);
+		for(std::size_t c = 0; c < chars; ++c)
+			*out++ = ALPHABET[(block >> (35 - c * 5)) & 0x1F];
+	}
+}
+
+bool decode(char const *text, std::size_t length, void *data, std::size_t size)
+{
+	std::uint8_t *bytes = reinterpret_cast<std::uint8_t *>(data);
+	char const *end = text + length;
+	std::size_t count = 0;
+	unsigned buffer = 0;
+	int bitsLeft = 0;
+	while(count < size)
+	{
+		//whole blocks go through the kernels while no separator breaks them up
+		if(bitsLeft == 0 && size - count >= 5)
+		{
+			std::size_t blocks = std::min<std::size_t>((size - count) / 5, (end - text) / 8);
+			std::size_t decoded = decodeKernel()(text, blocks * 8, bytes + count);
+			decoded += decodeScalar(text + decoded / 5 * 8, (blocks - decoded / 5) * 8, bytes + count + decoded);
+			text += decoded / 5 * 8;
+			count += decoded;
+			if(count == size)
+				break;
+		}
+
+		if(text == end)
+			return false;
+
+		char ch = *text++;
+		if(ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n' || ch == '-')
+			continue;
+
+		std::uint8_t value = digitValue(ch);
+		if(value == 0xFF)
+			return false;
+
+		buffer = buffer << 5 | value;
+		bitsLeft += 5;
+		if(bitsLeft >= 8)
+		{
+			bytes[count++] = static_cast<std::uint8_t>(buffer >> (bitsLeft - 8));
+			bitsLeft -= 8;
 		}
 	}
 	return true;
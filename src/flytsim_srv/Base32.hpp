@@ -5,9 +5,23 @@
 
 namespace srv { namespace base32 {
 
+	//whole 5 byte blocks are coded by a kernel picked from the cpu features, the fastest by default
+	enum Kernel { SCALAR, SSSE3, AVX2, KERNELS };
+
+	extern bool isSupported(Kernel kernel);
+	extern Kernel getKernel();
+	extern bool setKernel(Kernel kernel);
+	extern char const* kernelName(Kernel kernel);
+
 	extern bool encode(void const *data, std::size_t size, std::ostream &os);
 	extern bool decode(void *data, std::size_t size, std::istream &is);
 
+	//out has room for encodedSize(size) characters
+	extern std::size_t encodedSize(std::size_t size);
+	extern void encode(void const *data, std::size_t size, char *out);
+	//spaces, line breaks and dashes are skipped like by the stream decoder, characters after size bytes are ignored
+	extern bool decode(char const *text, std::size_t length, void *data, std::size_t size);
+
 } //namespace base32
 } //namespace srv
 
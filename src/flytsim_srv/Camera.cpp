@@ -0,0 +1,179 @@
+#include "Camera.hpp"
+#include "Server.hpp"
+
+namespace srv {
+
+CameraProfile::CameraProfile()
+	: topic(Server::DEFAULT_CAMERA_TOPIC)
+	, transport(Server::DEFAULT_CAMERA_TRANSPORT)
+	, queue(Server::DEFAULT_CAMERA_QUEUE)
+	, idleSeconds(Server::DEFAULT_CAMERA_IDLE_SECONDS)
+{
+}
+
+std::ostream& operator<<(std::ostream &os, CameraProfile const &profile)
+{
+	return os <<
+		"topic:" << profile.topic <<
+		" transport:" << profile.transport <<
+		" queue:" << profile.queue <<
+		" idle:" << (profile.idleSeconds ? std::to_string(profile.idleSeconds) + "s" : std::string("never"));
+}
+
+char const Camera::RAW_TRANSPORT[] = "raw";
+char const Camera::COMPRESSED_TRANSPORT[] = "compressed";
+
+Camera::Camera(std::size_t index, CameraProfile const &profile, FrameHandler handler)
+	: m_Index(index)
+	, m_Profile(profile)
+	, m_Subscriber()
+	, m_CompressedSubscriber()
+	, m_RejectedFormat(false)
+	, m_Handler(std::move(handler))
+	, m_Subscribed(false)
+	, m_LastDemand(0)
+	, m_FrameSlot()
+	, m_FrameHistory()
+	, m_EncodedImageCache()
+{
+}
+
+std::size_t Camera::index() const
+{
+	return m_Index;
+}
+
+CameraProfile const& Camera::profile() const
+{
+	return m_Profile;
+}
+
+void Camera::subscribe(ros::NodeHandle &handle, image_transport::ImageTransport &transport)
+{
+	SERVER_LOG(info) << "subscribing camera " << m_Index << ": " << m_Profile.topic << " (" << m_Profile.transport << ")";
+	if(m_Profile.transport == COMPRESSED_TRANSPORT)
+	{
+		//the topic image_transport publishes the compressed plugin on
+		m_RejectedFormat = false;
+		m_CompressedSubscriber = std::make_shared<ros::Subscriber>(
+			handle.subscribe(
+				m_Profile.topic + "/" + COMPRESSED_TRANSPORT,
+				m_Profile.queue,
+				&Camera::onCompressedImage,
+				this
+			)
+		);
+	}
+	else
+	{
+		m_Subscriber = std::make_shared<image_transport::Subscriber>(
+			transport.subscribe(
+				m_Profile.topic,
+				m_Profile.queue,
+				std::bind(
+					&Camera::onImage,
+					this,
+					std::placeholders::_1
+				)
+			)
+		);
+	}
+	m_Subscribed = true;
+}
+
+void Camera::unsubscribe()
+{
+	SERVER_LOG(info) << "unsubscribing camera " << m_Index << ": " << m_Profile.topic;
+	m_Subscribed = false;
+	if(m_Subscriber)
+	{
+		m_Subscriber->shutdown();
+		m_Subscriber.reset();
+	}
+	if(m_CompressedSubscriber)
+	{
+		m_CompressedSubscriber->shutdown();
+		m_CompressedSubscriber.reset();
+	}
+
+	//frames from before the pause would be served as current once subscribed again
+	m_FrameSlot.reset();
+	m_FrameHistory.clear();
+}
+
+bool Camera::isSubscribed() const
+{
+	return m_Subscribed;
+}
+
+void Camera::demand()
+{
+	m_LastDemand = std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+std::chrono::steady_clock::duration Camera::sinceDemand() const
+{
+	return std::chrono::steady_clock::now().time_since_epoch() - std::chrono::steady_clock::duration(m_LastDemand.load());
+}
+
+void Camera::play(std::shared_ptr<Frame> const &frame)
+{
+	//a recording played in a loop would repeat its seqs and stamps
+	frame->seq = m_FrameSlot.nextSeq();
+	frame->stamp = ros::Time::now();
+	frame->received = std::chrono::system_clock::now();
+	onFrame(frame);
+}
+
+FramePtr Camera::getFrame() const
+{
+	return m_FrameSlot.load();
+}
+
+FrameHistory& Camera::frameHistory()
+{
+	return m_FrameHistory;
+}
+
+FrameHistory const& Camera::frameHistory() const
+{
+	return m_FrameHistory;
+}
+
+EncodedImageCache& Camera::encodedImageCache()
+{
+	return m_EncodedImageCache;
+}
+
+EncodedImageCache const& Camera::encodedImageCache() const
+{
+	return m_EncodedImageCache;
+}
+
+void Camera::onImage(sensor_msgs::ImageConstPtr const &img)
+{
+	SERVER_LOG(trace) << "ROS image received from camera " << m_Index;
+	onFrame(makeFrame(img, m_FrameSlot.nextSeq()));
+}
+
+void Camera::onCompressedImage(sensor_msgs::CompressedImageConstPtr const &img)
+{
+	SERVER_LOG(trace) << "ROS compressed image received from camera " << m_Index;
+	FramePtr frame = makeFrame(img, m_FrameSlot.nextSeq());
+	if(!frame)
+	{
+		if(!m_RejectedFormat.exchange(true))
+			SERVER_LOG(warning) << "camera " << m_Index << " dropped " << img->format << " frames, only jpeg is passed through";
+		return;
+	}
+	onFrame(frame);
+}
+
+void Camera::onFrame(FramePtr const &frame)
+{
+	m_FrameSlot.store(frame);
+	m_FrameHistory.push(frame);
+	m_Handler(*this, frame);
+}
+
+} //namespace srv
@@ -0,0 +1,78 @@
+#ifndef CAMERA_HPP
+#define CAMERA_HPP
+
+#include "Config.hpp"
+#include "Frame.hpp"
+#include "FrameHistory.hpp"
+#include "EncodedImage.hpp"
+
+namespace srv {
+
+//a camera is subscribed once an image consumer shows up and unsubscribed when they are gone for a while
+struct CameraProfile
+{
+	CameraProfile();
+
+	std::string topic;
+	std::string transport;		//raw, or compressed to subscribe topic/compressed and pass its jpeg through
+	std::uint32_t queue;		//image_transport subscriber queue depth
+	std::uint32_t idleSeconds;	//without get_image, waits or subscriptions, 0 keeps the camera subscribed
+};
+
+extern std::ostream& operator<<(std::ostream &os, CameraProfile const &profile);
+
+//one image topic with its latest frame, recent frames and their encodings
+class Camera
+{
+public:
+	//called from ROS threads or the player after the frame is stored
+	typedef std::function<void (Camera &camera, FramePtr const &frame)> FrameHandler;
+
+	Camera(std::size_t index, CameraProfile const &profile, FrameHandler handler);
+
+	std::size_t index() const;
+	CameraProfile const& profile() const;
+
+	static char const RAW_TRANSPORT[];
+	static char const COMPRESSED_TRANSPORT[];
+
+	//the server serializes subscribing and unsubscribing
+	void subscribe(ros::NodeHandle &handle, image_transport::ImageTransport &transport);
+	void unsubscribe();
+	bool isSubscribed() const;
+
+	void demand();
+	std::chrono::steady_clock::duration sinceDemand() const;
+
+	//a recorded frame in place of the topic, numbered and stamped as a new one
+	void play(std::shared_ptr<Frame> const &frame);
+
+	FramePtr getFrame() const;
+	FrameHistory& frameHistory();
+	FrameHistory const& frameHistory() const;
+	EncodedImageCache& encodedImageCache();
+	EncodedImageCache const& encodedImageCache() const;
+
+private:
+	void onImage(sensor_msgs::ImageConstPtr const &img);
+	//the message is kept as is, no image_transport plugin decompresses it
+	void onCompressedImage(sensor_msgs::CompressedImageConstPtr const &img);
+	void onFrame(FramePtr const &frame);
+
+private:
+	std::size_t m_Index;
+	CameraProfile m_Profile;
+	std::shared_ptr<image_transport::Subscriber> m_Subscriber;
+	std::shared_ptr<ros::Subscriber> m_CompressedSubscriber;
+	atomic<bool> m_RejectedFormat;		//a compressed message that is not jpeg was logged
+	FrameHandler m_Handler;
+	atomic<bool> m_Subscribed;
+	atomic<std::chrono::steady_clock::rep> m_LastDemand;
+	FrameSlot m_FrameSlot;
+	FrameHistory m_FrameHistory;
+	EncodedImageCache m_EncodedImageCache;
+};
+
+} //namespace srv
+
+#endif //CAMERA_HPP
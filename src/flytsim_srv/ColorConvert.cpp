@@ -0,0 +1,342 @@
+#include "ColorConvert.hpp"
+#include <sensor_msgs/image_encodings.h>
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FLYTSIM_COLOR_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace srv { namespace color {
+
+char const YUV420[] = "yuv420";
+
+namespace {
+
+	//BT.601 full range, fixed point with 8 fractional bits
+	std::int16_t const Y_R = 77, Y_G = 150, Y_B = 29;
+	std::int16_t const U_R = -43, U_G = -85, U_B = 128;
+	std::int16_t const V_R = 128, V_G = -107, V_B = -21;
+
+	//rows are split into planes first, the kernels then work on contiguous bytes
+	struct Planes
+	{
+		explicit Planes(std::size_t width)
+			: r(width)
+			, g(width)
+			, b(width)
+		{
+		}
+
+		std::vector<std::uint8_t> r, g, b;
+	};
+
+	void split(std::uint8_t const *src, Layout const &from, std::uint32_t width, Planes &planes)
+	{
+		std::uint8_t *r = planes.r.data(), *g = planes.g.data(), *b = planes.b.data();
+		for(std::uint32_t x = 0; x < width; ++x, src += from.channels)
+		{
+			r[x] = src[from.r];
+			g[x] = src[from.g];
+			b[x] = src[from.b];
+		}
+	}
+
+	std::uint8_t lumaPixel(std::uint8_t r, std::uint8_t g, std::uint8_t b)
+	{
+		return static_cast<std::uint8_t>((Y_R * r + Y_G * g + Y_B * b + 128) >> 8);
+	}
+
+	//the sums stay within signed 16 bits, adding 32768 keeps the shift on non negative values
+	std::uint8_t chromaPixel(std::int16_t cr, std::int16_t cg, std::int16_t cb, std::uint8_t r, std::uint8_t g, std::uint8_t b)
+	{
+		return static_cast<std::uint8_t>((cr * r + cg * g + cb * b + 32768) >> 8);
+	}
+
+#if defined(FLYTSIM_COLOR_AVX2)
+	__attribute__((target("avx2")))
+	std::size_t lumaAvx2(std::uint8_t *y, std::uint8_t const *r, std::uint8_t const *g, std::uint8_t const *b, std::size_t size)
+	{
+		__m256i const zero = _mm256_setzero_si256();
+		__m256i const cr = _mm256_set1_epi16(Y_R), cg = _mm256_set1_epi16(Y_G), cb = _mm256_set1_epi16(Y_B);
+		__m256i const half = _mm256_set1_epi16(128);
+		std::size_t i = 0;
+		for(; i + 32 <= size; i += 32)
+		{
+			__m256i vr = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(r + i));
+			__m256i vg = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(g + i));
+			__m256i vb = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(b + i));
+
+			//unpacking and packing within the 128 bit lanes keeps the byte order
+			__m256i lo = _mm256_add_epi16(
+				_mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(vr, zero), cr), _mm256_mullo_epi16(_mm256_unpacklo_epi8(vg, zero), cg)),
+				_mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(vb, zero), cb), half)
+			);
+			__m256i hi = _mm256_add_epi16(
+				_mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(vr, zero), cr), _mm256_mullo_epi16(_mm256_unpackhi_epi8(vg, zero), cg)),
+				_mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(vb, zero), cb), half)
+			);
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(y + i), _mm256_packus_epi16(_mm256_srli_epi16(lo, 8), _mm256_srli_epi16(hi, 8)));
+		}
+		return i;
+	}
+
+	__attribute__((target("avx2")))
+	std::size_t chromaAvx2(std::uint8_t *u, std::uint8_t *v, std::uint8_t const *r, std::uint8_t const *g, std::uint8_t const *b, std::size_t size)
+	{
+		__m256i const zero = _mm256_setzero_si256();
+		__m256i const ur = _mm256_set1_epi16(U_R), ug = _mm256_set1_epi16(U_G), ub = _mm256_set1_epi16(U_B);
+		__m256i const vr_ = _mm256_set1_epi16(V_R), vg_ = _mm256_set1_epi16(V_G), vb_ = _mm256_set1_epi16(V_B);
+		__m256i const bias = _mm256_set1_epi16(128);
+		std::size_t i = 0;
+		for(; i + 32 <= size; i += 32)
+		{
+			__m256i vr = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(r + i));
+			__m256i vg = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(g + i));
+			__m256i vb = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(b + i));
+			__m256i rl = _mm256_unpacklo_epi8(vr, zero), rh = _mm256_unpackhi_epi8(vr, zero);
+			__m256i gl = _mm256_unpacklo_epi8(vg, zero), gh = _mm256_unpackhi_epi8(vg, zero);
+			__m256i bl = _mm256_unpacklo_epi8(vb, zero), bh = _mm256_unpackhi_epi8(vb, zero);
+
+			__m256i ul = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(rl, ur), _mm256_mullo_epi16(gl, ug)), _mm256_mullo_epi16(bl, ub));
+			__m256i uh = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(rh, ur), _mm256_mullo_epi16(gh, ug)), _mm256_mullo_epi16(bh, ub));
+			__m256i vl = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(rl, vr_), _mm256_mullo_epi16(gl, vg_)), _mm256_mullo_epi16(bl, vb_));
+			__m256i vh = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(rh, vr_), _mm256_mullo_epi16(gh, vg_)), _mm256_mullo_epi16(bh, vb_));
+
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(u + i), _mm256_packus_epi16(
+				_mm256_add_epi16(_mm256_srai_epi16(ul, 8), bias), _mm256_add_epi16(_mm256_srai_epi16(uh, 8), bias)));
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(v + i), _mm256_packus_epi16(
+				_mm256_add_epi16(_mm256_srai_epi16(vl, 8), bias), _mm256_add_epi16(_mm256_srai_epi16(vh, 8), bias)));
+		}
+		return i;
+	}
+
+	bool hasAvx2()
+	{
+		static bool const avx2 = __builtin_cpu_supports("avx2");
+		return avx2;
+	}
+#endif
+
+#if defined(__SSE2__)
+	std::size_t lumaSse2(std::uint8_t *y, std::uint8_t const *r, std::uint8_t const *g, std::uint8_t const *b, std::size_t size)
+	{
+		__m128i const zero = _mm_setzero_si128();
+		__m128i const cr = _mm_set1_epi16(Y_R), cg = _mm_set1_epi16(Y_G), cb = _mm_set1_epi16(Y_B);
+		__m128i const half = _mm_set1_epi16(128);
+		std::size_t i = 0;
+		for(; i + 16 <= size; i += 16)
+		{
+			__m128i vr = _mm_loadu_si128(reinterpret_cast<__m128i const *>(r + i));
+			__m128i vg = _mm_loadu_si128(reinterpret_cast<__m128i const *>(g + i));
+			__m128i vb = _mm_loadu_si128(reinterpret_cast<__m128i const *>(b + i));
+
+			//255 * 256 + 128 still fits unsigned 16 bits
+			__m128i lo = _mm_add_epi16(
+				_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(vr, zero), cr), _mm_mullo_epi16(_mm_unpacklo_epi8(vg, zero), cg)),
+				_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), cb), half)
+			);
+			__m128i hi = _mm_add_epi16(
+				_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(vr, zero), cr), _mm_mullo_epi16(_mm_unpackhi_epi8(vg, zero), cg)),
+				_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), cb), half)
+			);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(y + i), _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+		}
+		return i;
+	}
+
+	std::size_t chromaSse2(std::uint8_t *u, std::uint8_t *v, std::uint8_t const *r, std::uint8_t const *g, std::uint8_t const *b, std::size_t size)
+	{
+		__m128i const zero = _mm_setzero_si128();
+		__m128i const ur = _mm_set1_epi16(U_R), ug = _mm_set1_epi16(U_G), ub = _mm_set1_epi16(U_B);
+		__m128i const vr_ = _mm_set1_epi16(V_R), vg_ = _mm_set1_epi16(V_G), vb_ = _mm_set1_epi16(V_B);
+		__m128i const bias = _mm_set1_epi16(128);
+		std::size_t i = 0;
+		for(; i + 16 <= size; i += 16)
+		{
+			__m128i vr = _mm_loadu_si128(reinterpret_cast<__m128i const *>(r + i));
+			__m128i vg = _mm_loadu_si128(reinterpret_cast<__m128i const *>(g + i));
+			__m128i vb = _mm_loadu_si128(reinterpret_cast<__m128i const *>(b + i));
+			__m128i rl = _mm_unpacklo_epi8(vr, zero), rh = _mm_unpackhi_epi8(vr, zero);
+			__m128i gl = _mm_unpacklo_epi8(vg, zero), gh = _mm_unpackhi_epi8(vg, zero);
+			__m128i bl = _mm_unpacklo_epi8(vb, zero), bh = _mm_unpackhi_epi8(vb, zero);
+
+			__m128i ul = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(rl, ur), _mm_mullo_epi16(gl, ug)), _mm_mullo_epi16(bl, ub));
+			__m128i uh = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(rh, ur), _mm_mullo_epi16(gh, ug)), _mm_mullo_epi16(bh, ub));
+			__m128i vl = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(rl, vr_), _mm_mullo_epi16(gl, vg_)), _mm_mullo_epi16(bl, vb_));
+			__m128i vh = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(rh, vr_), _mm_mullo_epi16(gh, vg_)), _mm_mullo_epi16(bh, vb_));
+
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(u + i), _mm_packus_epi16(
+				_mm_add_epi16(_mm_srai_epi16(ul, 8), bias), _mm_add_epi16(_mm_srai_epi16(uh, 8), bias)));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(v + i), _mm_packus_epi16(
+				_mm_add_epi16(_mm_srai_epi16(vl, 8), bias), _mm_add_epi16(_mm_srai_epi16(vh, 8), bias)));
+		}
+		return i;
+	}
+#endif
+
+	void luma(std::uint8_t *y, Planes const &planes, std::size_t size)
+	{
+		std::uint8_t const *r = planes.r.data(), *g = planes.g.data(), *b = planes.b.data();
+		std::size_t i = 0;
+#if defined(FLYTSIM_COLOR_AVX2)
+		if(hasAvx2())
+			i = lumaAvx2(y, r, g, b, size);
+#endif
+#if defined(__SSE2__)
+		i += lumaSse2(y + i, r + i, g + i, b + i, size - i);
+#endif
+		for(; i < size; ++i)
+			y[i] = lumaPixel(r[i], g[i], b[i]);
+	}
+
+	void chroma(std::uint8_t *u, std::uint8_t *v, Planes const &planes, std::size_t size)
+	{
+		std::uint8_t const *r = planes.r.data(), *g = planes.g.data(), *b = planes.b.data();
+		std::size_t i = 0;
+#if defined(FLYTSIM_COLOR_AVX2)
+		if(hasAvx2())
+			i = chromaAvx2(u, v, r, g, b, size);
+#endif
+#if defined(__SSE2__)
+		i += chromaSse2(u + i, v + i, r + i, g + i, b + i, size - i);
+#endif
+		for(; i < size; ++i)
+		{
+			u[i] = chromaPixel(U_R, U_G, U_B, r[i], g[i], b[i]);
+			v[i] = chromaPixel(V_R, V_G, V_B, r[i], g[i], b[i]);
+		}
+	}
+
+	//averages 2x2 blocks of two split rows, the last odd column is averaged with itself
+	void subsample(Planes const &row0, Planes const &row1, std::uint32_t width, Planes &half)
+	{
+		std::vector<std::uint8_t> const *src0[3] = { &row0.r, &row0.g, &row0.b };
+		std::vector<std::uint8_t> const *src1[3] = { &row1.r, &row1.g, &row1.b };
+		std::vector<std::uint8_t> *dst[3] = { &half.r, &half.g, &half.b };
+
+		for(int c = 0; c < 3; ++c)
+		{
+			std::uint8_t const *a = src0[c]->data(), *b = src1[c]->data();
+			std::uint8_t *d = dst[c]->data();
+			for(std::uint32_t x = 0; x < width; x += 2)
+			{
+				std::uint32_t x1 = std::min(x + 1, width - 1);
+				d[x / 2] = static_cast<std::uint8_t>((a[x] + a[x1] + b[x] + b[x1] + 2) >> 2);
+			}
+		}
+	}
+
+} //namespace anonymous
+
+bool sourceLayout(std::string const &encoding, Layout &layout)
+{
+	namespace enc = sensor_msgs::image_encodings;
+	if(encoding == enc::MONO8)
+		layout = Layout{ 1, 0, 0, 0 };
+	else if(encoding == enc::RGB8)
+		layout = Layout{ 3, 0, 1, 2 };
+	else if(encoding == enc::BGR8)
+		layout = Layout{ 3, 2, 1, 0 };
+	else if(encoding == enc::RGBA8)
+		layout = Layout{ 4, 0, 1, 2 };
+	else if(encoding == enc::BGRA8)
+		layout = Layout{ 4, 2, 1, 0 };
+	else
+		return false;
+	return true;
+}
+
+bool isTarget(std::string const &encoding)
+{
+	namespace enc = sensor_msgs::image_encodings;
+	return encoding == enc::MONO8 || encoding == enc::RGB8 || encoding == enc::BGR8 || encoding == YUV420;
+}
+
+std::size_t imageSize(std::string const &encoding, std::uint32_t width, std::uint32_t height)
+{
+	if(encoding == YUV420)
+		return std::size_t(width) * height + 2 * (std::size_t(width + 1) / 2) * ((height + 1) / 2);
+
+	Layout layout;
+	sourceLayout(encoding, layout);
+	return std::size_t(width) * layout.channels * height;
+}
+
+void interleaved(resample::Pixels const &src, Layout const &from, Layout const &to, std::uint8_t *dst, std::size_t dstStep)
+{
+	for(std::uint32_t y = 0; y < src.height; ++y)
+	{
+		std::uint8_t const *in = src.data + y * src.step;
+		std::uint8_t *out = dst + y * dstStep;
+		for(std::uint32_t x = 0; x < src.width; ++x, in += from.channels, out += to.channels)
+		{
+			out[to.r] = in[from.r];
+			out[to.g] = in[from.g];
+			out[to.b] = in[from.b];
+		}
+	}
+}
+
+void mono(resample::Pixels const &src, Layout const &from, std::uint8_t *dst, std::size_t dstStep)
+{
+	if(from.channels == 1)
+	{
+		resample::copy(src, dst, dstStep);
+		return;
+	}
+
+	Planes planes(src.width);
+	for(std::uint32_t y = 0; y < src.height; ++y)
+	{
+		split(src.data + y * src.step, from, src.width, planes);
+		luma(dst + y * dstStep, planes, src.width);
+	}
+}
+
+void yuv420(resample::Pixels const &src, Layout const &from, std::uint8_t *dst, std::uint32_t rowBegin, std::uint32_t rowEnd)
+{
+	std::uint32_t halfWidth = (src.width + 1) / 2;
+	std::uint32_t halfHeight = (src.height + 1) / 2;
+	std::uint8_t *yPlane = dst;
+	std::uint8_t *uPlane = yPlane + std::size_t(src.width) * src.height;
+	std::uint8_t *vPlane = uPlane + std::size_t(halfWidth) * halfHeight;
+
+	std::uint32_t halfBegin = rowBegin / 2;
+	std::uint32_t halfEnd = (rowEnd + 1) / 2;
+	if(from.channels == 1)
+	{
+		resample::Pixels rows = src;
+		rows.data += std::size_t(rowBegin) * src.step;
+		rows.height = rowEnd - rowBegin;
+		resample::copy(rows, yPlane + std::size_t(rowBegin) * src.width, src.width);
+		std::memset(uPlane + std::size_t(halfBegin) * halfWidth, 128, std::size_t(halfWidth) * (halfEnd - halfBegin));
+		std::memset(vPlane + std::size_t(halfBegin) * halfWidth, 128, std::size_t(halfWidth) * (halfEnd - halfBegin));
+		return;
+	}
+
+	Planes row0(src.width), row1(src.width), half(halfWidth);
+	for(std::uint32_t y = rowBegin; y < rowEnd; y += 2)
+	{
+		split(src.data + y * src.step, from, src.width, row0);
+		luma(yPlane + std::size_t(y) * src.width, row0, src.width);
+
+		//the last odd row is averaged with itself
+		if(y + 1 < src.height)
+		{
+			split(src.data + (y + 1) * src.step, from, src.width, row1);
+			luma(yPlane + std::size_t(y + 1) * src.width, row1, src.width);
+		}
+
+		subsample(row0, y + 1 < src.height ? row1 : row0, src.width, half);
+		chroma(uPlane + std::size_t(y / 2) * halfWidth, vPlane + std::size_t(y / 2) * halfWidth, half, halfWidth);
+	}
+}
+
+} //namespace color
+} //namespace srv
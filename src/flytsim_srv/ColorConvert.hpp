@@ -0,0 +1,36 @@
+#ifndef COLOR_CONVERT_HPP
+#define COLOR_CONVERT_HPP
+
+#include "Config.hpp"
+#include "Resample.hpp"
+
+namespace srv { namespace color {
+
+	//planar Y, U and V, chroma subsampled 2x2, not a ROS encoding
+	extern char const YUV420[];
+
+	//byte offsets of the color channels in a pixel, all 0 for mono8
+	struct Layout
+	{
+		std::uint32_t channels;
+		std::uint32_t r, g, b;
+	};
+
+	//false for encodings that cannot be converted from: bayer, 16 bit, yuv
+	extern bool sourceLayout(std::string const &encoding, Layout &layout);
+	//mono8, rgb8, bgr8 and yuv420
+	extern bool isTarget(std::string const &encoding);
+	extern std::size_t imageSize(std::string const &encoding, std::uint32_t width, std::uint32_t height);
+
+	//converts between the interleaved rgb8, bgr8 and mono8
+	extern void interleaved(resample::Pixels const &src, Layout const &from, Layout const &to, std::uint8_t *dst, std::size_t dstStep);
+	//BT.601 luma
+	extern void mono(resample::Pixels const &src, Layout const &from, std::uint8_t *dst, std::size_t dstStep);
+	//the planes follow each other in dst: Y, then U and V of (width + 1) / 2 x (height + 1) / 2,
+	//only rows rowBegin to rowEnd are converted, rowBegin has to be even
+	extern void yuv420(resample::Pixels const &src, Layout const &from, std::uint8_t *dst, std::uint32_t rowBegin, std::uint32_t rowEnd);
+
+} //namespace color
+} //namespace srv
+
+#endif //COLOR_CONVERT_HPP
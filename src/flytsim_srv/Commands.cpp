@@ -2,5 +2,21 @@
 
 namespace srv { namespace cmd {
 
+bool ImageParams::empty() const
+{
+	return !width && !height && !roi && !encoding && !format && !quality;
+}
+
+bool operator==(Roi const &lhs, Roi const &rhs)
+{
+	return lhs.x == rhs.x && lhs.y == rhs.y && lhs.w == rhs.w && lhs.h == rhs.h;
+}
+
+bool operator==(ImageParams const &lhs, ImageParams const &rhs)
+{
+	return lhs.width == rhs.width && lhs.height == rhs.height && lhs.roi == rhs.roi && lhs.encoding == rhs.encoding &&
+		lhs.format == rhs.format && lhs.quality == rhs.quality;
+}
+
 } //namespace cmd
 } //namespace srv
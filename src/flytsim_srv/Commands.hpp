@@ -15,6 +15,27 @@ namespace srv { namespace cmd {
 		optional<bool> async;
 	};
 
+	struct Roi
+	{
+		std::uint32_t x, y, w, h;
+	};
+
+	//applied to the frame before it is sent, a region is cropped first and then scaled
+	struct ImageParams
+	{
+		optional<std::uint32_t> width;		//height follows the aspect ratio when not given
+		optional<std::uint32_t> height;		//width follows the aspect ratio when not given
+		optional<Roi> roi;
+		optional<std::string> encoding;		//mono8, rgb8, bgr8 or yuv420, the camera encoding when not given
+		optional<std::string> format;		//raw, jpeg or lossless qoi, raw when not given
+		optional<std::uint32_t> quality;	//jpeg quality 1 to 100
+
+		bool empty() const;
+	};
+
+	extern bool operator==(Roi const &lhs, Roi const &rhs);
+	extern bool operator==(ImageParams const &lhs, ImageParams const &rhs);
+
 	struct Arm
 	{
 		Common common;
@@ -62,6 +83,54 @@ namespace srv { namespace cmd {
 	};
 
 	struct GetImage
+	{
+		Common common;
+		optional<std::uint64_t> since;		//answer "not_modified" unless a newer frame exists
+		optional<std::uint32_t> timeout;	//milliseconds to wait for a newer frame
+		optional<std::uint64_t> seq;		//a frame from the history
+		optional<double> stamp;				//the history frame closest to the stamp in seconds
+		optional<std::uint64_t> delta;		//seq of the frame the client holds, only its changed tiles are sent
+		ImageParams image;
+	};
+
+	struct GetStats
+	{
+		Common common;
+	};
+
+	struct SubscribeImage
+	{
+		Common common;
+		optional<float> max_fps;
+		optional<std::uint32_t> queue;		//frames waiting behind the one being written
+		optional<bool> keep_latest;			//collapse waiting frames to the newest one
+		optional<bool> adaptive;			//size, quality and rate follow the link, the params are the best level
+		optional<std::uint32_t> target_latency;	//milliseconds a command may wait behind adaptive pushes
+		ImageParams image;
+	};
+
+	struct UnsubscribeImage
+	{
+		Common common;
+	};
+
+	//the frames of several cameras with the closest stamps, in one response
+	struct GetImages
+	{
+		Common common;
+		std::vector<std::uint32_t> cameras;
+		ImageParams image;
+	};
+
+	//pushes updates of the named telemetry topics, at most rate of every topic per second
+	struct SubscribeTelemetry
+	{
+		Common common;
+		std::vector<std::string> topics;
+		optional<float> rate;
+	};
+
+	struct UnsubscribeTelemetry
 	{
 		Common common;
 	};
@@ -75,7 +144,13 @@ namespace srv { namespace cmd {
 		PositionSetpoint,
 		VelocitySetpoint,
 		AttitudeSetpoint,
-		GetImage
+		GetImage,
+		GetStats,
+		SubscribeImage,
+		UnsubscribeImage,
+		GetImages,
+		SubscribeTelemetry,
+		UnsubscribeTelemetry
 	> Command;
 
 
@@ -29,6 +29,24 @@ BOOST_FUSION_ADAPT_STRUCT(
     (boost::optional<bool>, async)
 )
 
+BOOST_FUSION_ADAPT_STRUCT(
+    srv::cmd::Roi,
+    (std::uint32_t, x)
+    (std::uint32_t, y)
+    (std::uint32_t, w)
+    (std::uint32_t, h)
+)
+
+BOOST_FUSION_ADAPT_STRUCT(
+    srv::cmd::ImageParams,
+    (boost::optional<std::uint32_t>, width)
+    (boost::optional<std::uint32_t>, height)
+    (boost::optional<srv::cmd::Roi>, roi)
+    (boost::optional<std::string>, encoding)
+    (boost::optional<std::string>, format)
+    (boost::optional<std::uint32_t>, quality)
+)
+
 BOOST_FUSION_ADAPT_STRUCT(
     srv::cmd::Arm,
     (srv::cmd::Common, common)
@@ -78,6 +96,52 @@ BOOST_FUSION_ADAPT_STRUCT(
 BOOST_FUSION_ADAPT_STRUCT(
     srv::cmd::GetImage,
     (srv::cmd::Common, common)
+    (boost::optional<std::uint64_t>, since)
+    (boost::optional<std::uint32_t>, timeout)
+    (boost::optional<std::uint64_t>, seq)
+    (boost::optional<double>, stamp)
+    (boost::optional<std::uint64_t>, delta)
+    (srv::cmd::ImageParams, image)
+)
+
+BOOST_FUSION_ADAPT_STRUCT(
+    srv::cmd::GetStats,
+    (srv::cmd::Common, common)
+)
+
+BOOST_FUSION_ADAPT_STRUCT(
+    srv::cmd::SubscribeImage,
+    (srv::cmd::Common, common)
+    (boost::optional<float>, max_fps)
+    (boost::optional<std::uint32_t>, queue)
+    (boost::optional<bool>, keep_latest)
+    (boost::optional<bool>, adaptive)
+    (boost::optional<std::uint32_t>, target_latency)
+    (srv::cmd::ImageParams, image)
+)
+
+BOOST_FUSION_ADAPT_STRUCT(
+    srv::cmd::UnsubscribeImage,
+    (srv::cmd::Common, common)
+)
+
+BOOST_FUSION_ADAPT_STRUCT(
+    srv::cmd::GetImages,
+    (srv::cmd::Common, common)
+    (std::vector<std::uint32_t>, cameras)
+    (srv::cmd::ImageParams, image)
+)
+
+BOOST_FUSION_ADAPT_STRUCT(
+    srv::cmd::SubscribeTelemetry,
+    (srv::cmd::Common, common)
+    (std::vector<std::string>, topics)
+    (boost::optional<float>, rate)
+)
+
+BOOST_FUSION_ADAPT_STRUCT(
+    srv::cmd::UnsubscribeTelemetry,
+    (srv::cmd::Common, common)
 )
 
 
@@ -110,7 +174,13 @@ namespace grammar
 				r_PositionSetpoint	|
 				r_VelocitySetpoint	|
 				r_AttitudeSetpoint	|
-				r_GetImage;
+				r_GetImages			|
+				r_GetImage			|
+				r_GetStats			|
+				r_SubscribeImage	|
+				r_UnsubscribeImage	|
+				r_SubscribeTelemetry	|
+				r_UnsubscribeTelemetry;
 
 			r_Arm =
 				qi::lit("arm") >>
@@ -153,6 +223,47 @@ namespace grammar
 
 			r_GetImage =
 				qi::lit("get_image") >>
+				r_Common >>
+				-( qi::lit("since:") 		>> qi::ulong_long ) >>
+				-( qi::lit("timeout:") 		>> qi::uint_ ) 	>>
+				-( qi::lit("seq:") 			>> qi::ulong_long ) >>
+				-( qi::lit("stamp:") 		>> qi::double_ ) >>
+				-( qi::lit("delta:") 		>> qi::ulong_long ) >>
+				r_ImageParams;
+
+			//before get_image, which would match its prefix
+			r_GetImages =
+				qi::lit("get_images") >>
+				r_Common >>
+				qi::lit("cameras:") >> qi::lit("[") >> ( qi::uint_ % qi::lit(",") ) >> qi::lit("]") >>
+				r_ImageParams;
+
+			r_GetStats =
+				qi::lit("get_stats") >>
+				r_Common;
+
+			r_SubscribeImage =
+				qi::lit("subscribe_image") >>
+				r_Common >>
+				-( qi::lit("max_fps:") 		>> qi::float_ ) >>
+				-( qi::lit("queue:") 		>> qi::uint_ ) 	>>
+				-( qi::lit("keep_latest:") 	>> qi::bool_ ) 	>>
+				-( qi::lit("adaptive:") 	>> qi::bool_ ) 	>>
+				-( qi::lit("target_latency:") >> qi::uint_ ) >>
+				r_ImageParams;
+
+			r_UnsubscribeImage =
+				qi::lit("unsubscribe_image") >>
+				r_Common;
+
+			r_SubscribeTelemetry =
+				qi::lit("subscribe_telemetry") >>
+				r_Common >>
+				qi::lit("topics:") >> qi::lit("[") >> ( r_Encoding % qi::lit(",") ) >> qi::lit("]") >>
+				-( qi::lit("rate:") 		>> qi::float_ );
+
+			r_UnsubscribeTelemetry =
+				qi::lit("unsubscribe_telemetry") >>
 				r_Common;
 
 			r_Common =
@@ -165,6 +276,25 @@ namespace grammar
 				qi::float_ >>
 				qi::lit("}");
 
+			r_ImageParams =
+				-( qi::lit("width:") 		>> qi::uint_ ) 	>>
+				-( qi::lit("height:") 		>> qi::uint_ ) 	>>
+				-( qi::lit("roi:") 			>> r_Roi ) 		>>
+				-( qi::lit("encoding:") 	>> r_Encoding ) 	>>
+				-( qi::lit("format:") 		>> r_Encoding ) 	>>
+				-( qi::lit("quality:") 		>> qi::uint_ );
+
+			r_Roi =
+				qi::lit("{") >>
+				qi::uint_ >> qi::lit(",") >>
+				qi::uint_ >> qi::lit(",") >>
+				qi::uint_ >> qi::lit(",") >>
+				qi::uint_ >>
+				qi::lit("}");
+
+			r_Encoding =
+				qi::lexeme[ +qi::char_("a-z0-9_") ];
+
 		}
 
 		qi::rule<Iterator, Command(), ascii::space_type > r_Command;
@@ -176,19 +306,28 @@ namespace grammar
 		qi::rule<Iterator, VelocitySetpoint(), ascii::space_type > r_VelocitySetpoint;
 		qi::rule<Iterator, AttitudeSetpoint(), ascii::space_type > r_AttitudeSetpoint;
 		qi::rule<Iterator, GetImage(), ascii::space_type > r_GetImage;
+		qi::rule<Iterator, GetImages(), ascii::space_type > r_GetImages;
+		qi::rule<Iterator, GetStats(), ascii::space_type > r_GetStats;
+		qi::rule<Iterator, SubscribeImage(), ascii::space_type > r_SubscribeImage;
+		qi::rule<Iterator, UnsubscribeImage(), ascii::space_type > r_UnsubscribeImage;
+		qi::rule<Iterator, SubscribeTelemetry(), ascii::space_type > r_SubscribeTelemetry;
+		qi::rule<Iterator, UnsubscribeTelemetry(), ascii::space_type > r_UnsubscribeTelemetry;
 		qi::rule<Iterator, Common(), ascii::space_type > r_Common;
 		qi::rule<Iterator, Vector3(), ascii::space_type > r_Vector3;
+		qi::rule<Iterator, ImageParams(), ascii::space_type > r_ImageParams;
+		qi::rule<Iterator, Roi(), ascii::space_type > r_Roi;
+		qi::rule<Iterator, std::string(), ascii::space_type > r_Encoding;
 	};
 
 } //namespace grammar
 
-system::error_code parse(std::string const &str, Command &command)
+system::error_code parse(char const *begin, char const *end, Command &command)
 {
-	std::string::const_iterator begin = str.begin();
-	std::string::const_iterator end = str.end();
-	grammar::Rules<std::string::const_iterator> rules;
+	//building the rules allocates, parsing with them does not
+	static grammar::Rules<char const *> const rules;
 
-	if(!grammar::qi::phrase_parse(begin, end, rules, grammar::ascii::space, command))
+	//a field out of order would end the parse early and drop everything after it
+	if(!grammar::qi::phrase_parse(begin, end, rules, grammar::ascii::space, command) || begin != end)
 		return make_error_code(system::errc::invalid_argument);
 
 	return system::error_code();
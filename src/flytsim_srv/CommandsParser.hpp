@@ -6,7 +6,7 @@
 
 namespace srv { namespace cmd {
 
-extern system::error_code parse(std::string const &str, Command &command);
+extern system::error_code parse(char const *begin, char const *end, Command &command);
 
 
 } //namespace cmd
@@ -1,7 +1,11 @@
 #include "Connection.hpp"
 #include "CommandsParser.hpp"
 #include "Server.hpp"
+#include "ImageTransform.hpp"
+#include "Jpeg.hpp"
 #include <sstream>
+#include <algorithm>
+#include <cstring>
 #include <core_api/Arm.h>
 #include <core_api/Disarm.h>
 #include <core_api/TakeOff.h>
@@ -9,111 +13,355 @@
 #include <core_api/VelocitySet.h>
 #include <core_api/PositionSet.h>
 #include <core_api/AttitudeSet.h>
-#include "Base32.hpp"
+#include "Allocations.hpp"
+
+#if defined(__linux__)
+#include <linux/sockios.h>
+#endif
 
 namespace srv {
 
-Connection::Connection(asio::ip::tcp::socket s)
+namespace {
+
+	//non owning view over the queued buffers, copying it into the write operation does not allocate
+	char const PUSH_IMAGE_HEADER[] = "push:image\r\n";
+	char const PUSH_IMAGE_TRAILER[] = "\r\n";
+
+	struct BufferSequence
+	{
+		typedef asio::const_buffer value_type;
+		typedef asio::const_buffer const *const_iterator;
+
+		const_iterator begin() const { return first; }
+		const_iterator end() const { return last; }
+
+		const_iterator first;
+		const_iterator last;
+	};
+
+#if defined(SIOCOUTQ)
+	//bytes written to the socket and not yet sent
+	struct unsent_bytes
+	{
+		int name() const { return SIOCOUTQ; }
+		void* data() { return &value; }
+
+		int value;
+	};
+#endif
+
+} //namespace anonymous
+
+std::size_t const Connection::DEFAULT_PUSH_QUEUE;
+std::size_t const Connection::MAX_PUSH_QUEUE;
+std::uint32_t const Connection::MAX_FRAME_WAIT_MS;
+std::uint32_t const Connection::FIRST_FRAME_WAIT_MS;
+std::uint32_t const Connection::MAX_TARGET_LATENCY_MS;
+std::uint32_t const Connection::MAX_TELEMETRY_RATE;
+std::uint32_t const Connection::MAX_TELEMETRY_INTERVAL_MS;
+
+Connection::Connection(asio::io_service &ios, asio::ip::tcp::socket s)
 	: m_Socket(std::move(s))
-	, m_GetBuffer()
-	, m_PutBuffer()
-	, m_Stream(this)
-    , m_ProcessCommandsStrand(Server::instance().ios())
-    , m_ProcessCommandsYieldContext(nullptr)
+	, m_Input()
+	, m_InputBegin(0)
+	, m_Line()
+	, m_Arena()
+	, m_RequestAllocations(0)
+	, m_BudgetHeld(0)
+	, m_ResponseImage()
+	, m_ResponseImages()
+	, m_ResponseDeferred(false)
+	, m_WriteQueue()
+	, m_WriteBuffers()
+	, m_WritesInProgress(0)
+	, m_WriteBytes(0)
+	, m_WriteStarted()
+	, m_ResponseOutputs(0)
+	, m_WritesDoneSignal(nullptr)
+	, m_ReadOnWritesDone(false)
+	, m_FrameWait()
+	, m_Delta()
+	, m_ImagesWait()
+	, m_ImageSubscription()
+	, m_TelemetrySubscription()
+	, m_ProcessCommandsStrand(ios)
 {
-	initBuffers();
+	m_FrameWait.active = false;
+	m_FrameWait.since = 0;
+	m_ImagesWait.active = false;
+	m_Delta.seq = 0;
+	m_Delta.deltas = 0;
+	m_ImageSubscription.active = false;
+	m_ImageSubscription.queue = DEFAULT_PUSH_QUEUE;
+	m_ImageSubscription.keepLatest = false;
+	m_ImageSubscription.pushesQueued = 0;
+	m_ImageSubscription.pushed = 0;
+	m_ImageSubscription.dropped = 0;
+	m_ImageSubscription.adaptive = false;
+	m_ImageSubscription.levelMaxFps = 0.0f;
+	m_TelemetrySubscription.active = false;
+	m_TelemetrySubscription.pushesQueued = 0;
+	m_TelemetrySubscription.pushed = 0;
+	m_TelemetrySubscription.dropped = 0;
 }
 
 Connection::~Connection()
 {
+	Server::instance().memoryBudget().release(m_BudgetHeld);
 }
 
 void Connection::startProcessingCommands()
 {
+	system::error_code err;
+	m_Socket.non_blocking(true, err);
+
+	ConnectionProfile const &profile = Server::instance().getConnectionProfile();
+	if(profile.engine == ConnectionProfile::STACKLESS)
+	{
+		m_ProcessCommandsStrand.dispatch(
+			std::bind(
+				&Connection::doReadCommands,
+				shared_from_this()
+			)
+		);
+		return;
+	}
+
+	boost::coroutines::attributes attributes;
+	if(profile.stackSize)
+		attributes.size = profile.stackSize;
+
 	asio::spawn(
 	  m_ProcessCommandsStrand,
 	  std::bind(
 		&Connection::processCommands,
 		shared_from_this(),
 		std::placeholders::_1
-	  )
+	  ),
+	  attributes
 	);
 }
 
 void Connection::processCommands(asio::yield_context yctx)
 {
-	m_ProcessCommandsYieldContext = &yctx;
-
 	CONN_LOG(debug) << "processing commands ...";
 
 	while(true)
 	{
-		std::string line;
-		if(system::error_code rle = readLine(line))
+		if(system::error_code rle = readLine(m_Line, yctx))
 		{
 			CONN_LOG(error) << "failed to read a line: " << rle;
 			break;
 		}
 
-		system::error_code result;
-		std::ostringstream data;
+		processCommand(m_Line);
+		m_Line.clear();
+		waitWrites(yctx);
+	}
+
+	onClosed();
+	CONN_LOG(debug) << "processing commands done!";
+}
+
+system::error_code Connection::readLine(std::string &line, asio::yield_context yctx)
+{
+	while(!extractLine(line))
+	{
+		if(line.size() > LINE_SIZE_MAX)
+			return make_error_code(system::errc::message_size);
+
+		system::error_code err;
+		m_Socket.async_read_some(asio::null_buffers(), yctx[err]);
+		if(err)
+			return err;
 
-		cmd::Command command;
-		if(system::error_code pe = cmd::parse(line, command))
+		err = readInput();
+		if(err && err != asio::error::would_block)
+			return err;
+	}
+	return system::error_code();
+}
+
+void Connection::waitWrites(asio::yield_context yctx)
+{
+	if(!isResponsePending())
+		return;
+
+	asio::steady_timer writesDone(m_ProcessCommandsStrand.get_io_service(), asio::steady_timer::time_point::max());
+	m_WritesDoneSignal = &writesDone;
+
+	system::error_code err;
+	writesDone.async_wait(yctx[err]);
+	m_WritesDoneSignal = nullptr;
+}
+
+void Connection::doReadCommands()
+{
+	while(extractLine(m_Line))
+	{
+		processCommand(m_Line);
+		m_Line.clear();
+
+		if(isResponsePending())
 		{
-			result = pe;
-			CONN_LOG(error) << "failed to parse a command: " << pe;
+			//continue with the next command once the response is out
+			m_ReadOnWritesDone = true;
+			return;
 		}
-		else
+	}
+
+	if(m_Line.size() > LINE_SIZE_MAX)
+	{
+		CONN_LOG(error) << "failed to read a line: " << make_error_code(system::errc::message_size);
+		onClosed();
+		return;
+	}
+
+	//an idle connection holds no buffers while waiting for input
+	m_Socket.async_read_some(
+		asio::null_buffers(),
+		m_ProcessCommandsStrand.wrap(
+			std::bind(
+				&Connection::onReadable,
+				shared_from_this(),
+				std::placeholders::_1
+			)
+		)
+	);
+}
+
+void Connection::onReadable(system::error_code const &e)
+{
+	system::error_code err = e ? e : readInput();
+	if(err && err != asio::error::would_block)
+	{
+		CONN_LOG(error) << "failed to read a line: " << err;
+		onClosed();
+		CONN_LOG(debug) << "processing commands done!";
+		return;
+	}
+	doReadCommands();
+}
+
+void Connection::processCommand(std::string const &line)
+{
+	allocations::Counters allocationsBefore = allocations::thread();
+
+	system::error_code result;
+	ArenaStreamBuf dataBuffer(m_Arena);
+	std::ostream data(&dataBuffer);
+
+	cmd::Command command;
+	if(system::error_code pe = cmd::parse(line.data(), line.data() + line.size(), command))
+	{
+		result = pe;
+		CONN_LOG(error) << "failed to parse a command: " << pe;
+	}
+	else
+	{
+		switch(command.which())
 		{
-			switch(command.which())
-			{
-			case 0:
-				result = handleArm(boost::get<cmd::Arm>(command), data);
-				break;
-
-			case 1:
-				result = handleDisarm(boost::get<cmd::Disarm>(command), data);
-				break;
-
-			case 2:
-				result = handleTakeOff(boost::get<cmd::TakeOff>(command), data);
-				break;
-
-			case 3:
-				result = handleLand(boost::get<cmd::Land>(command), data);
-				break;
-
-			case 4:
-				result = handlePositionSetpoint(boost::get<cmd::PositionSetpoint>(command), data);
-				break;
-
-			case 5:
-				result = handleVelocitySetpoint(boost::get<cmd::VelocitySetpoint>(command), data);
-				break;
-
-			case 6:
-				result = handleAttitudeSetpoint(boost::get<cmd::AttitudeSetpoint>(command), data);
-				break;
-
-			case 7:
-				result = handleGetImage(boost::get<cmd::GetImage>(command), data);
-				break;
-
-			default:
-				CONN_LOG(error) << "unknown command received: " << command.which();
-			}
-		}
+		case 0:
+			result = handleArm(boost::get<cmd::Arm>(command), data);
+			break;
+
+		case 1:
+			result = handleDisarm(boost::get<cmd::Disarm>(command), data);
+			break;
+
+		case 2:
+			result = handleTakeOff(boost::get<cmd::TakeOff>(command), data);
+			break;
+
+		case 3:
+			result = handleLand(boost::get<cmd::Land>(command), data);
+			break;
+
+		case 4:
+			result = handlePositionSetpoint(boost::get<cmd::PositionSetpoint>(command), data);
+			break;
+
+		case 5:
+			result = handleVelocitySetpoint(boost::get<cmd::VelocitySetpoint>(command), data);
+			break;
+
+		case 6:
+			result = handleAttitudeSetpoint(boost::get<cmd::AttitudeSetpoint>(command), data);
+			break;
+
+		case 7:
+			result = handleGetImage(boost::get<cmd::GetImage>(command), data);
+			break;
+
+		case 8:
+			result = handleGetStats(boost::get<cmd::GetStats>(command), data);
+			break;
 
-		m_Stream << "result:" << result.value() << " message:\"" << result.message() << "\"\r\n";
-		m_Stream << data.str() << "\r\n";
-		m_Stream.flush();
+		case 9:
+			result = handleSubscribeImage(boost::get<cmd::SubscribeImage>(command), data);
+			break;
+
+		case 10:
+			result = handleUnsubscribeImage(boost::get<cmd::UnsubscribeImage>(command), data);
+			break;
+
+		case 11:
+			result = handleGetImages(boost::get<cmd::GetImages>(command), data);
+			break;
+
+		case 12:
+			result = handleSubscribeTelemetry(boost::get<cmd::SubscribeTelemetry>(command), data);
+			break;
+
+		case 13:
+			result = handleUnsubscribeTelemetry(boost::get<cmd::UnsubscribeTelemetry>(command), data);
+			break;
+
+		default:
+			CONN_LOG(error) << "unknown command received: " << command.which();
+		}
 	}
 
-	m_ProcessCommandsYieldContext = nullptr;
+	//a handler waiting for something completes the response later on
+	if(result != system::errc::operation_in_progress)
+		sendResponse(result, dataBuffer);
 
-	CONN_LOG(debug) << "processing commands done!";
+	m_RequestAllocations = allocations::thread().count - allocationsBefore.count;
+}
 
+void Connection::sendResponse(system::error_code const &result, ArenaStreamBuf &dataBuffer)
+{
+	std::ostream data(&dataBuffer);
+	ArenaStreamBuf headerBuffer(m_Arena);
+	std::ostream header(&headerBuffer);
+	header << "result:" << result.value() << " message:\"" << result.message() << "\"\r\n";
+	data << "\r\n";
+
+	//shared image data is charged with the frame, the rest of the response is held by this connection
+	std::size_t responseSize = headerBuffer.size() + dataBuffer.size();
+	if(responseSize > m_BudgetHeld)
+	{
+		Server::instance().memoryBudget().acquire(responseSize - m_BudgetHeld);
+		m_BudgetHeld = responseSize;
+	}
+
+	for(asio::const_buffer const &segment : headerBuffer.segments())
+		send(segment);
+	if(m_ResponseImage)
+	{
+		sendImage(m_ResponseImage);
+		m_ResponseImage.reset();
+	}
+	for(asio::const_buffer const &segment : dataBuffer.segments())
+		send(segment);
+
+	static char const LINE_END[] = "\r\n";
+	for(EncodedImagePtr const &img : m_ResponseImages)
+	{
+		sendImage(img);
+		send(asio::buffer(LINE_END, 2));
+	}
+	m_ResponseImages.clear();
 }
 
 system::error_code Connection::handleArm(cmd::Arm const &arm, std::ostream &dos)
@@ -267,111 +515,1051 @@ system::error_code Connection::handleAttitudeSetpoint(cmd::AttitudeSetpoint cons
 system::error_code Connection::handleGetImage(cmd::GetImage const &getImage, std::ostream &dos)
 {
 	CONN_LOG(debug) << "received: get_image()";
-	sensor_msgs::ImageConstPtr img = Server::instance().getROSImage();
-	if(!img)
+	if(getImage.delta && isCompressed(getImage.image))
+	{
+		CONN_LOG(warning) << "get_image() failed, delta: needs raw pixels!";
+		return make_error_code(system::errc::invalid_argument);
+	}
+
+	if(getImage.delta && getImage.image.encoding && !TileHashes::supports(getImage.image.encoding.get()))
+	{
+		CONN_LOG(warning) << "get_image() failed, delta: is not supported for " << getImage.image.encoding.get();
+		return make_error_code(system::errc::not_supported);
+	}
+
+	//a rejected request does not subscribe the camera
+	if(system::error_code ve = validateImageParams(getImage.image))
+		return ve;
+
+	Server::instance().demandCamera();
+	if(getImage.seq || getImage.stamp)
+		return writeHistoryImage(getImage, dos);
+
+	FramePtr frame = Server::instance().getFrame();
+
+	//the camera was idle and is subscribed again, the first frame is on its way
+	if(!frame && !getImage.since)
+		return waitFrame(0, FIRST_FRAME_WAIT_MS, getImage.image, getImage.delta);
+
+	if(getImage.since && (!frame || frame->seq <= getImage.since.get()))
+	{
+		if(getImage.timeout && getImage.timeout.get())
+			return waitFrame(getImage.since.get(), std::min(getImage.timeout.get(), MAX_FRAME_WAIT_MS), getImage.image, getImage.delta);
+
+		if(frame)
+		{
+			dos << "seq:" << frame->seq << " not_modified";
+			return system::error_code();
+		}
+	}
+
+	return writeImage(frame, getImage.image, getImage.delta, dos);
+}
+
+system::error_code Connection::writeImage(FramePtr const &frame, cmd::ImageParams const &params, optional<std::uint64_t> const &delta, std::ostream &dos)
+{
+	if(!frame)
 	{
 		CONN_LOG(error) << "get_image() failed!";
 		return make_error_code(system::errc::no_stream_resources);
 	}
 
+	ImageGeometry geometry;
+	if(system::error_code re = resolveImageParams(*frame, params, geometry))
+	{
+		CONN_LOG(warning) << "get_image() failed, invalid image params: " << re.message();
+		return re;
+	}
+
+	if(delta)
+		return writeDeltaImage(frame, params, delta.get());
+
+	//compression would stall every connection of the shard, a worker does it
+	if(isCompressed(params) && Server::instance().workerPool().size())
+	{
+		Server::instance().workerPool().post(
+			std::bind(
+				&Connection::compressImage,
+				shared_from_this(),
+				frame,
+				params
+			)
+		);
+		m_ResponseDeferred = true;
+		return make_error_code(system::errc::operation_in_progress);
+	}
+
+	//the encoding is shared with other requests and pushes of the same frame and params, one in progress completes the response
+	bool pending = false;
+	m_ResponseImage = Server::instance().getEncodedImage(
+		frame,
+		params,
+		std::bind(&Connection::postCompleteImage, shared_from_this(), std::placeholders::_1),
+		pending
+	);
+	if(pending)
+	{
+		m_ResponseDeferred = true;
+		return make_error_code(system::errc::operation_in_progress);
+	}
+
+	if(!m_ResponseImage)
+	{
+		CONN_LOG(warning) << "get_image() rejected, memory budget exhausted!";
+		return make_error_code(system::errc::not_enough_memory);
+	}
+
+	return system::error_code();
+}
+
+system::error_code Connection::writeDeltaImage(FramePtr const &frame, cmd::ImageParams const &params, std::uint64_t base)
+{
+	//without an encoding param the camera encoding is only known now, checked before transforming on the io thread
+	std::string const &encoding = params.encoding ? params.encoding.get() : frame->encoding;
+	if(!TileHashes::supports(encoding))
+	{
+		CONN_LOG(warning) << "get_image() failed, delta: is not supported for " << encoding;
+		m_Delta.seq = 0;
+		return make_error_code(system::errc::not_supported);
+	}
+
+	std::chrono::system_clock::time_point started = std::chrono::system_clock::now();
+	FramePtr transformed = transformFrame(frame, params);
+	if(!transformed || m_Delta.next.compute(*transformed))
+	{
+		CONN_LOG(warning) << "get_image() failed, delta: is not supported for " << frame->encoding;
+		m_Delta.seq = 0;
+		return make_error_code(system::errc::not_supported);
+	}
+
+	//the client holds the frame of the last response, anything else gets a full frame
+	bool keyframe = !base || base != m_Delta.seq || !(params == m_Delta.params) ||
+		!m_Delta.next.matches(m_Delta.tiles) || m_Delta.deltas >= DELTA_KEYFRAME_INTERVAL;
+	bool pending = false;
+	if(keyframe)
+	{
+		m_ResponseImage = Server::instance().getEncodedImage(
+			frame,
+			params,
+			std::bind(&Connection::postCompleteImage, shared_from_this(), std::placeholders::_1),
+			pending
+		);
+		m_Delta.deltas = 0;
+	}
+	else
+	{
+		thread_local std::vector<std::uint8_t> tiles;
+		std::size_t changed = m_Delta.next.writeChanged(*transformed, m_Delta.tiles, tiles);
+		m_ResponseImage = EncodedImage::createDelta(*transformed, base, changed, tiles, started);
+		++m_Delta.deltas;
+	}
+
+	if(!m_ResponseImage && !pending)
+	{
+		CONN_LOG(warning) << "get_image() rejected, memory budget exhausted!";
+		m_Delta.seq = 0;
+		return make_error_code(system::errc::not_enough_memory);
+	}
+
+	//completeImage forgets the base again if the pending keyframe fails
+	m_Delta.seq = frame->seq;
+	m_Delta.params = params;
+	std::swap(m_Delta.tiles, m_Delta.next);
+	if(pending)
+	{
+		m_ResponseDeferred = true;
+		return make_error_code(system::errc::operation_in_progress);
+	}
+	return system::error_code();
+}
+
+system::error_code Connection::writeHistoryImage(cmd::GetImage const &getImage, std::ostream &dos)
+{
+	FrameHistory const &history = Server::instance().frameHistory();
+	FramePtr frame = getImage.seq ? history.findSeq(getImage.seq.get()) : history.findStamp(getImage.stamp.get());
+
+	//without a history only the latest frame can be asked for
+	if(!frame && getImage.seq)
+	{
+		FramePtr latest = Server::instance().getFrame();
+		if(latest && latest->seq == getImage.seq.get())
+			frame = latest;
+	}
+
+	if(!frame)
+	{
+		CONN_LOG(warning) << "get_image() failed, the frame is not in the history!";
+		return make_error_code(system::errc::result_out_of_range);
+	}
+
+	return writeImage(frame, getImage.image, getImage.delta, dos);
+}
+
+system::error_code Connection::waitFrame(std::uint64_t since, std::uint32_t timeoutMs, cmd::ImageParams const &params, optional<std::uint64_t> const &delta)
+{
+	if(system::error_code ve = validateImageParams(params))
+		return ve;
+
+	if(!m_FrameWait.timer)
+		m_FrameWait.timer.reset(new asio::steady_timer(m_ProcessCommandsStrand.get_io_service()));
+
+	m_FrameWait.active = true;
+	m_FrameWait.since = since;
+	m_FrameWait.params = params;
+	m_FrameWait.delta = delta;
+
+	system::error_code err;
+	m_FrameWait.timer->expires_from_now(std::chrono::milliseconds(timeoutMs), err);
+	m_FrameWait.timer->async_wait(
+		m_ProcessCommandsStrand.wrap(
+			std::bind(
+				&Connection::onFrameWaitTimeout,
+				shared_from_this(),
+				std::placeholders::_1
+			)
+		)
+	);
+	Server::instance().waitFrame(shared_from_this());
+
+	//a frame stored before the registration would not notify
+	FramePtr frame = Server::instance().getFrame();
+	if(frame && frame->seq > since)
+		notifyFrame();
+
+	m_ResponseDeferred = true;
+	return make_error_code(system::errc::operation_in_progress);
+}
+
+void Connection::notifyFrame()
+{
+	m_ProcessCommandsStrand.post(
+		std::bind(
+			&Connection::onFrameNotified,
+			shared_from_this()
+		)
+	);
+}
+
+void Connection::onFrameNotified()
+{
+	if(!m_FrameWait.active)
+		return;
+
+	FramePtr frame = Server::instance().getFrame();
+	if(!frame || frame->seq <= m_FrameWait.since)
+	{
+		Server::instance().waitFrame(shared_from_this());
+		return;
+	}
+
+	completeFrameWait(frame);
+}
+
+void Connection::onFrameWaitTimeout(system::error_code const &e)
+{
+	if(e == asio::error::operation_aborted || !m_FrameWait.active)
+		return;
+
+	completeFrameWait(FramePtr());
+}
+
+void Connection::completeFrameWait(FramePtr const &frame)
+{
+	m_FrameWait.active = false;
+	system::error_code err;
+	m_FrameWait.timer->cancel(err);
+
+	ArenaStreamBuf dataBuffer(m_Arena);
+	std::ostream data(&dataBuffer);
+
+	system::error_code result;
+	if(frame)
+	{
+		result = writeImage(frame, m_FrameWait.params, m_FrameWait.delta, data);
+		if(result == system::errc::operation_in_progress)
+			return;
+	}
+	else
+	{
+		FramePtr latest = Server::instance().getFrame();
+		if(latest)
+			data << "seq:" << latest->seq << " not_modified";
+		else
+			result = make_error_code(system::errc::no_stream_resources);
+	}
+
+	m_ResponseDeferred = false;
+	sendResponse(result, dataBuffer);
+}
+
+void Connection::compressImage(FramePtr const &frame, cmd::ImageParams const &params)
+{
+	//the encoding is shared with other requests and pushes of the same frame and params
+	postCompleteImage(Server::instance().getEncodedImage(frame, params));
+}
+
+void Connection::postCompleteImage(EncodedImagePtr const &img)
+{
+	m_ProcessCommandsStrand.post(
+		std::bind(
+			&Connection::completeImage,
+			shared_from_this(),
+			img
+		)
+	);
+}
+
+void Connection::completeImage(EncodedImagePtr const &img)
+{
+	system::error_code result;
+	m_ResponseImage = img;
+	if(!m_ResponseImage)
+	{
+		CONN_LOG(warning) << "get_image() rejected, memory budget exhausted!";
+		m_Delta.seq = 0;
+		result = make_error_code(system::errc::not_enough_memory);
+	}
+
+	ArenaStreamBuf dataBuffer(m_Arena);
+	m_ResponseDeferred = false;
+	sendResponse(result, dataBuffer);
+}
+
+system::error_code Connection::handleGetStats(cmd::GetStats const &getStats, std::ostream &dos)
+{
+	CONN_LOG(debug) << "received: get_stats()";
+
+	if(allocations::enabled())
+	{
+		allocations::Counters process = allocations::process();
+		dos <<
+			"allocations:" << process.count <<
+			" allocated_bytes:" << process.bytes <<
+			" request_allocations:" << m_RequestAllocations << " ";
+	}
+
+	EncodedImageCache const &cache = Server::instance().encodedImageCache();
+	dos <<
+		"image_pushes:" << m_ImageSubscription.pushed <<
+		" image_pushes_dropped:" << m_ImageSubscription.dropped <<
+		" image_adaptive_level:" << (m_ImageSubscription.adaptive ? static_cast<int>(m_ImageSubscription.rate.level()) : -1) <<
+		" frames_broadcast:" << Server::instance().imageBroadcaster().framesBroadcast() <<
+		" cameras_subscribed:" << Server::instance().subscribedCameras() <<
+		" image_cache_hits:" << cache.hits() <<
+		" image_cache_misses:" << cache.misses() <<
+		" frames_skipped:" << cache.skipped() <<
+		" frames_compressed:" << cache.compressed() <<
+		" frames_passed_through:" << cache.passedThrough() <<
+		" frames_recorded:" << Server::instance().frameRecorder().frames() <<
+		" frames_played:" << Server::instance().framePlayer().framesPlayed() << " ";
+
+	TelemetryBroadcaster const &telemetry = Server::instance().telemetryBroadcaster();
+	dos <<
+		"telemetry_pushes:" << m_TelemetrySubscription.pushed <<
+		" telemetry_pushes_dropped:" << m_TelemetrySubscription.dropped <<
+		" telemetry_updates:" << telemetry.updates() <<
+		" telemetry_updates_broadcast:" << telemetry.updatesBroadcast() << " ";
+
+	FramePipeline const &pipeline = Server::instance().framePipeline();
+	for(int s = 0; s < FramePipeline::STAGES; ++s)
+	{
+		FramePipeline::Stage stage = static_cast<FramePipeline::Stage>(s);
+		StageStats const &stats = pipeline.stats(stage);
+		char const *name = FramePipeline::stageName(stage);
+		dos <<
+			name << "_count:" << stats.count() <<
+			" " << name << "_avg_us:" << stats.averageUs() <<
+			" " << name << "_max_us:" << stats.maxUs() << " ";
+	}
+
+	FrameHistory const &history = Server::instance().frameHistory();
 	dos <<
-		"width:" << img->width << " height:" << img->height << " size:" << img->data.size() << " data:";
-	base32::encode(img->data.data(), img->data.size(), dos);
+		"history_frames:" << history.size() <<
+		" history_capacity:" << history.capacity() <<
+		" history_bytes:" << history.bytes() << " ";
+
+	MemoryBudget const &budget = Server::instance().memoryBudget();
+	dos <<
+		"arena_capacity:" << m_Arena.capacity() <<
+		" arena_upstream_allocations:" << m_Arena.upstreamAllocations() <<
+		" budget_limit:" << budget.getLimit() <<
+		" budget_current:" << budget.current() <<
+		" budget_peak:" << budget.peak() <<
+		" budget_rejected:" << budget.rejected();
 
 	return system::error_code();
 }
 
-system::error_code Connection::readLine(std::string &line)
+system::error_code Connection::handleSubscribeImage(cmd::SubscribeImage const &subscribeImage, std::ostream &dos)
 {
-	static char const delim[2] = {'\r', '\n'};
+	CONN_LOG(debug) << "received: subscribe_image()";
+	if(subscribeImage.max_fps && subscribeImage.max_fps.get() <= 0.0f)
+		return make_error_code(system::errc::invalid_argument);
+
+	if(subscribeImage.queue && subscribeImage.queue.get() > MAX_PUSH_QUEUE)
+		return make_error_code(system::errc::invalid_argument);
+
+	if(subscribeImage.target_latency && (!subscribeImage.target_latency.get() || subscribeImage.target_latency.get() > MAX_TARGET_LATENCY_MS))
+		return make_error_code(system::errc::invalid_argument);
+
+	if(system::error_code ve = validateImageParams(subscribeImage.image))
+		return ve;
+
+	Server::instance().demandCamera();
+	m_ImageSubscription.active = true;
+	m_ImageSubscription.maxFps = subscribeImage.max_fps;
+	m_ImageSubscription.queue = subscribeImage.queue ? subscribeImage.queue.get() : DEFAULT_PUSH_QUEUE;
+	m_ImageSubscription.keepLatest = subscribeImage.keep_latest ? subscribeImage.keep_latest.get() : false;
+	m_ImageSubscription.lastPush = std::chrono::steady_clock::time_point();
+	m_ImageSubscription.adaptive = subscribeImage.adaptive ? subscribeImage.adaptive.get() : false;
+	m_ImageSubscription.params = subscribeImage.image;
+	m_ImageSubscription.rate.reset(subscribeImage.target_latency ? subscribeImage.target_latency.get() : RateController::DEFAULT_TARGET_MS);
+
+	//the best level is the subscribed params, the client learns about later levels only
+	applyAdaptiveLevel(false);
+	return system::error_code();
+}
 
-	std::size_t match = 0;
-	char c;
-	while(m_Stream.get(c).good())
+system::error_code Connection::handleUnsubscribeImage(cmd::UnsubscribeImage const &unsubscribeImage, std::ostream &dos)
+{
+	CONN_LOG(debug) << "received: unsubscribe_image()";
+	m_ImageSubscription.active = false;
+	m_ImageSubscription.waiting.clear();
+	Server::instance().imageBroadcaster().unsubscribe(this);
+	return system::error_code();
+}
+
+system::error_code Connection::handleGetImages(cmd::GetImages const &getImages, std::ostream &dos)
+{
+	CONN_LOG(debug) << "received: get_images()";
+	std::size_t cameras = Server::instance().getCamerasCount();
+	for(std::uint32_t camera : getImages.cameras)
 	{
-	  match = (delim[match] == c) ? (match + 1) : 0;
+		if(camera >= cameras)
+		{
+			CONN_LOG(warning) << "get_images() failed, no camera " << camera;
+			return make_error_code(system::errc::invalid_argument);
+		}
+	}
+
+	if(system::error_code ve = validateImageParams(getImages.image))
+		return ve;
 
-	  if(match == 2)
-	  {
-		line.pop_back();
-		return system::error_code();
-	  }
+	for(std::uint32_t camera : getImages.cameras)
+		Server::instance().demandCamera(camera);
 
-	  line.push_back(c);
+	m_ImagesWait.request = getImages;
+	m_ImagesWait.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(FIRST_FRAME_WAIT_MS);
+	return collectImages(dos);
+}
+
+system::error_code Connection::collectImages(std::ostream &dos)
+{
+	std::vector<std::uint32_t> const &cameras = m_ImagesWait.request.cameras;
+	std::vector<FramePtr> frames(cameras.size());
+	for(std::size_t c = 0; c < cameras.size(); ++c)
+	{
+		frames[c] = Server::instance().camera(cameras[c]).getFrame();
+		if(frames[c])
+			continue;
+
+		if(std::chrono::steady_clock::now() >= m_ImagesWait.deadline)
+		{
+			stopImagesWait();
+			CONN_LOG(error) << "get_images() failed, no frame from camera " << cameras[c];
+			return make_error_code(system::errc::no_stream_resources);
+		}
+
+		if(!m_ImagesWait.active)
+		{
+			if(!m_ImagesWait.timer)
+				m_ImagesWait.timer.reset(new asio::steady_timer(m_ProcessCommandsStrand.get_io_service()));
+
+			m_ImagesWait.active = true;
+			system::error_code err;
+			m_ImagesWait.timer->expires_at(m_ImagesWait.deadline, err);
+			m_ImagesWait.timer->async_wait(
+				m_ProcessCommandsStrand.wrap(
+					std::bind(
+						&Connection::onImagesWaitTimeout,
+						shared_from_this(),
+						std::placeholders::_1
+					)
+				)
+			);
+		}
+		Server::instance().waitImages(shared_from_this());
+
+		//a frame stored before the registration would not notify
+		if(Server::instance().camera(cameras[c]).getFrame())
+			notifyImages();
+
+		m_ResponseDeferred = true;
+		return make_error_code(system::errc::operation_in_progress);
 	}
-	return make_error_code(system::errc::illegal_byte_sequence);
+	stopImagesWait();
+
+	//the camera lagging most sets the stamp, the others answer with their frame closest to it
+	double reference = frames.front()->stamp.toSec();
+	for(FramePtr const &frame : frames)
+		reference = std::min(reference, frame->stamp.toSec());
+
+	for(std::size_t c = 0; c < cameras.size(); ++c)
+	{
+		if(FramePtr closest = Server::instance().camera(cameras[c]).frameHistory().findStamp(reference))
+			frames[c] = closest;
+
+		ImageGeometry geometry;
+		if(system::error_code re = resolveImageParams(*frames[c], m_ImagesWait.request.image, geometry))
+		{
+			CONN_LOG(warning) << "get_images() failed, invalid image params for camera " << cameras[c] << ": " << re.message();
+			return re;
+		}
+	}
+
+	//the cameras are encoded side by side on the workers
+	if(Server::instance().workerPool().size())
+	{
+		Server::instance().workerPool().post(
+			std::bind(
+				&Connection::encodeImages,
+				shared_from_this(),
+				frames,
+				m_ImagesWait.request
+			)
+		);
+		m_ResponseDeferred = true;
+		return make_error_code(system::errc::operation_in_progress);
+	}
+
+	std::vector<EncodedImagePtr> images(frames.size());
+	for(std::size_t c = 0; c < cameras.size(); ++c)
+		images[c] = Server::instance().camera(cameras[c]).encodedImageCache().get(frames[c], m_ImagesWait.request.image);
+
+	return writeImages(frames, images, dos);
+}
+
+void Connection::stopImagesWait()
+{
+	if(!m_ImagesWait.active)
+		return;
+
+	m_ImagesWait.active = false;
+	system::error_code err;
+	m_ImagesWait.timer->cancel(err);
+}
+
+void Connection::notifyImages()
+{
+	m_ProcessCommandsStrand.post(
+		std::bind(
+			&Connection::onImagesNotified,
+			shared_from_this()
+		)
+	);
+}
+
+void Connection::onImagesNotified()
+{
+	if(m_ImagesWait.active)
+		retryImages();
+}
+
+void Connection::onImagesWaitTimeout(system::error_code const &e)
+{
+	//past the deadline collectImages fails the request
+	if(e != asio::error::operation_aborted && m_ImagesWait.active)
+		retryImages();
+}
+
+void Connection::retryImages()
+{
+	ArenaStreamBuf dataBuffer(m_Arena);
+	std::ostream data(&dataBuffer);
+	system::error_code result = collectImages(data);
+	if(result == system::errc::operation_in_progress)
+		return;
+
+	m_ResponseDeferred = false;
+	sendResponse(result, dataBuffer);
+}
+
+void Connection::encodeImages(std::vector<FramePtr> const &frames, cmd::GetImages const &request)
+{
+	std::vector<EncodedImagePtr> images(frames.size());
+	Server::instance().workerPool().parallelFor(frames.size(), [&](std::size_t c) {
+		images[c] = Server::instance().camera(request.cameras[c]).encodedImageCache().get(frames[c], request.image);
+	});
+
+	m_ProcessCommandsStrand.post(
+		std::bind(
+			&Connection::completeImages,
+			shared_from_this(),
+			frames,
+			images
+		)
+	);
 }
 
-void Connection::initBuffers()
+void Connection::completeImages(std::vector<FramePtr> const &frames, std::vector<EncodedImagePtr> const &images)
 {
-	setg(&m_GetBuffer[0], &m_GetBuffer[0] + PUTBACK_MAX, &m_GetBuffer[0] + PUTBACK_MAX);
-	setp(&m_PutBuffer[0], &m_PutBuffer[0] + m_PutBuffer.size());
+	ArenaStreamBuf dataBuffer(m_Arena);
+	std::ostream data(&dataBuffer);
+	system::error_code result = writeImages(frames, images, data);
+	m_ResponseDeferred = false;
+	sendResponse(result, dataBuffer);
 }
 
-Connection::int_type Connection::underflow()
+system::error_code Connection::writeImages(std::vector<FramePtr> const &frames, std::vector<EncodedImagePtr> const &images, std::ostream &dos)
 {
-	BOOST_ASSERT(m_ProcessCommandsYieldContext);
+	for(EncodedImagePtr const &img : images)
+	{
+		if(!img)
+		{
+			CONN_LOG(warning) << "get_images() rejected, memory budget exhausted!";
+			return make_error_code(system::errc::not_enough_memory);
+		}
+	}
 
-	if(gptr() == egptr())
+	double first = frames.front()->stamp.toSec(), last = first;
+	for(FramePtr const &frame : frames)
+	{
+		first = std::min(first, frame->stamp.toSec());
+		last = std::max(last, frame->stamp.toSec());
+	}
+
+	//the images follow on their own lines in the order of the cameras asked for
+	dos << "images:" << images.size() << " skew:" << last - first;
+	m_ResponseImages = images;
+	return system::error_code();
+}
+
+system::error_code Connection::handleSubscribeTelemetry(cmd::SubscribeTelemetry const &subscribeTelemetry, std::ostream &dos)
+{
+	CONN_LOG(debug) << "received: subscribe_telemetry()";
+	//a tiny rate would overflow the interval of the broadcaster
+	if(subscribeTelemetry.rate && (!(subscribeTelemetry.rate.get() > 0.0f) || subscribeTelemetry.rate.get() > MAX_TELEMETRY_RATE ||
+		1000.0f / subscribeTelemetry.rate.get() > MAX_TELEMETRY_INTERVAL_MS))
+		return make_error_code(system::errc::invalid_argument);
+
+	std::uint32_t topics = 0;
+	for(std::string const &name : subscribeTelemetry.topics)
 	{
-	  system::error_code err;
-	  std::size_t bytes = m_Socket.async_read_some(
-		asio::buffer(asio::buffer(m_GetBuffer) + PUTBACK_MAX),
-		(*m_ProcessCommandsYieldContext)[err]
-	  );
+		TelemetryBroadcaster::Topic topic;
+		if(!TelemetryBroadcaster::parseTopic(name, topic))
+			return make_error_code(system::errc::invalid_argument);
+		topics |= 1u << topic;
+	}
+
+	//records of topics no longer subscribed are not written
+	for(int t = 0; t < TelemetryBroadcaster::TOPICS; ++t)
+	{
+		if(!(topics & (1u << t)))
+			m_TelemetrySubscription.waiting[t].reset();
+	}
+
+	m_TelemetrySubscription.active = true;
+	Server::instance().telemetryBroadcaster().subscribe(shared_from_this(), topics, subscribeTelemetry.rate);
+	return system::error_code();
+}
+
+system::error_code Connection::handleUnsubscribeTelemetry(cmd::UnsubscribeTelemetry const &unsubscribeTelemetry, std::ostream &dos)
+{
+	CONN_LOG(debug) << "received: unsubscribe_telemetry()";
+	m_TelemetrySubscription.active = false;
+	for(TelemetryRecordPtr &record : m_TelemetrySubscription.waiting)
+		record.reset();
+	Server::instance().telemetryBroadcaster().unsubscribe(this);
+	return system::error_code();
+}
+
+void Connection::pushImage(EncodedImagePtr const &img)
+{
+	m_ProcessCommandsStrand.post(
+		std::bind(
+			&Connection::onPushImage,
+			shared_from_this(),
+			img
+		)
+	);
+}
+
+void Connection::onPushImage(EncodedImagePtr const &img)
+{
+	if(!m_ImageSubscription.active || !m_Socket.is_open())
+		return;
+
+	float maxFps = m_ImageSubscription.maxFps ? m_ImageSubscription.maxFps.get() : 0.0f;
+	if(m_ImageSubscription.levelMaxFps > 0.0f && (maxFps <= 0.0f || m_ImageSubscription.levelMaxFps < maxFps))
+		maxFps = m_ImageSubscription.levelMaxFps;
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if(maxFps > 0.0f && now - m_ImageSubscription.lastPush < std::chrono::duration<float>(1.0f / maxFps))
+		return;
 
-	  if(err)
-	  {
-		if(!bytes)
-		  return traits_type::eof();
-	  }
+	m_ImageSubscription.lastPush = now;
 
-	  setg(&m_GetBuffer[0], &m_GetBuffer[0] + PUTBACK_MAX, &m_GetBuffer[0] + PUTBACK_MAX + bytes);
-	  return traits_type::to_int_type(*gptr());
+	std::deque<EncodedImagePtr> &waiting = m_ImageSubscription.waiting;
+	if(m_ImageSubscription.keepLatest)
+	{
+		m_ImageSubscription.dropped += waiting.size();
+		waiting.clear();
+		waiting.push_back(img);
+	}
+	else if(m_ImageSubscription.queue)
+	{
+		if(waiting.size() >= m_ImageSubscription.queue)
+		{
+			waiting.pop_front();
+			++m_ImageSubscription.dropped;
+		}
+		waiting.push_back(img);
+	}
+	else if(m_ImageSubscription.pushesQueued)
+	{
+		++m_ImageSubscription.dropped;
+		return;
 	}
 	else
 	{
-	  return traits_type::eof();
+		waiting.push_back(img);
 	}
+
+	pushNextImage();
 }
 
-Connection::int_type Connection::overflow(int_type c)
+void Connection::pushNextImage()
 {
-	BOOST_ASSERT(m_ProcessCommandsYieldContext);
+	if(m_ImageSubscription.pushesQueued || m_ImageSubscription.waiting.empty())
+		return;
+
+	EncodedImagePtr img = std::move(m_ImageSubscription.waiting.front());
+	m_ImageSubscription.waiting.pop_front();
+
+	++m_ImageSubscription.pushesQueued;
+	++m_ImageSubscription.pushed;
+	char *field = m_ImageSubscription.sentField;
+	std::memcpy(field, "sent:", 5);
+	field[SENT_FIELD_SIZE - 1] = ' ';
+	push(asio::buffer(PUSH_IMAGE_HEADER, sizeof(PUSH_IMAGE_HEADER) - 1), std::shared_ptr<void const>());
+	push(asio::buffer(field, SENT_FIELD_SIZE), std::shared_ptr<void const>(), field + 5);
+	push(img->buffer(), img);
+	push(asio::buffer(PUSH_IMAGE_TRAILER, sizeof(PUSH_IMAGE_TRAILER) - 1), std::shared_ptr<void const>());
+}
+
+void Connection::applyAdaptiveLevel(bool report)
+{
+	cmd::ImageParams const &base = m_ImageSubscription.params;
+	if(!m_ImageSubscription.adaptive)
+	{
+		m_ImageSubscription.levelMaxFps = 0.0f;
+		Server::instance().imageBroadcaster().subscribe(shared_from_this(), base);
+		return;
+	}
 
-	asio::const_buffer buffer = asio::buffer(pbase(), pptr() - pbase());
+	RateController::Level const &level = RateController::LADDER[m_ImageSubscription.rate.level()];
+	FramePtr frame = Server::instance().getFrame();
+	ImageGeometry geometry;
 
-	while(asio::buffer_size(buffer) > 0)
+	//the scaled size follows the subscribed one, a frame tells what that is
+	cmd::ImageParams scaled = base;
+	if(level.scale < 1.0f && frame && !resolveImageParams(*frame, base, geometry))
 	{
+		scaled.width = std::max<std::uint32_t>(static_cast<std::uint32_t>(geometry.width * level.scale), 1);
+		scaled.height = std::max<std::uint32_t>(static_cast<std::uint32_t>(geometry.height * level.scale), 1);
+	}
+
+	cmd::ImageParams compressed = scaled;
+	if(level.quality && !base.format)
+	{
+		compressed.format = std::string(jpeg::FORMAT);
+		compressed.quality = level.quality;
+	}
+
+	//not every camera encoding can be compressed or scaled, the level then only limits the rate
+	cmd::ImageParams params = base;
+	if(frame && !resolveImageParams(*frame, compressed, geometry))
+		params = compressed;
+	else if(frame && !resolveImageParams(*frame, scaled, geometry))
+		params = scaled;
+
+	m_ImageSubscription.levelMaxFps = level.maxFps;
+	Server::instance().imageBroadcaster().subscribe(shared_from_this(), params);
+
+	if(!report)
+		return;
+
+	std::ostringstream oss;
+	oss << "adaptive level:" << m_ImageSubscription.rate.level();
+	if(params.width)
+		oss << " width:" << params.width.get();
+	if(params.height)
+		oss << " height:" << params.height.get();
+	oss << " format:" << (params.format ? params.format.get() : std::string("raw"));
+	if(params.quality)
+		oss << " quality:" << params.quality.get();
+	if(level.maxFps > 0.0f)
+		oss << " max_fps:" << level.maxFps;
+	oss <<
+		" goodput:" << static_cast<std::uint64_t>(m_ImageSubscription.rate.goodput()) <<
+		" delay:" << m_ImageSubscription.rate.delay();
+
+	CONN_LOG(info) << oss.str();
+
+	//written in order with the frames, counted as a push until it is
+	std::shared_ptr<std::string> line = std::make_shared<std::string>(oss.str());
+	++m_ImageSubscription.pushesQueued;
+	push(asio::buffer(PUSH_IMAGE_HEADER, sizeof(PUSH_IMAGE_HEADER) - 1), std::shared_ptr<void const>());
+	push(asio::buffer(*line), line);
+	push(asio::buffer(PUSH_IMAGE_TRAILER, sizeof(PUSH_IMAGE_TRAILER) - 1), std::shared_ptr<void const>());
+}
 
-	  system::error_code err;
-	  std::size_t bytes = asio::async_write(
+void Connection::pushTelemetry(TelemetryBroadcaster::Topic topic, TelemetryRecordPtr const &record)
+{
+	m_ProcessCommandsStrand.post(
+		std::bind(
+			&Connection::onPushTelemetry,
+			shared_from_this(),
+			topic,
+			record
+		)
+	);
+}
+
+void Connection::onPushTelemetry(TelemetryBroadcaster::Topic topic, TelemetryRecordPtr const &record)
+{
+	if(!m_TelemetrySubscription.active || !m_Socket.is_open())
+		return;
+
+	//only the latest state of a topic matters
+	TelemetryRecordPtr &waiting = m_TelemetrySubscription.waiting[topic];
+	if(waiting)
+		++m_TelemetrySubscription.dropped;
+	waiting = record;
+
+	pushNextTelemetry();
+}
+
+void Connection::pushNextTelemetry()
+{
+	if(m_TelemetrySubscription.pushesQueued)
+		return;
+
+	//the waiting records go out in one gather write, each holds its own framing
+	for(TelemetryRecordPtr &record : m_TelemetrySubscription.waiting)
+	{
+		if(!record)
+			continue;
+
+		Output output = { asio::buffer(*record), record, TELEMETRY_PUSH, nullptr };
+		m_WriteQueue.push_back(std::move(output));
+		record.reset();
+		++m_TelemetrySubscription.pushesQueued;
+		++m_TelemetrySubscription.pushed;
+	}
+
+	if(m_TelemetrySubscription.pushesQueued)
+		doWrite();
+}
+
+void Connection::onClosed()
+{
+	m_ImageSubscription.active = false;
+	m_ImageSubscription.waiting.clear();
+	Server::instance().imageBroadcaster().unsubscribe(this);
+	m_TelemetrySubscription.active = false;
+	for(TelemetryRecordPtr &record : m_TelemetrySubscription.waiting)
+		record.reset();
+	Server::instance().telemetryBroadcaster().unsubscribe(this);
+}
+
+bool Connection::extractLine(std::string &line)
+{
+	while(m_InputBegin < m_Input.size())
+	{
+		line.push_back(m_Input[m_InputBegin++]);
+
+		std::size_t size = line.size();
+		if(size >= 2 && line[size - 2] == '\r' && line[size - 1] == '\n')
+		{
+			line.resize(size - 2);
+			return true;
+		}
+	}
+
+	m_Input.clear();
+	m_InputBegin = 0;
+	return false;
+}
+
+system::error_code Connection::readInput()
+{
+	char buffer[BUFFER_SIZE];
+	system::error_code err;
+	std::size_t bytes = m_Socket.read_some(asio::buffer(buffer), err);
+	m_Input.append(buffer, bytes);
+	return err;
+}
+
+void Connection::send(asio::const_buffer buffer, std::shared_ptr<void const> holder, char *sent)
+{
+	Output output = { buffer, std::move(holder), RESPONSE, sent };
+	m_WriteQueue.push_back(std::move(output));
+	++m_ResponseOutputs;
+	doWrite();
+}
+
+void Connection::push(asio::const_buffer buffer, std::shared_ptr<void const> holder, char *sent)
+{
+	Output output = { buffer, std::move(holder), IMAGE_PUSH, sent };
+	m_WriteQueue.push_back(std::move(output));
+	doWrite();
+}
+
+void Connection::sendImage(EncodedImagePtr const &img)
+{
+	//the field lives with the request, the shared body cannot carry per connection times
+	char *field = static_cast<char *>(m_Arena.allocate(SENT_FIELD_SIZE, 1));
+	std::memcpy(field, "sent:", 5);
+	field[SENT_FIELD_SIZE - 1] = ' ';
+	send(asio::buffer(field, SENT_FIELD_SIZE), std::shared_ptr<void const>(), field + 5);
+	send(img->buffer(), img);
+}
+
+void Connection::doWrite()
+{
+	if(m_WritesInProgress || m_WriteQueue.empty())
+		return;
+
+	m_WriteBuffers.clear();
+	m_WriteBytes = 0;
+	std::chrono::system_clock::time_point sent;
+	for(Output const &output : m_WriteQueue)
+	{
+		if(output.sent)
+		{
+			if(sent == std::chrono::system_clock::time_point())
+				sent = std::chrono::system_clock::now();
+			writeTime(output.sent, sent);
+		}
+		m_WriteBuffers.push_back(output.buffer);
+		m_WriteBytes += asio::buffer_size(output.buffer);
+	}
+
+	m_WritesInProgress = m_WriteQueue.size();
+	m_WriteStarted = std::chrono::steady_clock::now();
+
+	BufferSequence buffers = { m_WriteBuffers.data(), m_WriteBuffers.data() + m_WriteBuffers.size() };
+	asio::async_write(
 		m_Socket,
-		asio::buffer(buffer),
-		(*m_ProcessCommandsYieldContext)[err]
-	  );
+		buffers,
+		m_ProcessCommandsStrand.wrap(
+			std::bind(
+				&Connection::onWritten,
+				shared_from_this(),
+				std::placeholders::_1
+			)
+		)
+	);
+}
 
-	  if(err)
-	  {
-		if(!bytes)
-		  return traits_type::eof();
-	  }
+void Connection::onWritten(system::error_code const &e)
+{
+	//the next write may start below, its timing replaces this one
+	std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - m_WriteStarted;
+	std::size_t writtenBytes = m_WriteBytes;
+
+	std::size_t responseOutputs = 0;
+	std::size_t pushOutputs = 0;
+	std::size_t telemetryOutputs = 0;
+	//the framing of a pushed frame holds no data, only the frame itself is counted
+	for(std::size_t o = 0; o < m_WritesInProgress; ++o)
+	{
+		if(m_WriteQueue[o].kind == RESPONSE)
+			++responseOutputs;
+		else if(m_WriteQueue[o].kind == TELEMETRY_PUSH)
+			++telemetryOutputs;
+		else if(m_WriteQueue[o].holder)
+			++pushOutputs;
+	}
+
+	m_WriteQueue.erase(m_WriteQueue.begin(), m_WriteQueue.begin() + m_WritesInProgress);
+	m_WritesInProgress = 0;
 
-	  buffer = buffer + bytes;
+	if(e)
+	{
+		CONN_LOG(error) << "failed to write: " << e;
+		for(Output const &output : m_WriteQueue)
+		{
+			if(output.kind == RESPONSE)
+				++responseOutputs;
+			else if(output.kind == TELEMETRY_PUSH)
+				++telemetryOutputs;
+			else if(output.holder)
+				++pushOutputs;
+		}
+		m_WriteQueue.clear();
+		system::error_code err;
+		m_Socket.close(err);
+	}
+	else
+	{
+		doWrite();
+	}
+
+	m_ImageSubscription.pushesQueued -= pushOutputs;
+	if(pushOutputs && !e && m_ImageSubscription.active && m_ImageSubscription.adaptive)
+	{
+		std::size_t unsent = 0;
+#if defined(SIOCOUTQ)
+		unsent_bytes outq;
+		outq.value = 0;
+		system::error_code err;
+		m_Socket.io_control(outq, err);
+		if(!err && outq.value > 0)
+			unsent = static_cast<std::size_t>(outq.value);
+#endif
+		if(m_ImageSubscription.rate.onPushWritten(writtenBytes, elapsed, unsent, std::chrono::steady_clock::now()))
+			applyAdaptiveLevel(true);
 	}
-	setp(&m_PutBuffer[0], &m_PutBuffer[0] + m_PutBuffer.size());
 
-	if(traits_type::eq_int_type(c, traits_type::eof()))
-	  return traits_type::not_eof(c);
+	if(pushOutputs && m_Socket.is_open())
+		pushNextImage();
 
-	*pptr() = traits_type::to_char_type(c);
-	pbump(1);
-	return c;
+	m_TelemetrySubscription.pushesQueued -= telemetryOutputs;
+	if(telemetryOutputs && m_Socket.is_open())
+		pushNextTelemetry();
+
+	if(responseOutputs)
+	{
+		m_ResponseOutputs -= responseOutputs;
+		if(!m_ResponseOutputs)
+			onResponseWritten();
+	}
+}
+
+void Connection::onResponseWritten()
+{
+	m_Arena.release();
+	Server::instance().memoryBudget().release(m_BudgetHeld);
+	m_BudgetHeld = 0;
+
+	if(m_WritesDoneSignal)
+	{
+		system::error_code err;
+		m_WritesDoneSignal->cancel(err);
+	}
+
+	if(m_ReadOnWritesDone)
+	{
+		m_ReadOnWritesDone = false;
+		doReadCommands();
+	}
 }
 
-int Connection::sync()
+bool Connection::isResponsePending() const
 {
-	return overflow(traits_type::eof());
+	return m_ResponseOutputs != 0 || m_ResponseDeferred;
 }
 
 } //namespace srv
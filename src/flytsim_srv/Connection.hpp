@@ -3,6 +3,11 @@
 
 #include "Config.hpp"
 #include "Commands.hpp"
+#include "Arena.hpp"
+#include "ImageBroadcaster.hpp"
+#include "TelemetryBroadcaster.hpp"
+#include "TileDelta.hpp"
+#include "RateController.hpp"
 
 #define CONN_LOG(level) BOOST_LOG_TRIVIAL(level) << "[CONN] "
 
@@ -10,19 +15,46 @@ namespace srv {
 
 class Connection
 	: public std::enable_shared_from_this<Connection>
-	, protected std::streambuf
 {
 public:
-	friend class Server;
+	friend class Shard;
 
-	Connection(asio::ip::tcp::socket s);
+	Connection(asio::io_service &ios, asio::ip::tcp::socket s);
 	~Connection();
 
+	static std::size_t const DEFAULT_PUSH_QUEUE = 2;
+	static std::size_t const MAX_PUSH_QUEUE = 16;
+	static std::uint32_t const MAX_FRAME_WAIT_MS = 30000;
+	static std::uint32_t const FIRST_FRAME_WAIT_MS = 2000;
+	static std::uint32_t const MAX_TARGET_LATENCY_MS = 10000;
+	//subscribe_telemetry rate: bounds in updates per second and milliseconds between updates
+	static std::uint32_t const MAX_TELEMETRY_RATE = 1000;
+	static std::uint32_t const MAX_TELEMETRY_INTERVAL_MS = 3600000;
+
+	//called from ROS threads for every new frame while subscribed
+	void pushImage(EncodedImagePtr const &img);
+	//called from ROS threads once a frame arrives after waitFrame
+	void notifyFrame();
+	//and once any camera stores a frame after waitImages
+	void notifyImages();
+	//called from ROS threads for every telemetry update while subscribed
+	void pushTelemetry(TelemetryBroadcaster::Topic topic, TelemetryRecordPtr const &record);
+
 protected:
 	void startProcessingCommands();
 
 private:
+	//stackful engine, one asio::spawn coroutine per connection
 	void processCommands(asio::yield_context yctx);
+	system::error_code readLine(std::string &line, asio::yield_context yctx);
+	void waitWrites(asio::yield_context yctx);
+
+	//stackless engine, a chain of completion handlers
+	void doReadCommands();
+	void onReadable(system::error_code const &e);
+
+	void processCommand(std::string const &line);
+	void sendResponse(system::error_code const &result, ArenaStreamBuf &dataBuffer);
 	system::error_code handleArm(cmd::Arm const &arm, std::ostream &dos);
 	system::error_code handleDisarm(cmd::Disarm const &disarm, std::ostream &dos);
 	system::error_code handleTakeOff(cmd::TakeOff const &takeOff, std::ostream &dos);
@@ -31,29 +63,166 @@ private:
 	system::error_code handleVelocitySetpoint(cmd::VelocitySetpoint const &velocitySetpoint, std::ostream &dos);
 	system::error_code handleAttitudeSetpoint(cmd::AttitudeSetpoint const &attitudeSetpoint, std::ostream &dos);
 	system::error_code handleGetImage(cmd::GetImage const &getImage, std::ostream &dos);
-
-	system::error_code readLine(std::string &line);
-
-	//std::streambuf implementation
-	void initBuffers();
-	int_type underflow();
-	int_type overflow(int_type c);
-	int sync();
+	system::error_code handleGetStats(cmd::GetStats const &getStats, std::ostream &dos);
+	system::error_code handleSubscribeImage(cmd::SubscribeImage const &subscribeImage, std::ostream &dos);
+	system::error_code handleUnsubscribeImage(cmd::UnsubscribeImage const &unsubscribeImage, std::ostream &dos);
+	system::error_code handleGetImages(cmd::GetImages const &getImages, std::ostream &dos);
+	system::error_code handleSubscribeTelemetry(cmd::SubscribeTelemetry const &subscribeTelemetry, std::ostream &dos);
+	system::error_code handleUnsubscribeTelemetry(cmd::UnsubscribeTelemetry const &unsubscribeTelemetry, std::ostream &dos);
+
+	//get_image since: long-poll, the response is deferred until a newer frame or the timeout
+	system::error_code writeImage(FramePtr const &frame, cmd::ImageParams const &params, optional<std::uint64_t> const &delta, std::ostream &dos);
+	system::error_code writeDeltaImage(FramePtr const &frame, cmd::ImageParams const &params, std::uint64_t base);
+	system::error_code writeHistoryImage(cmd::GetImage const &getImage, std::ostream &dos);
+	system::error_code waitFrame(std::uint64_t since, std::uint32_t timeoutMs, cmd::ImageParams const &params, optional<std::uint64_t> const &delta);
+	void onFrameNotified();
+	void onFrameWaitTimeout(system::error_code const &e);
+	void completeFrameWait(FramePtr const &frame);
+	//jpeg and qoi are compressed on a worker, the response is completed back on the strand
+	void compressImage(FramePtr const &frame, cmd::ImageParams const &params);
+	void postCompleteImage(EncodedImagePtr const &img);
+	void completeImage(EncodedImagePtr const &img);
+
+	//get_images waits until every camera has a frame, then encodes them on the workers
+	system::error_code collectImages(std::ostream &dos);
+	void stopImagesWait();
+	void onImagesNotified();
+	void onImagesWaitTimeout(system::error_code const &e);
+	void retryImages();
+	void encodeImages(std::vector<FramePtr> const &frames, cmd::GetImages const &request);
+	void completeImages(std::vector<FramePtr> const &frames, std::vector<EncodedImagePtr> const &images);
+	system::error_code writeImages(std::vector<FramePtr> const &frames, std::vector<EncodedImagePtr> const &images, std::ostream &dos);
+
+	void onPushImage(EncodedImagePtr const &img);
+	void pushNextImage();
+	//subscribes with the params of the current adaptive level and tells the client about them
+	void applyAdaptiveLevel(bool report);
+	void onPushTelemetry(TelemetryBroadcaster::Topic topic, TelemetryRecordPtr const &record);
+	void pushNextTelemetry();
+	void onClosed();
+
+	//input is read into a buffer on the caller's stack, only unconsumed bytes are kept
+	bool extractLine(std::string &line);
+	system::error_code readInput();
+
+	//"sent:<time> " ahead of every image body
+	enum { SENT_FIELD_SIZE = 5 + TIME_FIELD_SIZE + 1 };
+
+	enum OutputKind
+	{
+		RESPONSE,			//arena data of the response in flight
+		IMAGE_PUSH,
+		TELEMETRY_PUSH
+	};
+
+	//responses and pushes are queued and written with a single gather write
+	struct Output
+	{
+		asio::const_buffer buffer;
+		std::shared_ptr<void const> holder;		//keeps shared data alive until written
+		OutputKind kind;
+		char *sent;								//time field in the buffer, filled in as its write starts
+	};
+
+	void send(asio::const_buffer buffer, std::shared_ptr<void const> holder = std::shared_ptr<void const>(), char *sent = nullptr);
+	void push(asio::const_buffer buffer, std::shared_ptr<void const> holder, char *sent = nullptr);
+	//the image body after a "sent:" field telling the client when the server started writing it
+	void sendImage(EncodedImagePtr const &img);
+	void doWrite();
+	void onWritten(system::error_code const &e);
+	void onResponseWritten();
+	bool isResponsePending() const;
+
+	struct FrameWait
+	{
+		bool active;
+		std::uint64_t since;
+		cmd::ImageParams params;
+		optional<std::uint64_t> delta;
+		std::unique_ptr<asio::steady_timer> timer;	//created by the first long-poll, then reused
+	};
+
+	//tiles of the frame the client got with the last get_image delta:
+	struct DeltaState
+	{
+		std::uint64_t seq;
+		cmd::ImageParams params;
+		std::uint32_t deltas;		//sent since the last full frame
+		TileHashes tiles;
+		TileHashes next;			//computed for the frame being sent, swapped with tiles once it is
+	};
+
+	//cameras subscribed on demand have no frame for a moment
+	struct ImagesWait
+	{
+		bool active;
+		cmd::GetImages request;
+		std::chrono::steady_clock::time_point deadline;
+		std::unique_ptr<asio::steady_timer> timer;
+	};
+
+	//at most one frame is handed to the writer, a slow client only lags behind its own queue
+	struct ImageSubscription
+	{
+		bool active;
+		optional<float> maxFps;
+		std::size_t queue;
+		bool keepLatest;
+		std::chrono::steady_clock::time_point lastPush;
+		std::size_t pushesQueued;
+		std::deque<EncodedImagePtr> waiting;
+		std::uint64_t pushed;
+		std::uint64_t dropped;
+		bool adaptive;
+		cmd::ImageParams params;		//as subscribed, adaptive levels derive theirs from it
+		float levelMaxFps;				//of the adaptive level, 0 for no limit
+		RateController rate;
+		char sentField[SENT_FIELD_SIZE];	//of the push in flight, one is written at a time
+	};
+
+	//records are written a batch at a time, a newer update of a topic replaces the one waiting behind the batch
+	struct TelemetrySubscription
+	{
+		bool active;
+		std::size_t pushesQueued;
+		TelemetryRecordPtr waiting[TelemetryBroadcaster::TOPICS];
+		std::uint64_t pushed;
+		std::uint64_t dropped;
+	};
 
 private:
 	asio::ip::tcp::socket m_Socket;
-	enum { PUTBACK_MAX = 8 };
 	enum { BUFFER_SIZE = 8192 };
-
-	asio::detail::array<char, BUFFER_SIZE> m_GetBuffer;
-	asio::detail::array<char, BUFFER_SIZE> m_PutBuffer;
-
-	std::iostream m_Stream;
+	enum { LINE_SIZE_MAX = 65536 };
+
+	std::string m_Input;
+	std::size_t m_InputBegin;
+	std::string m_Line;
+
+	//per request memory, released once the response is written
+	Arena m_Arena;
+	std::uint64_t m_RequestAllocations;
+	std::size_t m_BudgetHeld;		//charged to the server memory budget until the response is written
+	EncodedImagePtr m_ResponseImage;	//sent by reference between the result line and the data
+	std::vector<EncodedImagePtr> m_ResponseImages;	//get_images, each on its own line after the data
+	bool m_ResponseDeferred;
+
+	std::vector<Output> m_WriteQueue;
+	std::vector<asio::const_buffer> m_WriteBuffers;
+	std::size_t m_WritesInProgress;
+	std::size_t m_WriteBytes;
+	std::chrono::steady_clock::time_point m_WriteStarted;
+	std::size_t m_ResponseOutputs;
+	asio::steady_timer *m_WritesDoneSignal;
+	bool m_ReadOnWritesDone;
+
+	FrameWait m_FrameWait;
+	DeltaState m_Delta;
+	ImagesWait m_ImagesWait;
+	ImageSubscription m_ImageSubscription;
+	TelemetrySubscription m_TelemetrySubscription;
 
 	asio::strand m_ProcessCommandsStrand;
-	asio::yield_context *m_ProcessCommandsYieldContext;
-
-
 };
 
 } //namespace srv
@@ -0,0 +1,289 @@
+#include "EncodedImage.hpp"
+#include "Server.hpp"
+#include "Base32.hpp"
+#include "ImageTransform.hpp"
+#include "Jpeg.hpp"
+#include "Qoi.hpp"
+#include "ColorConvert.hpp"
+#include "TileDelta.hpp"
+#include <sstream>
+#include <algorithm>
+
+namespace srv {
+
+EncodedImage::EncodedImage(Frame const &frame, std::string const &attributes, std::uint8_t const *data, std::size_t size, std::size_t charged, std::chrono::system_clock::time_point encodeStart)
+	: m_Body()
+	, m_Charged(charged)
+{
+	FramePipeline &pipeline = Server::instance().framePipeline();
+	FramePipeline::Timer timer(pipeline, FramePipeline::SERIALIZE);
+
+	char received[TIME_FIELD_SIZE + 1] = {};
+	char started[TIME_FIELD_SIZE + 1] = {};
+	writeTime(received, frame.received);
+	writeTime(started, encodeStart);
+
+	std::ostringstream oss;
+	oss <<
+		"seq:" << frame.seq << " stamp:" << frame.stamp <<
+		" received:" << received << " encode_start:" << started << " encode_end:";
+	std::size_t encodeEnd = static_cast<std::size_t>(oss.tellp());
+	oss <<
+		started <<
+		" width:" << frame.width << " height:" << frame.height << " encoding:" << frame.encoding <<
+		attributes << " size:" << size << " data:";
+	m_Body = oss.str();
+
+	//5 bytes make 8 characters, stripes of whole groups are encoded straight into the body
+	std::size_t header = m_Body.size();
+	m_Body.resize(header + base32::encodedSize(size));
+	std::size_t groups = (size + 4) / 5;
+	pipeline.forEachStripe(static_cast<std::uint32_t>(groups), 5, 1, [&](std::uint32_t begin, std::uint32_t end) {
+		std::size_t offset = std::size_t(begin) * 5;
+		std::size_t bytes = std::min(std::size_t(end) * 5, size) - offset;
+		base32::encode(data + offset, bytes, &m_Body[header + offset / 5 * 8]);
+	});
+
+	writeTime(&m_Body[encodeEnd], std::chrono::system_clock::now());
+}
+
+EncodedImage::~EncodedImage()
+{
+	Server::instance().memoryBudget().release(m_Charged);
+}
+
+asio::const_buffer EncodedImage::buffer() const
+{
+	return asio::buffer(m_Body);
+}
+
+EncodedImagePtr EncodedImage::create(Frame const &frame, std::chrono::system_clock::time_point encodeStart)
+{
+	std::size_t size = bodySize(frame.size);
+	if(!Server::instance().memoryBudget().tryAcquire(size))
+		return EncodedImagePtr();
+	return std::make_shared<EncodedImage>(frame, std::string(), frame.data, frame.size, size, encodeStart);
+}
+
+EncodedImagePtr EncodedImage::create(Frame const &frame, char const *format, std::uint8_t const *compressed, std::size_t size, std::chrono::system_clock::time_point encodeStart)
+{
+	std::size_t charged = bodySize(size);
+	if(!Server::instance().memoryBudget().tryAcquire(charged))
+		return EncodedImagePtr();
+	return std::make_shared<EncodedImage>(frame, std::string(" format:") + format, compressed, size, charged, encodeStart);
+}
+
+EncodedImagePtr EncodedImage::createDelta(Frame const &frame, std::uint64_t base, std::size_t tiles, std::vector<std::uint8_t> const &delta, std::chrono::system_clock::time_point encodeStart)
+{
+	std::size_t size = bodySize(delta.size());
+	if(!Server::instance().memoryBudget().tryAcquire(size))
+		return EncodedImagePtr();
+
+	std::ostringstream attributes;
+	attributes << " delta:" << base << " tile:" << DELTA_TILE_SIZE << " tiles:" << tiles;
+	return std::make_shared<EncodedImage>(frame, attributes.str(), delta.data(), delta.size(), size, encodeStart);
+}
+
+std::size_t EncodedImage::bodySize(std::size_t size)
+{
+	return 240 + (size * 8 + 4) / 5;
+}
+
+std::size_t const EncodedImageCache::MAX_VARIANTS;
+
+EncodedImageCache::EncodedImageCache()
+	: m_Mutex()
+	, m_Seq(0)
+	, m_Variants()
+	, m_Hits(0)
+	, m_Misses(0)
+	, m_Skipped(0)
+	, m_Compressed(0)
+	, m_PassedThrough(0)
+{
+}
+
+EncodedImagePtr EncodedImageCache::get(FramePtr const &frame, cmd::ImageParams const &params)
+{
+	bool pending = false;
+	return get(frame, params, nullptr, pending);
+}
+
+EncodedImagePtr EncodedImageCache::get(FramePtr const &frame, cmd::ImageParams const &params, EncodedHandler const &handler, bool &pending)
+{
+	return get(frame, params, &handler, pending);
+}
+
+EncodedImagePtr EncodedImageCache::get(FramePtr const &frame, cmd::ImageParams const &params, EncodedHandler const *handler, bool &pending)
+{
+	pending = false;
+	std::unique_ptr< std::promise<EncodedImagePtr> > promise;
+	std::shared_ptr<Waiters> waiters;
+	std::shared_future<EncodedImagePtr> cached;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if(m_Seq < frame->seq)
+		{
+			m_Seq = frame->seq;
+			m_Variants.clear();
+		}
+
+		//older frames from the history do not replace the newest one
+		if(m_Seq == frame->seq)
+		{
+			for(Variant const &variant : m_Variants)
+			{
+				if(variant.params == params)
+				{
+					cached = variant.encoded;
+					//the encoding thread takes the waiters under the mutex once the value is set
+					if(handler && cached.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+					{
+						variant.waiters->push_back(*handler);
+						pending = true;
+					}
+					break;
+				}
+			}
+
+			if(!cached.valid() && m_Variants.size() < MAX_VARIANTS)
+			{
+				promise.reset(new std::promise<EncodedImagePtr>());
+				waiters = std::make_shared<Waiters>();
+				Variant variant;
+				variant.params = params;
+				variant.encoded = promise->get_future().share();
+				variant.waiters = waiters;
+				m_Variants.push_back(variant);
+			}
+		}
+
+		if(cached.valid())
+			m_Hits.fetch_add(1, boost::memory_order_relaxed);
+		else
+			m_Misses.fetch_add(1, boost::memory_order_relaxed);
+	}
+
+	if(pending)
+		return EncodedImagePtr();
+
+	//may wait for an encode of the same frame in progress on another thread
+	if(cached.valid())
+		return cached.get();
+
+	if(!promise)
+		return encode(frame, params);
+
+	EncodedImagePtr encoded = encode(frame, params);
+	promise->set_value(encoded);
+
+	Waiters waiting;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		waiting.swap(*waiters);
+
+		//a frame over the budget is retried by the next request
+		if(!encoded && m_Seq == frame->seq)
+		{
+			m_Variants.erase(
+				std::remove_if(
+					m_Variants.begin(),
+					m_Variants.end(),
+					[&params](Variant const &variant) { return variant.params == params; }
+				),
+				m_Variants.end()
+			);
+		}
+	}
+
+	for(EncodedHandler const &waiter : waiting)
+		waiter(encoded);
+	return encoded;
+}
+
+std::uint64_t EncodedImageCache::hits() const
+{
+	return m_Hits.load(boost::memory_order_relaxed);
+}
+
+std::uint64_t EncodedImageCache::misses() const
+{
+	return m_Misses.load(boost::memory_order_relaxed);
+}
+
+std::uint64_t EncodedImageCache::skipped() const
+{
+	return m_Skipped.load(boost::memory_order_relaxed);
+}
+
+std::uint64_t EncodedImageCache::compressed() const
+{
+	return m_Compressed.load(boost::memory_order_relaxed);
+}
+
+std::uint64_t EncodedImageCache::passedThrough() const
+{
+	return m_PassedThrough.load(boost::memory_order_relaxed);
+}
+
+EncodedImagePtr EncodedImageCache::encode(FramePtr const &frame, cmd::ImageParams const &params)
+{
+	std::chrono::system_clock::time_point started = std::chrono::system_clock::now();
+
+	//the bytes of a compressed transport only need serializing
+	if(isPassthrough(*frame, params))
+	{
+		EncodedImagePtr encoded = EncodedImage::create(*frame, frame->format.c_str(), frame->data, frame->size, started);
+		if(encoded)
+			m_PassedThrough.fetch_add(1, boost::memory_order_relaxed);
+		else
+			m_Skipped.fetch_add(1, boost::memory_order_relaxed);
+		return encoded;
+	}
+
+	FramePtr transformed = transformFrame(frame, params);
+	if(!transformed)
+		return EncodedImagePtr();
+
+	EncodedImagePtr encoded;
+	if(isCompressed(params))
+	{
+		//the compressed bytes are copied into the body, the buffer stays with the thread
+		thread_local std::vector<std::uint8_t> compressed;
+		char const *format = qoi::FORMAT;
+		if(params.format.get() == jpeg::FORMAT)
+		{
+			FramePipeline::Timer timer(Server::instance().framePipeline(), FramePipeline::COMPRESS);
+			format = jpeg::FORMAT;
+			if(jpeg::compress(*transformed, static_cast<int>(params.quality.get_value_or(jpeg::DEFAULT_QUALITY)), compressed))
+				return EncodedImagePtr();
+		}
+		else
+		{
+			FramePipeline::Timer timer(Server::instance().framePipeline(), FramePipeline::COMPRESS);
+			color::Layout layout;
+			color::sourceLayout(transformed->encoding, layout);
+
+			resample::Pixels src;
+			src.data = transformed->data;
+			src.step = transformed->step;
+			src.width = transformed->width;
+			src.height = transformed->height;
+			src.channels = layout.channels;
+			qoi::encode(src, compressed);
+		}
+
+		m_Compressed.fetch_add(1, boost::memory_order_relaxed);
+		encoded = EncodedImage::create(*transformed, format, compressed.data(), compressed.size(), started);
+	}
+	else
+	{
+		encoded = EncodedImage::create(*transformed, started);
+	}
+
+	if(!encoded)
+		m_Skipped.fetch_add(1, boost::memory_order_relaxed);
+	return encoded;
+}
+
+} //namespace srv
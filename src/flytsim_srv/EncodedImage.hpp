@@ -0,0 +1,93 @@
+#ifndef ENCODED_IMAGE_HPP
+#define ENCODED_IMAGE_HPP
+
+#include "Config.hpp"
+#include "Frame.hpp"
+#include "Commands.hpp"
+#include <future>
+
+namespace srv {
+
+class EncodedImage;
+typedef std::shared_ptr<EncodedImage const> EncodedImagePtr;
+
+//immutable "seq:.. stamp:.. received:.. encode_start:.. encode_end:.. width:.. encoding:.. format:.. size:.. data:.." body of one frame,
+//shared by get_image responses and pushes, encode_end is taken once the data is serialized
+class EncodedImage
+{
+public:
+	//takes ownership of the budget charge, released with the last reference, attributes follow the encoding
+	EncodedImage(Frame const &frame, std::string const &attributes, std::uint8_t const *data, std::size_t size, std::size_t charged, std::chrono::system_clock::time_point encodeStart);
+	~EncodedImage();
+
+	EncodedImage(EncodedImage const &) = delete;
+	EncodedImage& operator=(EncodedImage const &) = delete;
+
+	asio::const_buffer buffer() const;
+
+	//charges the memory budget, null if the encoded frame does not fit, encodeStart is when transforming it began
+	static EncodedImagePtr create(Frame const &frame, std::chrono::system_clock::time_point encodeStart);
+	//the frame compressed to format, frame describes the pixels before compression
+	static EncodedImagePtr create(Frame const &frame, char const *format, std::uint8_t const *compressed, std::size_t size, std::chrono::system_clock::time_point encodeStart);
+	//tiles of the frame changed since base, answers a single get_image delta: and is never cached
+	static EncodedImagePtr createDelta(Frame const &frame, std::uint64_t base, std::size_t tiles, std::vector<std::uint8_t> const &delta, std::chrono::system_clock::time_point encodeStart);
+
+	//upper bound of the body size, used to charge the memory budget up front
+	static std::size_t bodySize(std::size_t size);
+
+private:
+	std::string m_Body;
+	std::size_t m_Charged;
+};
+
+//remembers the encodings of the newest frame, concurrent requests for the same params wait for a single encode
+class EncodedImageCache
+{
+public:
+	EncodedImageCache();
+
+	//distinct params kept for the newest frame, more are encoded for every request
+	static std::size_t const MAX_VARIANTS = 8;
+
+	//called with the encoding by the thread that made it
+	typedef std::function<void (EncodedImagePtr const &img)> EncodedHandler;
+
+	//null if the memory budget cannot hold the encoded frame or the params do not apply to it
+	EncodedImagePtr get(FramePtr const &frame, cmd::ImageParams const &params = cmd::ImageParams());
+	//never waits for an encode in progress on another thread, handler gets its result later and pending is set instead
+	EncodedImagePtr get(FramePtr const &frame, cmd::ImageParams const &params, EncodedHandler const &handler, bool &pending);
+
+	std::uint64_t hits() const;
+	std::uint64_t misses() const;
+	std::uint64_t skipped() const;
+	std::uint64_t compressed() const;
+	std::uint64_t passedThrough() const;
+
+private:
+	EncodedImagePtr encode(FramePtr const &frame, cmd::ImageParams const &params);
+	EncodedImagePtr get(FramePtr const &frame, cmd::ImageParams const &params, EncodedHandler const *handler, bool &pending);
+
+	typedef std::vector<EncodedHandler> Waiters;
+
+	struct Variant
+	{
+		cmd::ImageParams params;
+		std::shared_future<EncodedImagePtr> encoded;
+		std::shared_ptr<Waiters> waiters;		//held by the encoding thread too, the variant may be dropped meanwhile
+	};
+
+private:
+	std::mutex m_Mutex;
+	std::uint64_t m_Seq;
+	std::vector<Variant> m_Variants;
+
+	atomic<std::uint64_t> m_Hits;
+	atomic<std::uint64_t> m_Misses;
+	atomic<std::uint64_t> m_Skipped;		//not encoded, memory budget exhausted
+	atomic<std::uint64_t> m_Compressed;		//jpeg and qoi encodes, a cache hit does not compress again
+	atomic<std::uint64_t> m_PassedThrough;	//compressed camera frames sent without decoding
+};
+
+} //namespace srv
+
+#endif //ENCODED_IMAGE_HPP
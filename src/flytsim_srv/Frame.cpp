@@ -0,0 +1,107 @@
+#include "Frame.hpp"
+#include "Jpeg.hpp"
+#include <sensor_msgs/image_encodings.h>
+#include <cstdio>
+#include <cstring>
+
+namespace srv {
+
+Frame::Frame()
+	: seq(0)
+	, stamp()
+	, received()
+	, width(0)
+	, height(0)
+	, step(0)
+	, encoding()
+	, format()
+	, data(nullptr)
+	, size(0)
+	, owner()
+{
+}
+
+void writeTime(char *field, std::chrono::system_clock::time_point time)
+{
+	std::int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+	char digits[TIME_FIELD_SIZE + 1];
+	std::snprintf(digits, sizeof(digits), "%010lld.%06d", static_cast<long long>(us / 1000000), static_cast<int>(us % 1000000));
+	std::memcpy(field, digits, TIME_FIELD_SIZE);
+}
+
+FramePtr makeFrame(sensor_msgs::ImageConstPtr const &img, std::uint64_t seq)
+{
+	std::shared_ptr<Frame> frame = std::make_shared<Frame>();
+	frame->seq = seq;
+	frame->stamp = img->header.stamp;
+	frame->received = std::chrono::system_clock::now();
+	frame->width = img->width;
+	frame->height = img->height;
+	frame->step = img->step;
+	frame->encoding = img->encoding;
+	frame->data = img->data.data();
+	frame->size = img->data.size();
+	//the message is shared with ROS through a boost pointer, the deleter holds on to it
+	frame->owner = std::shared_ptr<void const>(img.get(), [img](void const *) {});
+	return frame;
+}
+
+FramePtr makeFrame(sensor_msgs::CompressedImageConstPtr const &img, std::uint64_t seq)
+{
+	//compressed_image_transport writes "bgr8; jpeg compressed bgr8", older publishers just "jpeg"
+	std::string const &format = img->format;
+	if(format.find(jpeg::FORMAT) == std::string::npos)
+		return FramePtr();
+
+	std::uint32_t width = 0, height = 0, components = 0;
+	if(jpeg::readHeader(img->data.data(), img->data.size(), width, height, components))
+		return FramePtr();
+
+	//decompressed to the encoding the publisher compressed from, alpha comes back opaque
+	std::string encoding = format.substr(0, format.find(';'));
+	if(!jpeg::supports(encoding))
+		encoding = components == 1 ? sensor_msgs::image_encodings::MONO8 : sensor_msgs::image_encodings::RGB8;
+
+	std::shared_ptr<Frame> frame = std::make_shared<Frame>();
+	frame->seq = seq;
+	frame->stamp = img->header.stamp;
+	frame->received = std::chrono::system_clock::now();
+	frame->width = width;
+	frame->height = height;
+	frame->step = 0;
+	frame->encoding = encoding;
+	frame->format = jpeg::FORMAT;
+	frame->data = img->data.data();
+	frame->size = img->data.size();
+	frame->owner = std::shared_ptr<void const>(img.get(), [img](void const *) {});
+	return frame;
+}
+
+FrameSlot::FrameSlot()
+	: m_Frame()
+	, m_LastSeq(0)
+{
+}
+
+FramePtr FrameSlot::load() const
+{
+	return std::atomic_load(&m_Frame);
+}
+
+void FrameSlot::store(FramePtr frame)
+{
+	m_LastSeq = frame->seq;
+	std::atomic_store(&m_Frame, std::move(frame));
+}
+
+void FrameSlot::reset()
+{
+	std::atomic_store(&m_Frame, FramePtr());
+}
+
+std::uint64_t FrameSlot::nextSeq() const
+{
+	return m_LastSeq + 1;
+}
+
+} //namespace srv
@@ -0,0 +1,56 @@
+#ifndef FRAME_HPP
+#define FRAME_HPP
+
+#include "Config.hpp"
+
+namespace srv {
+
+//immutable view of one camera frame, the owner keeps the pixels alive
+struct Frame
+{
+	Frame();
+
+	std::uint64_t seq;			//assigned by the server, increases with every frame starting at 1
+	ros::Time stamp;			//ROS header stamp
+	std::chrono::system_clock::time_point received;	//when the server got it, on the wall clock sent to clients
+	std::uint32_t width;
+	std::uint32_t height;
+	std::uint32_t step;
+	std::string encoding;		//of the pixels, decompressed ones for a compressed frame
+	std::string format;			//jpeg for a frame from a compressed transport, empty for pixels
+	std::uint8_t const *data;
+	std::size_t size;
+	std::shared_ptr<void const> owner;
+};
+
+typedef std::shared_ptr<Frame const> FramePtr;
+
+//wall clock seconds with microseconds, fixed width so a field can be written ahead and filled in later
+std::size_t const TIME_FIELD_SIZE = 17;
+extern void writeTime(char *field, std::chrono::system_clock::time_point time);
+
+extern FramePtr makeFrame(sensor_msgs::ImageConstPtr const &img, std::uint64_t seq);
+//keeps the compressed bytes, null unless the message holds a readable jpeg
+extern FramePtr makeFrame(sensor_msgs::CompressedImageConstPtr const &img, std::uint64_t seq);
+
+//the latest frame, stored by the ROS thread and loaded by any thread without locking
+class FrameSlot
+{
+public:
+	FrameSlot();
+
+	FramePtr load() const;
+	void store(FramePtr frame);
+	void reset();
+
+	//seq of the next frame to store
+	std::uint64_t nextSeq() const;
+
+private:
+	FramePtr m_Frame;
+	std::uint64_t m_LastSeq;		//written only by the thread storing frames
+};
+
+} //namespace srv
+
+#endif //FRAME_HPP
@@ -0,0 +1,139 @@
+#include "FrameHistory.hpp"
+#include "Server.hpp"
+
+namespace srv {
+
+FrameHistory::FrameHistory()
+	: m_Mutex()
+	, m_Frames()
+	, m_First(0)
+	, m_Size(0)
+	, m_Bytes(0)
+	, m_MaxAge(0.0)
+{
+}
+
+system::error_code FrameHistory::configure(std::size_t frames, double seconds)
+{
+	if(seconds < 0.0 || (seconds > 0.0 && !frames))
+		return make_error_code(system::errc::invalid_argument);
+
+	clear();
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Frames.assign(frames, FramePtr());
+	m_First = 0;
+	m_MaxAge = seconds;
+	return system::error_code();
+}
+
+std::size_t FrameHistory::capacity() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Frames.size();
+}
+
+double FrameHistory::maxAge() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_MaxAge;
+}
+
+void FrameHistory::push(FramePtr const &frame)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if(m_Frames.empty())
+		return;
+
+	if(m_Size == m_Frames.size())
+		popOldest();
+
+	m_Frames[(m_First + m_Size) % m_Frames.size()] = frame;
+	++m_Size;
+	m_Bytes += frame->size;
+	Server::instance().memoryBudget().acquire(frame->size);
+
+	if(m_MaxAge > 0.0)
+	{
+		double newest = frame->stamp.toSec();
+		while(m_Size > 1 && newest - at(0)->stamp.toSec() > m_MaxAge)
+			popOldest();
+	}
+}
+
+void FrameHistory::clear()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	while(m_Size)
+		popOldest();
+}
+
+FramePtr FrameHistory::findSeq(std::uint64_t seq) const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if(!m_Size)
+		return FramePtr();
+
+	//every frame is pushed, so sequence numbers in the ring are contiguous
+	std::uint64_t oldest = at(0)->seq;
+	if(seq < oldest || seq - oldest >= m_Size)
+		return FramePtr();
+
+	return at(seq - oldest);
+}
+
+FramePtr FrameHistory::findStamp(double stamp) const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if(!m_Size || stamp < at(0)->stamp.toSec())
+		return FramePtr();
+
+	//binary search for the first frame not older than the stamp
+	std::size_t lo = 0, hi = m_Size;
+	while(lo < hi)
+	{
+		std::size_t mid = lo + (hi - lo) / 2;
+		if(at(mid)->stamp.toSec() < stamp)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if(lo == m_Size)
+		return at(m_Size - 1);
+
+	if(lo > 0 && stamp - at(lo - 1)->stamp.toSec() <= at(lo)->stamp.toSec() - stamp)
+		return at(lo - 1);
+
+	return at(lo);
+}
+
+std::size_t FrameHistory::size() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Size;
+}
+
+std::size_t FrameHistory::bytes() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Bytes;
+}
+
+FramePtr const& FrameHistory::at(std::size_t index) const
+{
+	return m_Frames[(m_First + index) % m_Frames.size()];
+}
+
+void FrameHistory::popOldest()
+{
+	FramePtr &oldest = m_Frames[m_First];
+	m_Bytes -= oldest->size;
+	Server::instance().memoryBudget().release(oldest->size);
+	oldest.reset();
+
+	m_First = (m_First + 1) % m_Frames.size();
+	--m_Size;
+}
+
+} //namespace srv
@@ -0,0 +1,48 @@
+#ifndef FRAME_HISTORY_HPP
+#define FRAME_HISTORY_HPP
+
+#include "Config.hpp"
+#include "Frame.hpp"
+
+namespace srv {
+
+//ring of the most recent frames, looked up by sequence number or by stamp
+class FrameHistory
+{
+public:
+	FrameHistory();
+
+	//keeps at most frames frames no older than seconds behind the newest, 0 seconds does not limit the age
+	//seconds alone are invalid, the ring is sized by frames
+	system::error_code configure(std::size_t frames, double seconds);
+	std::size_t capacity() const;
+	double maxAge() const;
+
+	//called from the ROS thread storing frames, in sequence order
+	void push(FramePtr const &frame);
+	void clear();
+
+	//null unless the frame is still held
+	FramePtr findSeq(std::uint64_t seq) const;
+	//the frame closest to the stamp in seconds, null if the stamp is older than the history
+	FramePtr findStamp(double stamp) const;
+
+	std::size_t size() const;
+	std::size_t bytes() const;
+
+private:
+	FramePtr const& at(std::size_t index) const;	//0 is the oldest frame
+	void popOldest();
+
+private:
+	mutable std::mutex m_Mutex;
+	std::vector<FramePtr> m_Frames;		//preallocated to the capacity
+	std::size_t m_First;
+	std::size_t m_Size;
+	std::size_t m_Bytes;				//pixel data held, charged to the server memory budget
+	double m_MaxAge;
+};
+
+} //namespace srv
+
+#endif //FRAME_HISTORY_HPP
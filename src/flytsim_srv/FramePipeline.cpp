@@ -0,0 +1,91 @@
+#include "FramePipeline.hpp"
+#include <algorithm>
+
+namespace srv {
+
+StageStats::StageStats()
+	: m_Count(0)
+	, m_TotalNs(0)
+	, m_MaxNs(0)
+{
+}
+
+void StageStats::record(std::chrono::steady_clock::duration elapsed)
+{
+	std::uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+	m_Count.fetch_add(1, boost::memory_order_relaxed);
+	m_TotalNs.fetch_add(ns, boost::memory_order_relaxed);
+
+	std::uint64_t max = m_MaxNs.load(boost::memory_order_relaxed);
+	while(ns > max && !m_MaxNs.compare_exchange_weak(max, ns, boost::memory_order_relaxed))
+		;
+}
+
+std::uint64_t StageStats::count() const
+{
+	return m_Count.load(boost::memory_order_relaxed);
+}
+
+std::uint64_t StageStats::averageUs() const
+{
+	std::uint64_t count = m_Count.load(boost::memory_order_relaxed);
+	return count ? m_TotalNs.load(boost::memory_order_relaxed) / count / 1000 : 0;
+}
+
+std::uint64_t StageStats::maxUs() const
+{
+	return m_MaxNs.load(boost::memory_order_relaxed) / 1000;
+}
+
+std::size_t const FramePipeline::MIN_STRIPE_BYTES;
+
+FramePipeline::FramePipeline(WorkerPool &workers)
+	: m_Workers(workers)
+	, m_Stats()
+{
+}
+
+char const* FramePipeline::stageName(Stage stage)
+{
+	switch(stage)
+	{
+	case DECOMPRESS: return "decompress";
+	case CONVERT: return "convert";
+	case SCALE: return "scale";
+	case COMPRESS: return "compress";
+	case SERIALIZE: return "serialize";
+	default: return "unknown";
+	}
+}
+
+void FramePipeline::record(Stage stage, std::chrono::steady_clock::duration elapsed)
+{
+	m_Stats[stage].record(elapsed);
+}
+
+StageStats const& FramePipeline::stats(Stage stage) const
+{
+	return m_Stats[stage];
+}
+
+std::size_t FramePipeline::stripeCount(std::uint32_t rows, std::size_t rowSize, std::uint32_t alignment) const
+{
+	//one stripe per worker plus one for the calling thread at most
+	std::size_t units = (rows + alignment - 1) / alignment;
+	std::size_t bySize = std::size_t(rows) * rowSize / MIN_STRIPE_BYTES;
+	return std::max<std::size_t>(std::min(std::min(units, bySize), m_Workers.size() + 1), 1);
+}
+
+FramePipeline::Timer::Timer(FramePipeline &pipeline, Stage stage)
+	: m_Pipeline(pipeline)
+	, m_Stage(stage)
+	, m_Started(std::chrono::steady_clock::now())
+{
+}
+
+FramePipeline::Timer::~Timer()
+{
+	m_Pipeline.record(m_Stage, std::chrono::steady_clock::now() - m_Started);
+}
+
+} //namespace srv
@@ -0,0 +1,86 @@
+#ifndef FRAME_PIPELINE_HPP
+#define FRAME_PIPELINE_HPP
+
+#include "Config.hpp"
+#include "WorkerPool.hpp"
+
+namespace srv {
+
+//latency of one pipeline stage, updated from any thread
+class StageStats
+{
+public:
+	StageStats();
+
+	void record(std::chrono::steady_clock::duration elapsed);
+
+	std::uint64_t count() const;
+	std::uint64_t averageUs() const;
+	std::uint64_t maxUs() const;
+
+private:
+	atomic<std::uint64_t> m_Count;
+	atomic<std::uint64_t> m_TotalNs;
+	atomic<std::uint64_t> m_MaxNs;
+};
+
+//a frame goes through decompress, convert, scale, compress and serialize, the row oriented stages split
+//large frames into horizontal stripes run on all workers so big frames take about as long as small ones
+class FramePipeline
+{
+public:
+	enum Stage { DECOMPRESS, CONVERT, SCALE, COMPRESS, SERIALIZE, STAGES };
+
+	//smaller stripes cost more in handoffs than they save
+	static std::size_t const MIN_STRIPE_BYTES = 128 * 1024;
+
+	explicit FramePipeline(WorkerPool &workers);
+
+	static char const* stageName(Stage stage);
+
+	//calls f(begin, end) for stripes covering rows, begin is a multiple of alignment
+	template <typename Function>
+	void forEachStripe(std::uint32_t rows, std::size_t rowSize, std::uint32_t alignment, Function f)
+	{
+		std::size_t stripes = stripeCount(rows, rowSize, alignment);
+		if(stripes < 2)
+		{
+			f(std::uint32_t(0), rows);
+			return;
+		}
+
+		std::uint32_t units = (rows + alignment - 1) / alignment;
+		m_Workers.parallelFor(stripes, [=](std::size_t s) {
+			std::uint32_t begin = std::uint32_t(units * s / stripes) * alignment;
+			std::uint32_t end = std::min<std::uint32_t>(std::uint32_t(units * (s + 1) / stripes) * alignment, rows);
+			f(begin, end);
+		});
+	}
+
+	void record(Stage stage, std::chrono::steady_clock::duration elapsed);
+	StageStats const& stats(Stage stage) const;
+
+	//records the time from construction to destruction
+	class Timer
+	{
+	public:
+		Timer(FramePipeline &pipeline, Stage stage);
+		~Timer();
+
+	private:
+		FramePipeline &m_Pipeline;
+		Stage m_Stage;
+		std::chrono::steady_clock::time_point m_Started;
+	};
+
+private:
+	std::size_t stripeCount(std::uint32_t rows, std::size_t rowSize, std::uint32_t alignment) const;
+
+private:
+	WorkerPool &m_Workers;
+	StageStats m_Stats[STAGES];
+};
+
+} //namespace srv
+
+#endif //FRAME_PIPELINE_HPP
@@ -0,0 +1,457 @@
+#include "FrameRecording.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace srv {
+
+namespace {
+
+	//frames start on cache lines, the pixels are read in place by the simd kernels
+	std::size_t const RECORD_ALIGNMENT = 64;
+	std::size_t const DATA_RESERVE = 64 * 1024 * 1024;
+	std::size_t const INDEX_RESERVE = 1024 * 1024;
+	std::uint32_t const RECORDING_VERSION = 1;
+
+	char const DATA_MAGIC[8] = { 'F', 'L', 'Y', 'T', 'R', 'E', 'C', '1' };
+	char const INDEX_MAGIC[8] = { 'F', 'L', 'Y', 'T', 'I', 'D', 'X', '1' };
+
+	struct FileHeader
+	{
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t reserved;
+	};
+
+	//followed by the frame bytes, padded to the alignment
+	struct RecordHeader
+	{
+		std::uint32_t camera;
+		std::uint32_t width;
+		std::uint32_t height;
+		std::uint32_t step;
+		std::uint64_t size;
+		char encoding[24];
+		char format[16];
+	};
+
+	struct IndexEntry
+	{
+		std::uint64_t seq;
+		std::uint32_t sec;
+		std::uint32_t nsec;
+		std::uint64_t offset;
+	};
+
+	std::size_t const DATA_HEADER_SIZE = RECORD_ALIGNMENT;
+
+	std::size_t aligned(std::size_t size)
+	{
+		return (size + RECORD_ALIGNMENT - 1) / RECORD_ALIGNMENT * RECORD_ALIGNMENT;
+	}
+
+	system::error_code lastError()
+	{
+		return system::error_code(errno, system::system_category());
+	}
+
+	bool hasMagic(MappedFile const &file, char const (&magic)[8], std::size_t headerSize)
+	{
+		if(file.size() < headerSize)
+			return false;
+		FileHeader const *header = reinterpret_cast<FileHeader const *>(file.data());
+		return std::memcmp(header->magic, magic, sizeof(magic)) == 0 && header->version == RECORDING_VERSION;
+	}
+
+	void writeHeader(std::uint8_t *at, std::size_t size, char const (&magic)[8])
+	{
+		std::memset(at, 0, size);
+		FileHeader *header = reinterpret_cast<FileHeader *>(at);
+		std::memcpy(header->magic, magic, sizeof(magic));
+		header->version = RECORDING_VERSION;
+	}
+
+	//truncated to fit, always terminated
+	void copyString(char *to, std::size_t size, std::string const &from)
+	{
+		std::size_t length = std::min(from.size(), size - 1);
+		std::memcpy(to, from.data(), length);
+		to[length] = '\0';
+	}
+
+} //namespace anonymous
+
+MappedFile::MappedFile()
+	: m_Fd(-1)
+	, m_Writable(false)
+	, m_Data(nullptr)
+	, m_Size(0)
+	, m_Capacity(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+system::error_code MappedFile::create(std::string const &path, std::size_t capacity)
+{
+	close();
+
+	m_Fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if(m_Fd < 0)
+		return lastError();
+
+	m_Writable = true;
+	if(system::error_code me = map(capacity))
+	{
+		close();
+		return me;
+	}
+	return system::error_code();
+}
+
+system::error_code MappedFile::openRead(std::string const &path)
+{
+	close();
+
+	m_Fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if(m_Fd < 0)
+		return lastError();
+
+	struct stat st;
+	if(::fstat(m_Fd, &st) < 0)
+	{
+		system::error_code se = lastError();
+		close();
+		return se;
+	}
+
+	if(!st.st_size)
+	{
+		close();
+		return make_error_code(system::errc::invalid_argument);
+	}
+
+	m_Writable = false;
+	if(system::error_code me = map(static_cast<std::size_t>(st.st_size)))
+	{
+		close();
+		return me;
+	}
+	m_Size = m_Capacity;
+	return system::error_code();
+}
+
+void MappedFile::close()
+{
+	if(m_Data)
+		::munmap(m_Data, m_Capacity);
+	if(m_Fd >= 0)
+	{
+		//a reserve that cannot be cut stays zeroed at the end, readers go by the index
+		if(m_Writable && ::ftruncate(m_Fd, static_cast<off_t>(m_Size)) < 0)
+			m_Writable = false;
+		::close(m_Fd);
+	}
+	m_Fd = -1;
+	m_Writable = false;
+	m_Data = nullptr;
+	m_Size = 0;
+	m_Capacity = 0;
+}
+
+bool MappedFile::isOpen() const
+{
+	return m_Fd >= 0;
+}
+
+std::uint8_t* MappedFile::append(std::size_t size)
+{
+	if(!m_Writable)
+		return nullptr;
+
+	if(m_Size + size > m_Capacity && map(std::max(m_Capacity * 2, m_Size + size)))
+		return nullptr;
+
+	std::uint8_t *at = m_Data + m_Size;
+	m_Size += size;
+	return at;
+}
+
+std::uint8_t const* MappedFile::data() const
+{
+	return m_Data;
+}
+
+std::size_t MappedFile::size() const
+{
+	return m_Size;
+}
+
+system::error_code MappedFile::map(std::size_t capacity)
+{
+	if(m_Writable && ::ftruncate(m_Fd, static_cast<off_t>(capacity)) < 0)
+		return lastError();
+
+	//the pages written so far are in the file, the new mapping sees them
+	if(m_Data)
+	{
+		::munmap(m_Data, m_Capacity);
+		m_Data = nullptr;
+		m_Capacity = 0;
+	}
+
+	int protection = m_Writable ? PROT_READ | PROT_WRITE : PROT_READ;
+	void *data = ::mmap(nullptr, capacity, protection, MAP_SHARED, m_Fd, 0);
+	if(data == MAP_FAILED)
+		return lastError();
+
+	m_Data = static_cast<std::uint8_t *>(data);
+	m_Capacity = capacity;
+	return system::error_code();
+}
+
+FrameRecorder::FrameRecorder()
+	: m_Mutex()
+	, m_Data()
+	, m_Index()
+	, m_bOpen(false)
+	, m_Frames(0)
+	, m_Bytes(0)
+{
+}
+
+system::error_code FrameRecorder::open(std::string const &path)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if(system::error_code de = m_Data.create(path, DATA_RESERVE))
+		return de;
+	if(system::error_code ie = m_Index.create(path + ".index", INDEX_RESERVE))
+	{
+		m_Data.close();
+		return ie;
+	}
+
+	writeHeader(m_Data.append(DATA_HEADER_SIZE), DATA_HEADER_SIZE, DATA_MAGIC);
+	writeHeader(m_Index.append(sizeof(FileHeader)), sizeof(FileHeader), INDEX_MAGIC);
+	m_Frames = 0;
+	m_Bytes = 0;
+	m_bOpen = true;
+	return system::error_code();
+}
+
+void FrameRecorder::close()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_bOpen = false;
+	m_Data.close();
+	m_Index.close();
+}
+
+bool FrameRecorder::isOpen() const
+{
+	return m_bOpen;
+}
+
+system::error_code FrameRecorder::append(std::size_t camera, Frame const &frame)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if(!m_bOpen)
+		return make_error_code(system::errc::bad_file_descriptor);
+
+	std::size_t recordSize = aligned(sizeof(RecordHeader)) + aligned(frame.size);
+	std::uint8_t *record = m_Data.append(recordSize);
+	if(!record)
+		return make_error_code(system::errc::no_space_on_device);
+	std::uint64_t offset = m_Data.size() - recordSize;
+
+	RecordHeader *header = reinterpret_cast<RecordHeader *>(record);
+	header->camera = static_cast<std::uint32_t>(camera);
+	header->width = frame.width;
+	header->height = frame.height;
+	header->step = frame.step;
+	header->size = frame.size;
+	copyString(header->encoding, sizeof(header->encoding), frame.encoding);
+	copyString(header->format, sizeof(header->format), frame.format);
+	std::memcpy(record + aligned(sizeof(RecordHeader)), frame.data, frame.size);
+
+	//the entry goes last, a reader never finds one for a record not fully written
+	IndexEntry *entry = reinterpret_cast<IndexEntry *>(m_Index.append(sizeof(IndexEntry)));
+	if(!entry)
+		return make_error_code(system::errc::no_space_on_device);
+	entry->seq = frame.seq;
+	entry->sec = frame.stamp.sec;
+	entry->nsec = frame.stamp.nsec;
+	entry->offset = offset;
+
+	m_Frames.fetch_add(1, boost::memory_order_relaxed);
+	m_Bytes.fetch_add(frame.size, boost::memory_order_relaxed);
+	return system::error_code();
+}
+
+std::uint64_t FrameRecorder::frames() const
+{
+	return m_Frames.load(boost::memory_order_relaxed);
+}
+
+std::uint64_t FrameRecorder::bytes() const
+{
+	return m_Bytes.load(boost::memory_order_relaxed);
+}
+
+FrameRecording::FrameRecording()
+	: m_Data()
+	, m_Index()
+	, m_Size(0)
+{
+}
+
+system::error_code FrameRecording::open(std::string const &path)
+{
+	if(system::error_code de = m_Data.openRead(path))
+		return de;
+	if(system::error_code ie = m_Index.openRead(path + ".index"))
+		return ie;
+
+	if(!hasMagic(m_Data, DATA_MAGIC, DATA_HEADER_SIZE) || !hasMagic(m_Index, INDEX_MAGIC, sizeof(FileHeader)))
+		return make_error_code(system::errc::invalid_argument);
+
+	IndexEntry const *entries = reinterpret_cast<IndexEntry const *>(m_Index.data() + sizeof(FileHeader));
+	std::size_t count = (m_Index.size() - sizeof(FileHeader)) / sizeof(IndexEntry);
+	for(m_Size = 0; m_Size < count; ++m_Size)
+	{
+		//the index reserve of a recorder that crashed is zeroed, no record starts inside the file header
+		std::uint64_t offset = entries[m_Size].offset;
+		if(offset < DATA_HEADER_SIZE || offset % RECORD_ALIGNMENT || offset + sizeof(RecordHeader) > m_Data.size())
+			break;
+		RecordHeader const *header = reinterpret_cast<RecordHeader const *>(m_Data.data() + offset);
+		if(header->size > m_Data.size() - offset - aligned(sizeof(RecordHeader)))
+			break;
+	}
+
+	if(!m_Size)
+		return make_error_code(system::errc::invalid_argument);
+	return system::error_code();
+}
+
+std::size_t FrameRecording::size() const
+{
+	return m_Size;
+}
+
+std::size_t FrameRecording::camera(std::size_t index) const
+{
+	IndexEntry const &entry = reinterpret_cast<IndexEntry const *>(m_Index.data() + sizeof(FileHeader))[index];
+	return reinterpret_cast<RecordHeader const *>(m_Data.data() + entry.offset)->camera;
+}
+
+double FrameRecording::stamp(std::size_t index) const
+{
+	IndexEntry const &entry = reinterpret_cast<IndexEntry const *>(m_Index.data() + sizeof(FileHeader))[index];
+	return ros::Time(entry.sec, entry.nsec).toSec();
+}
+
+std::shared_ptr<Frame> FrameRecording::frame(std::size_t index) const
+{
+	IndexEntry const &entry = reinterpret_cast<IndexEntry const *>(m_Index.data() + sizeof(FileHeader))[index];
+	RecordHeader const *header = reinterpret_cast<RecordHeader const *>(m_Data.data() + entry.offset);
+
+	std::shared_ptr<Frame> frame = std::make_shared<Frame>();
+	frame->seq = entry.seq;
+	frame->stamp = ros::Time(entry.sec, entry.nsec);
+	frame->width = header->width;
+	frame->height = header->height;
+	frame->step = header->step;
+	frame->encoding = header->encoding;
+	frame->format = header->format;
+	frame->data = reinterpret_cast<std::uint8_t const *>(header) + aligned(sizeof(RecordHeader));
+	frame->size = static_cast<std::size_t>(header->size);
+	frame->owner = shared_from_this();
+	return frame;
+}
+
+FramePlayer::FramePlayer()
+	: m_Recording()
+	, m_Handler()
+	, m_Thread()
+	, m_Mutex()
+	, m_StopCondition()
+	, m_bStop(false)
+	, m_Played(0)
+{
+}
+
+FramePlayer::~FramePlayer()
+{
+	stop();
+}
+
+system::error_code FramePlayer::open(std::string const &path)
+{
+	std::shared_ptr<FrameRecording> recording = std::make_shared<FrameRecording>();
+	if(system::error_code oe = recording->open(path))
+		return oe;
+	m_Recording = recording;
+	return system::error_code();
+}
+
+bool FramePlayer::isOpen() const
+{
+	return static_cast<bool>(m_Recording);
+}
+
+void FramePlayer::start(double rate, bool loop, FrameHandler handler)
+{
+	m_Handler = std::move(handler);
+	m_bStop = false;
+	m_Thread = std::thread(&FramePlayer::run, this, rate, loop);
+}
+
+void FramePlayer::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_bStop = true;
+	}
+	m_StopCondition.notify_all();
+	if(m_Thread.joinable())
+		m_Thread.join();
+}
+
+std::uint64_t FramePlayer::framesPlayed() const
+{
+	return m_Played.load(boost::memory_order_relaxed);
+}
+
+void FramePlayer::run(double rate, bool loop)
+{
+	std::size_t count = m_Recording->size();
+	double first = m_Recording->stamp(0);
+	do
+	{
+		//frames are due at their recorded distance from the first one, late ones go out at once
+		std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+		for(std::size_t f = 0; f < count; ++f)
+		{
+			std::chrono::duration<double> offset(std::max(m_Recording->stamp(f) - first, 0.0) / rate);
+			std::chrono::steady_clock::time_point due = started + std::chrono::duration_cast<std::chrono::steady_clock::duration>(offset);
+			{
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				if(m_StopCondition.wait_until(lock, due, [this]() { return m_bStop; }))
+					return;
+			}
+
+			m_Handler(m_Recording->camera(f), m_Recording->frame(f));
+			m_Played.fetch_add(1, boost::memory_order_relaxed);
+		}
+	}
+	while(loop);
+}
+
+} //namespace srv
@@ -0,0 +1,124 @@
+#ifndef FRAME_RECORDING_HPP
+#define FRAME_RECORDING_HPP
+
+#include "Config.hpp"
+#include "Frame.hpp"
+#include <thread>
+#include <condition_variable>
+
+namespace srv {
+
+//a whole file mapped into memory, a created one grows by remapping as it is appended to
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(MappedFile const &) = delete;
+	MappedFile& operator=(MappedFile const &) = delete;
+
+	//truncates the file, the mapping reserves capacity bytes ahead
+	system::error_code create(std::string const &path, std::size_t capacity);
+	system::error_code openRead(std::string const &path);
+	//the reserve beyond the appended bytes is cut from the file
+	void close();
+	bool isOpen() const;
+
+	//size bytes at the end of the file, null if it cannot grow, earlier pointers are invalid once it did
+	std::uint8_t* append(std::size_t size);
+
+	std::uint8_t const* data() const;
+	std::size_t size() const;
+
+private:
+	system::error_code map(std::size_t capacity);
+
+private:
+	int m_Fd;
+	bool m_Writable;
+	std::uint8_t *m_Data;
+	std::size_t m_Size;
+	std::size_t m_Capacity;
+};
+
+//appends frames to path and their seq, stamp and offset to path.index, from any thread
+class FrameRecorder
+{
+public:
+	FrameRecorder();
+
+	system::error_code open(std::string const &path);
+	void close();
+	bool isOpen() const;
+
+	system::error_code append(std::size_t camera, Frame const &frame);
+
+	std::uint64_t frames() const;
+	std::uint64_t bytes() const;
+
+private:
+	std::mutex m_Mutex;
+	MappedFile m_Data;
+	MappedFile m_Index;
+	atomic<bool> m_bOpen;
+	atomic<std::uint64_t> m_Frames;
+	atomic<std::uint64_t> m_Bytes;
+};
+
+//a recording mapped read-only, its frames point into the mapping and keep it alive
+class FrameRecording
+	: public std::enable_shared_from_this<FrameRecording>
+{
+public:
+	FrameRecording();
+
+	//a record cut short by a crash ends the recording
+	system::error_code open(std::string const &path);
+
+	std::size_t size() const;
+	std::size_t camera(std::size_t index) const;
+	double stamp(std::size_t index) const;
+	//with the recorded seq and stamp, the pixels are not copied
+	std::shared_ptr<Frame> frame(std::size_t index) const;
+
+private:
+	MappedFile m_Data;
+	MappedFile m_Index;
+	std::size_t m_Size;
+};
+
+//feeds a recording on its own thread at the recorded pace times rate
+class FramePlayer
+{
+public:
+	typedef std::function<void (std::size_t camera, std::shared_ptr<Frame> const &frame)> FrameHandler;
+
+	FramePlayer();
+	~FramePlayer();
+
+	system::error_code open(std::string const &path);
+	bool isOpen() const;
+
+	//with loop the recording starts over after its last frame
+	void start(double rate, bool loop, FrameHandler handler);
+	void stop();
+
+	std::uint64_t framesPlayed() const;
+
+private:
+	void run(double rate, bool loop);
+
+private:
+	std::shared_ptr<FrameRecording> m_Recording;
+	FrameHandler m_Handler;
+	std::thread m_Thread;
+	std::mutex m_Mutex;
+	std::condition_variable m_StopCondition;
+	bool m_bStop;
+	atomic<std::uint64_t> m_Played;
+};
+
+} //namespace srv
+
+#endif //FRAME_RECORDING_HPP
@@ -0,0 +1,107 @@
+#include "ImageBroadcaster.hpp"
+#include "Connection.hpp"
+#include <algorithm>
+
+namespace srv {
+
+ImageBroadcaster::ImageBroadcaster()
+	: m_SubscribersMutex()
+	, m_Subscribers()
+	, m_FramesBroadcast(0)
+{
+}
+
+void ImageBroadcaster::subscribe(std::shared_ptr<Connection> const &conn, cmd::ImageParams const &params)
+{
+	std::lock_guard<std::mutex> lock(m_SubscribersMutex);
+	for(Subscriber &subscriber : m_Subscribers)
+	{
+		if(subscriber.conn.lock() == conn)
+		{
+			subscriber.params = params;
+			return;
+		}
+	}
+
+	Subscriber subscriber;
+	subscriber.conn = conn;
+	subscriber.params = params;
+	m_Subscribers.push_back(subscriber);
+}
+
+void ImageBroadcaster::unsubscribe(Connection const *conn)
+{
+	std::lock_guard<std::mutex> lock(m_SubscribersMutex);
+	m_Subscribers.erase(
+		std::remove_if(
+			m_Subscribers.begin(),
+			m_Subscribers.end(),
+			[conn](Subscriber const &subscriber)
+			{
+				std::shared_ptr<Connection> locked = subscriber.conn.lock();
+				return !locked || locked.get() == conn;
+			}
+		),
+		m_Subscribers.end()
+	);
+}
+
+bool ImageBroadcaster::hasSubscribers()
+{
+	std::lock_guard<std::mutex> lock(m_SubscribersMutex);
+	return !m_Subscribers.empty();
+}
+
+void ImageBroadcaster::broadcast(FramePtr const &frame, EncodedImageCache &cache)
+{
+	std::vector<Subscriber> recipients;
+	{
+		std::lock_guard<std::mutex> lock(m_SubscribersMutex);
+		recipients = m_Subscribers;
+	}
+
+	//subscribers sharing params share the encoding, even past the variants the cache keeps
+	std::vector< std::pair<cmd::ImageParams, EncodedImagePtr> > encoded;
+	bool broadcast = false;
+	for(Subscriber const &recipient : recipients)
+	{
+		std::shared_ptr<Connection> conn = recipient.conn.lock();
+		if(!conn)
+			continue;
+
+		EncodedImagePtr img;
+		bool found = false;
+		for(std::pair<cmd::ImageParams, EncodedImagePtr> const &variant : encoded)
+		{
+			if(variant.first == recipient.params)
+			{
+				img = variant.second;
+				found = true;
+				break;
+			}
+		}
+
+		if(!found)
+		{
+			img = cache.get(frame, recipient.params);
+			encoded.push_back(std::make_pair(recipient.params, img));
+		}
+
+		//over the memory budget or params not applicable to this frame
+		if(!img)
+			continue;
+
+		conn->pushImage(img);
+		broadcast = true;
+	}
+
+	if(broadcast)
+		m_FramesBroadcast.fetch_add(1, boost::memory_order_relaxed);
+}
+
+std::uint64_t ImageBroadcaster::framesBroadcast() const
+{
+	return m_FramesBroadcast.load(boost::memory_order_relaxed);
+}
+
+} //namespace srv
@@ -0,0 +1,44 @@
+#ifndef IMAGE_BROADCASTER_HPP
+#define IMAGE_BROADCASTER_HPP
+
+#include "Config.hpp"
+#include "EncodedImage.hpp"
+#include "Commands.hpp"
+
+namespace srv {
+
+class Connection;
+
+//hands the same encoded frame to every connection subscribed with the same image params
+class ImageBroadcaster
+{
+public:
+	ImageBroadcaster();
+
+	//subscribing again replaces the params
+	void subscribe(std::shared_ptr<Connection> const &conn, cmd::ImageParams const &params);
+	void unsubscribe(Connection const *conn);
+	bool hasSubscribers();
+
+	//every distinct params are encoded once through the cache
+	void broadcast(FramePtr const &frame, EncodedImageCache &cache);
+
+	std::uint64_t framesBroadcast() const;
+
+private:
+	struct Subscriber
+	{
+		std::weak_ptr<Connection> conn;
+		cmd::ImageParams params;
+	};
+
+private:
+	std::mutex m_SubscribersMutex;
+	std::vector<Subscriber> m_Subscribers;
+
+	atomic<std::uint64_t> m_FramesBroadcast;
+};
+
+} //namespace srv
+
+#endif //IMAGE_BROADCASTER_HPP
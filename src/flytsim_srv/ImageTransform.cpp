@@ -0,0 +1,297 @@
+#include "ImageTransform.hpp"
+#include "Server.hpp"
+#include "Resample.hpp"
+#include "ColorConvert.hpp"
+#include "Jpeg.hpp"
+#include "Qoi.hpp"
+#include <sensor_msgs/image_encodings.h>
+#include <stdexcept>
+#include <algorithm>
+
+namespace srv {
+
+namespace {
+
+	//bayer mosaics and encodings unknown to ROS are sent untouched
+	bool pixelLayout(std::string const &encoding, std::uint32_t &channels, std::uint32_t &depth)
+	{
+		namespace enc = sensor_msgs::image_encodings;
+		if(enc::isBayer(encoding))
+			return false;
+
+		try
+		{
+			channels = enc::numChannels(encoding);
+			depth = enc::bitDepth(encoding);
+		}
+		catch(std::runtime_error const &)
+		{
+			return false;
+		}
+		return depth % 8 == 0;
+	}
+
+	std::uint32_t keepAspect(std::uint32_t size, std::uint32_t from, std::uint32_t to)
+	{
+		return std::max<std::uint32_t>(static_cast<std::uint32_t>((std::uint64_t(size) * to + from / 2) / from), 1);
+	}
+
+	//a frame owning its pixels, numbered and stamped as the source one
+	FramePtr makeFrame(Frame const &source, std::uint32_t width, std::uint32_t height, std::uint32_t step, std::string const &encoding, std::size_t size, std::uint8_t *&data)
+	{
+		std::shared_ptr< std::vector<std::uint8_t> > pixels = std::make_shared< std::vector<std::uint8_t> >(size);
+		data = pixels->data();
+
+		std::shared_ptr<Frame> frame = std::make_shared<Frame>();
+		frame->seq = source.seq;
+		frame->stamp = source.stamp;
+		frame->received = source.received;
+		frame->width = width;
+		frame->height = height;
+		frame->step = step;
+		frame->encoding = encoding;
+		frame->data = pixels->data();
+		frame->size = size;
+		frame->owner = pixels;
+		return frame;
+	}
+
+	FramePtr decompressFrame(FramePtr const &frame)
+	{
+		FramePipeline::Timer timer(Server::instance().framePipeline(), FramePipeline::DECOMPRESS);
+		color::Layout layout;
+		color::sourceLayout(frame->encoding, layout);
+		std::uint32_t step = frame->width * layout.channels;
+		std::uint8_t *dst = nullptr;
+		FramePtr decoded = makeFrame(*frame, frame->width, frame->height, step, frame->encoding, std::size_t(step) * frame->height, dst);
+		if(jpeg::decompress(*frame, dst, step))
+			return FramePtr();
+		return decoded;
+	}
+
+} //namespace anonymous
+
+system::error_code validateImageParams(cmd::ImageParams const &params)
+{
+	if(params.width && (!params.width.get() || params.width.get() > MAX_IMAGE_DIMENSION))
+		return make_error_code(system::errc::invalid_argument);
+
+	if(params.height && (!params.height.get() || params.height.get() > MAX_IMAGE_DIMENSION))
+		return make_error_code(system::errc::invalid_argument);
+
+	if(params.roi && (!params.roi->w || !params.roi->h))
+		return make_error_code(system::errc::invalid_argument);
+
+	if(params.encoding && !color::isTarget(params.encoding.get()))
+		return make_error_code(system::errc::invalid_argument);
+
+	bool lossy = params.format && params.format.get() == jpeg::FORMAT;
+	bool lossless = params.format && params.format.get() == qoi::FORMAT;
+	if(params.format && !lossy && !lossless && params.format.get() != "raw")
+		return make_error_code(system::errc::invalid_argument);
+
+	//quality without jpeg would only split the cache
+	if(params.quality && (!lossy || !params.quality.get() || params.quality.get() > 100))
+		return make_error_code(system::errc::invalid_argument);
+
+	if(lossy && params.encoding && !jpeg::supports(params.encoding.get()))
+		return make_error_code(system::errc::not_supported);
+
+	if(lossless && params.encoding && !qoi::supports(params.encoding.get()))
+		return make_error_code(system::errc::not_supported);
+
+	return system::error_code();
+}
+
+system::error_code resolveImageParams(Frame const &frame, cmd::ImageParams const &params, ImageGeometry &geometry)
+{
+	if(system::error_code ve = validateImageParams(params))
+		return ve;
+
+	geometry.x = 0;
+	geometry.y = 0;
+	geometry.w = frame.width;
+	geometry.h = frame.height;
+	if(params.roi)
+	{
+		cmd::Roi const &roi = params.roi.get();
+		if(roi.x >= frame.width || roi.y >= frame.height)
+			return make_error_code(system::errc::result_out_of_range);
+
+		geometry.x = roi.x;
+		geometry.y = roi.y;
+		geometry.w = std::min(roi.w, frame.width - roi.x);
+		geometry.h = std::min(roi.h, frame.height - roi.y);
+	}
+
+	geometry.width = geometry.w;
+	geometry.height = geometry.h;
+	if(params.width && params.height)
+	{
+		geometry.width = params.width.get();
+		geometry.height = params.height.get();
+	}
+	else if(params.width)
+	{
+		geometry.width = params.width.get();
+		geometry.height = keepAspect(geometry.h, geometry.w, geometry.width);
+	}
+	else if(params.height)
+	{
+		geometry.height = params.height.get();
+		geometry.width = keepAspect(geometry.w, geometry.h, geometry.height);
+	}
+
+	if(geometry.width > MAX_IMAGE_DIMENSION || geometry.height > MAX_IMAGE_DIMENSION)
+		return make_error_code(system::errc::invalid_argument);
+
+	color::Layout layout;
+	if(params.encoding && params.encoding.get() != frame.encoding && !color::sourceLayout(frame.encoding, layout))
+		return make_error_code(system::errc::not_supported);
+
+	if(params.format && params.format.get() == jpeg::FORMAT && !params.encoding && !jpeg::supports(frame.encoding))
+		return make_error_code(system::errc::not_supported);
+
+	if(params.format && params.format.get() == qoi::FORMAT && !params.encoding && !qoi::supports(frame.encoding))
+		return make_error_code(system::errc::not_supported);
+
+	bool identity = geometry.w == frame.width && geometry.h == frame.height &&
+		geometry.width == frame.width && geometry.height == frame.height;
+	if(identity)
+		return system::error_code();
+
+	std::uint32_t channels = 0, depth = 0;
+	if(!pixelLayout(frame.encoding, channels, depth))
+		return make_error_code(system::errc::not_supported);
+
+	bool scaled = geometry.width != geometry.w || geometry.height != geometry.h;
+	if(scaled && depth != 8)
+		return make_error_code(system::errc::not_supported);
+
+	return system::error_code();
+}
+
+bool isCompressed(cmd::ImageParams const &params)
+{
+	return params.format && params.format.get() != "raw";
+}
+
+bool isPassthrough(Frame const &frame, cmd::ImageParams const &params)
+{
+	if(frame.format.empty() || !params.format || params.format.get() != frame.format || params.quality || params.roi)
+		return false;
+
+	//a size or encoding the frame already has changes nothing
+	if(params.width && params.width.get() != frame.width)
+		return false;
+	if(params.height && params.height.get() != frame.height)
+		return false;
+	return !params.encoding || params.encoding.get() == frame.encoding;
+}
+
+FramePtr transformFrame(FramePtr const &frame, cmd::ImageParams const &params)
+{
+	if(!frame->format.empty())
+	{
+		FramePtr decoded = decompressFrame(frame);
+		if(!decoded)
+			return FramePtr();
+		return transformFrame(decoded, params);
+	}
+
+	if(params.empty())
+		return frame;
+
+	ImageGeometry geometry;
+	if(resolveImageParams(*frame, params, geometry))
+		return FramePtr();
+
+	bool cropped = geometry.w != frame->width || geometry.h != frame->height;
+	bool scaled = geometry.width != geometry.w || geometry.height != geometry.h;
+	bool converted = params.encoding && params.encoding.get() != frame->encoding;
+	if(!cropped && !scaled && !converted)
+		return frame;
+
+	std::uint32_t channels = 0, depth = 0;
+	pixelLayout(frame->encoding, channels, depth);
+	std::uint32_t pixelSize = channels * depth / 8;
+
+	//the kernels read the region straight from the ROS message buffer
+	resample::Pixels src;
+	src.data = frame->data + std::size_t(geometry.y) * frame->step + std::size_t(geometry.x) * pixelSize;
+	src.step = frame->step;
+	src.width = geometry.w;
+	src.height = geometry.h;
+	src.channels = pixelSize;
+
+	FramePipeline &pipeline = Server::instance().framePipeline();
+	FramePtr transformed = frame;
+	if(scaled)
+	{
+		FramePipeline::Timer timer(pipeline, FramePipeline::SCALE);
+		std::uint32_t step = geometry.width * pixelSize;
+		std::uint8_t *dst = nullptr;
+		transformed = makeFrame(*frame, geometry.width, geometry.height, step, frame->encoding, std::size_t(step) * geometry.height, dst);
+
+		//stripes are sized by the source rows read, a box shrink reads several per destination row
+		bool box = geometry.width * 2 <= geometry.w && geometry.height * 2 <= geometry.h;
+		std::size_t rowSize = std::max<std::size_t>(step, std::size_t(geometry.w) * pixelSize * geometry.h / geometry.height);
+		pipeline.forEachStripe(geometry.height, rowSize, 1, [&](std::uint32_t begin, std::uint32_t end) {
+			if(box)
+				resample::box(src, dst, step, geometry.width, geometry.height, begin, end);
+			else
+				resample::bilinear(src, dst, step, geometry.width, geometry.height, begin, end);
+		});
+
+		src.data = dst;
+		src.step = step;
+		src.width = geometry.width;
+		src.height = geometry.height;
+	}
+
+	if(converted)
+	{
+		//a region that is only cropped is converted without an intermediate copy
+		FramePipeline::Timer timer(pipeline, FramePipeline::CONVERT);
+		std::string const &encoding = params.encoding.get();
+		color::Layout from, to;
+		color::sourceLayout(frame->encoding, from);
+		bool planar = encoding == color::YUV420;
+		if(!planar)
+			color::sourceLayout(encoding, to);
+		std::uint32_t step = planar ? src.width : src.width * to.channels;
+		std::uint8_t *dst = nullptr;
+		FramePtr result = makeFrame(*frame, src.width, src.height, step, encoding, color::imageSize(encoding, src.width, src.height), dst);
+
+		//the chroma of yuv420 is subsampled from row pairs, its stripes start on even rows
+		pipeline.forEachStripe(src.height, std::size_t(src.width) * pixelSize, planar ? 2 : 1, [&](std::uint32_t begin, std::uint32_t end) {
+			if(planar)
+			{
+				color::yuv420(src, from, dst, begin, end);
+				return;
+			}
+
+			resample::Pixels rows = src;
+			rows.data += std::size_t(begin) * src.step;
+			rows.height = end - begin;
+			if(to.channels == 1)
+				color::mono(rows, from, dst + std::size_t(begin) * step, step);
+			else
+				color::interleaved(rows, from, to, dst + std::size_t(begin) * step, step);
+		});
+
+		return result;
+	}
+
+	if(!scaled)
+	{
+		std::uint32_t step = geometry.w * pixelSize;
+		std::uint8_t *dst = nullptr;
+		transformed = makeFrame(*frame, geometry.w, geometry.h, step, frame->encoding, std::size_t(step) * geometry.h, dst);
+		resample::copy(src, dst, step);
+	}
+
+	return transformed;
+}
+
+} //namespace srv
@@ -0,0 +1,36 @@
+#ifndef IMAGE_TRANSFORM_HPP
+#define IMAGE_TRANSFORM_HPP
+
+#include "Config.hpp"
+#include "Commands.hpp"
+#include "Frame.hpp"
+
+namespace srv {
+
+//region of the frame that is resampled to the output size
+struct ImageGeometry
+{
+	std::uint32_t x, y, w, h;
+	std::uint32_t width, height;
+};
+
+//largest width or height of a scaled image
+std::uint32_t const MAX_IMAGE_DIMENSION = 8192;
+
+//checks the params alone, a region still has to overlap the frame
+extern system::error_code validateImageParams(cmd::ImageParams const &params);
+//a region is clipped to the frame, a missing width or height keeps the aspect ratio
+extern system::error_code resolveImageParams(Frame const &frame, cmd::ImageParams const &params, ImageGeometry &geometry);
+
+//jpeg and qoi, anything but raw pixels
+extern bool isCompressed(cmd::ImageParams const &params);
+
+//a compressed frame the params ask for unchanged, its bytes are sent without decoding
+extern bool isPassthrough(Frame const &frame, cmd::ImageParams const &params);
+
+//the frame itself when the params do not change it, null if they cannot be applied, compressed frames are decoded
+extern FramePtr transformFrame(FramePtr const &frame, cmd::ImageParams const &params);
+
+} //namespace srv
+
+#endif //IMAGE_TRANSFORM_HPP
@@ -0,0 +1,228 @@
+#include "Jpeg.hpp"
+#include <sensor_msgs/image_encodings.h>
+#include <csetjmp>
+#include <cstdio>
+#include <jpeglib.h>
+
+namespace srv { namespace jpeg {
+
+char const FORMAT[] = "jpeg";
+
+namespace {
+
+	std::size_t const BLOCK_SIZE = 65536;
+
+	//libjpeg exits the process on errors unless the handler jumps out
+	struct ErrorManager
+	{
+		jpeg_error_mgr base;
+		std::jmp_buf jump;
+	};
+
+	void onError(j_common_ptr cinfo)
+	{
+		std::longjmp(reinterpret_cast<ErrorManager *>(cinfo->err)->jump, 1);
+	}
+
+	void onMessage(j_common_ptr)
+	{
+	}
+
+	//compressed bytes go straight to the vector, growing it a block at a time
+	struct Destination
+	{
+		jpeg_destination_mgr base;
+		std::vector<std::uint8_t> *jpeg;
+	};
+
+	void initDestination(j_compress_ptr cinfo)
+	{
+		Destination *dest = reinterpret_cast<Destination *>(cinfo->dest);
+		dest->jpeg->resize(std::max(dest->jpeg->capacity(), BLOCK_SIZE));
+		dest->base.next_output_byte = dest->jpeg->data();
+		dest->base.free_in_buffer = dest->jpeg->size();
+	}
+
+	boolean emptyDestination(j_compress_ptr cinfo)
+	{
+		Destination *dest = reinterpret_cast<Destination *>(cinfo->dest);
+		std::size_t used = dest->jpeg->size();
+		dest->jpeg->resize(used + BLOCK_SIZE);
+		dest->base.next_output_byte = dest->jpeg->data() + used;
+		dest->base.free_in_buffer = BLOCK_SIZE;
+		return TRUE;
+	}
+
+	void termDestination(j_compress_ptr cinfo)
+	{
+		Destination *dest = reinterpret_cast<Destination *>(cinfo->dest);
+		dest->jpeg->resize(dest->jpeg->size() - dest->base.free_in_buffer);
+	}
+
+	//the bgr and alpha layouts are libjpeg-turbo extensions, plain libjpeg only takes rgb and mono
+	bool colorSpace(std::string const &encoding, J_COLOR_SPACE &space, int &components)
+	{
+		namespace enc = sensor_msgs::image_encodings;
+		if(encoding == enc::MONO8)
+		{
+			space = JCS_GRAYSCALE;
+			components = 1;
+		}
+		else if(encoding == enc::RGB8)
+		{
+			space = JCS_RGB;
+			components = 3;
+		}
+#ifdef JCS_EXTENSIONS
+		else if(encoding == enc::BGR8)
+		{
+			space = JCS_EXT_BGR;
+			components = 3;
+		}
+#endif
+#ifdef JCS_ALPHA_EXTENSIONS
+		else if(encoding == enc::RGBA8)
+		{
+			space = JCS_EXT_RGBA;
+			components = 4;
+		}
+		else if(encoding == enc::BGRA8)
+		{
+			space = JCS_EXT_BGRA;
+			components = 4;
+		}
+#endif
+		else
+		{
+			return false;
+		}
+		return true;
+	}
+
+} //namespace anonymous
+
+bool supports(std::string const &encoding)
+{
+	J_COLOR_SPACE space;
+	int components;
+	return colorSpace(encoding, space, components);
+}
+
+system::error_code compress(Frame const &frame, int quality, std::vector<std::uint8_t> &jpeg)
+{
+	jpeg_compress_struct cinfo;
+	if(!colorSpace(frame.encoding, cinfo.in_color_space, cinfo.input_components))
+		return make_error_code(system::errc::not_supported);
+
+	J_COLOR_SPACE space = cinfo.in_color_space;
+	int components = cinfo.input_components;
+
+	ErrorManager errors;
+	cinfo.err = jpeg_std_error(&errors.base);
+	errors.base.error_exit = &onError;
+	errors.base.output_message = &onMessage;
+	if(setjmp(errors.jump))
+	{
+		jpeg_destroy_compress(&cinfo);
+		return make_error_code(system::errc::io_error);
+	}
+
+	jpeg_create_compress(&cinfo);
+
+	Destination dest;
+	dest.base.init_destination = &initDestination;
+	dest.base.empty_output_buffer = &emptyDestination;
+	dest.base.term_destination = &termDestination;
+	dest.jpeg = &jpeg;
+	jpeg.clear();
+	cinfo.dest = &dest.base;
+
+	cinfo.image_width = frame.width;
+	cinfo.image_height = frame.height;
+	cinfo.in_color_space = space;
+	cinfo.input_components = components;
+	jpeg_set_defaults(&cinfo);
+	jpeg_set_quality(&cinfo, quality, TRUE);
+	cinfo.dct_method = JDCT_IFAST;
+
+	jpeg_start_compress(&cinfo, TRUE);
+	while(cinfo.next_scanline < cinfo.image_height)
+	{
+		JSAMPROW row = const_cast<JSAMPROW>(frame.data + std::size_t(cinfo.next_scanline) * frame.step);
+		jpeg_write_scanlines(&cinfo, &row, 1);
+	}
+	jpeg_finish_compress(&cinfo);
+	jpeg_destroy_compress(&cinfo);
+
+	return system::error_code();
+}
+
+system::error_code readHeader(std::uint8_t const *data, std::size_t size, std::uint32_t &width, std::uint32_t &height, std::uint32_t &components)
+{
+	jpeg_decompress_struct cinfo;
+	ErrorManager errors;
+	cinfo.err = jpeg_std_error(&errors.base);
+	errors.base.error_exit = &onError;
+	errors.base.output_message = &onMessage;
+	if(setjmp(errors.jump))
+	{
+		jpeg_destroy_decompress(&cinfo);
+		return make_error_code(system::errc::invalid_argument);
+	}
+
+	jpeg_create_decompress(&cinfo);
+	jpeg_mem_src(&cinfo, const_cast<unsigned char *>(data), static_cast<unsigned long>(size));
+	jpeg_read_header(&cinfo, TRUE);
+	width = cinfo.image_width;
+	height = cinfo.image_height;
+	components = static_cast<std::uint32_t>(cinfo.num_components);
+	jpeg_destroy_decompress(&cinfo);
+
+	return system::error_code();
+}
+
+system::error_code decompress(Frame const &frame, std::uint8_t *pixels, std::size_t step)
+{
+	jpeg_decompress_struct cinfo;
+	J_COLOR_SPACE space;
+	int components;
+	if(!colorSpace(frame.encoding, space, components))
+		return make_error_code(system::errc::not_supported);
+
+	ErrorManager errors;
+	cinfo.err = jpeg_std_error(&errors.base);
+	errors.base.error_exit = &onError;
+	errors.base.output_message = &onMessage;
+	if(setjmp(errors.jump))
+	{
+		jpeg_destroy_decompress(&cinfo);
+		return make_error_code(system::errc::invalid_argument);
+	}
+
+	jpeg_create_decompress(&cinfo);
+	jpeg_mem_src(&cinfo, const_cast<unsigned char *>(frame.data), static_cast<unsigned long>(frame.size));
+	jpeg_read_header(&cinfo, TRUE);
+	cinfo.out_color_space = space;
+	cinfo.dct_method = JDCT_IFAST;
+	jpeg_start_decompress(&cinfo);
+
+	//the header was read when the frame was made, a different size is another image
+	if(cinfo.output_width != frame.width || cinfo.output_height != frame.height)
+	{
+		jpeg_destroy_decompress(&cinfo);
+		return make_error_code(system::errc::invalid_argument);
+	}
+
+	while(cinfo.output_scanline < cinfo.output_height)
+	{
+		JSAMPROW row = pixels + std::size_t(cinfo.output_scanline) * step;
+		jpeg_read_scanlines(&cinfo, &row, 1);
+	}
+
+	jpeg_finish_decompress(&cinfo);
+	jpeg_destroy_decompress(&cinfo);
+	return system::error_code();
+}
+
+} //namespace jpeg
+} //namespace srv
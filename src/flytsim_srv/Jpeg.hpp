@@ -0,0 +1,26 @@
+#ifndef JPEG_HPP
+#define JPEG_HPP
+
+#include "Config.hpp"
+#include "Frame.hpp"
+
+namespace srv { namespace jpeg {
+
+	extern char const FORMAT[];
+	int const DEFAULT_QUALITY = 80;
+
+	//mono8, rgb8, bgr8, rgba8 and bgra8, compressed with 4:2:0 chroma
+	extern bool supports(std::string const &encoding);
+
+	//jpeg is overwritten, its capacity is reused by the next call
+	extern system::error_code compress(Frame const &frame, int quality, std::vector<std::uint8_t> &jpeg);
+
+	//reads the markers only, components is 1 for grayscale
+	extern system::error_code readHeader(std::uint8_t const *data, std::size_t size, std::uint32_t &width, std::uint32_t &height, std::uint32_t &components);
+	//the jpeg of a compressed frame to its width and encoding, rows of step bytes
+	extern system::error_code decompress(Frame const &frame, std::uint8_t *pixels, std::size_t step);
+
+} //namespace jpeg
+} //namespace srv
+
+#endif //JPEG_HPP
@@ -0,0 +1,72 @@
+#include "MemoryBudget.hpp"
+
+namespace srv {
+
+MemoryBudget::MemoryBudget()
+	: m_Limit(0)
+	, m_Current(0)
+	, m_Peak(0)
+	, m_Rejected(0)
+{
+}
+
+std::size_t MemoryBudget::getLimit() const
+{
+	return m_Limit;
+}
+
+void MemoryBudget::setLimit(std::size_t limit)
+{
+	m_Limit = limit;
+}
+
+bool MemoryBudget::tryAcquire(std::size_t bytes)
+{
+	std::size_t limit = m_Limit;
+	std::size_t current = m_Current.load(boost::memory_order_relaxed);
+	do
+	{
+		if(limit && current + bytes > limit)
+		{
+			m_Rejected.fetch_add(1, boost::memory_order_relaxed);
+			return false;
+		}
+	}
+	while(!m_Current.compare_exchange_weak(current, current + bytes, boost::memory_order_relaxed));
+
+	updatePeak(current + bytes);
+	return true;
+}
+
+void MemoryBudget::acquire(std::size_t bytes)
+{
+	updatePeak(m_Current.fetch_add(bytes, boost::memory_order_relaxed) + bytes);
+}
+
+void MemoryBudget::release(std::size_t bytes)
+{
+	m_Current.fetch_sub(bytes, boost::memory_order_relaxed);
+}
+
+std::size_t MemoryBudget::current() const
+{
+	return m_Current.load(boost::memory_order_relaxed);
+}
+
+std::size_t MemoryBudget::peak() const
+{
+	return m_Peak.load(boost::memory_order_relaxed);
+}
+
+std::uint64_t MemoryBudget::rejected() const
+{
+	return m_Rejected.load(boost::memory_order_relaxed);
+}
+
+void MemoryBudget::updatePeak(std::size_t current)
+{
+	std::size_t peak = m_Peak.load(boost::memory_order_relaxed);
+	while(current > peak && !m_Peak.compare_exchange_weak(peak, current, boost::memory_order_relaxed));
+}
+
+} //namespace srv
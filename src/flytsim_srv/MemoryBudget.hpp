@@ -0,0 +1,39 @@
+#ifndef MEMORY_BUDGET_HPP
+#define MEMORY_BUDGET_HPP
+
+#include "Config.hpp"
+
+namespace srv {
+
+//process wide accounting of memory held for in-flight responses
+class MemoryBudget
+{
+public:
+	MemoryBudget();
+
+	std::size_t getLimit() const;
+	void setLimit(std::size_t limit);
+
+	//fails if the bytes do not fit under the limit, 0 limit means unlimited
+	bool tryAcquire(std::size_t bytes);
+	//charges bytes that are already held, may exceed the limit
+	void acquire(std::size_t bytes);
+	void release(std::size_t bytes);
+
+	std::size_t current() const;
+	std::size_t peak() const;
+	std::uint64_t rejected() const;
+
+private:
+	void updatePeak(std::size_t current);
+
+private:
+	atomic<std::size_t> m_Limit;
+	atomic<std::size_t> m_Current;
+	atomic<std::size_t> m_Peak;
+	atomic<std::uint64_t> m_Rejected;
+};
+
+} //namespace srv
+
+#endif //MEMORY_BUDGET_HPP
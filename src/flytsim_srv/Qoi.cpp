@@ -0,0 +1,282 @@
+#include "Qoi.hpp"
+#include "ColorConvert.hpp"
+#include <cstring>
+
+namespace srv { namespace qoi {
+
+char const FORMAT[] = "qoi";
+
+namespace {
+
+	std::uint8_t const OP_INDEX = 0x00;
+	std::uint8_t const OP_DIFF = 0x40;
+	std::uint8_t const OP_LUMA = 0x80;
+	std::uint8_t const OP_RUN = 0xc0;
+	std::uint8_t const OP_RGB = 0xfe;
+	std::uint8_t const OP_RGBA = 0xff;
+	std::uint8_t const MASK = 0xc0;
+
+	std::size_t const HEADER_SIZE = 14;
+	std::uint8_t const PADDING[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+	//larger images are rejected by the decoder, as by the reference one
+	std::uint64_t const MAX_PIXELS = 400000000;
+
+	//r, g, b and a packed from the low byte up
+	typedef std::uint32_t Pixel;
+
+	inline Pixel pack(std::uint32_t r, std::uint32_t g, std::uint32_t b, std::uint32_t a)
+	{
+		return r | (g << 8) | (b << 16) | (a << 24);
+	}
+
+	inline std::uint32_t channel(Pixel px, int c)
+	{
+		return (px >> (8 * c)) & 0xff;
+	}
+
+	inline std::uint32_t hash(Pixel px)
+	{
+		return (channel(px, 0) * 3 + channel(px, 1) * 5 + channel(px, 2) * 7 + channel(px, 3) * 11) % 64;
+	}
+
+	template <std::uint32_t Channels>
+	inline Pixel load(std::uint8_t const *p)
+	{
+		if(Channels == 1)
+			return pack(p[0], p[0], p[0], 255);
+		if(Channels == 3)
+			return pack(p[0], p[1], p[2], 255);
+		return pack(p[0], p[1], p[2], p[3]);
+	}
+
+	inline std::uint8_t *write32(std::uint8_t *out, std::uint32_t v)
+	{
+		out[0] = static_cast<std::uint8_t>(v >> 24);
+		out[1] = static_cast<std::uint8_t>(v >> 16);
+		out[2] = static_cast<std::uint8_t>(v >> 8);
+		out[3] = static_cast<std::uint8_t>(v);
+		return out + 4;
+	}
+
+	inline std::uint32_t read32(std::uint8_t const *in)
+	{
+		return (std::uint32_t(in[0]) << 24) | (std::uint32_t(in[1]) << 16) | (std::uint32_t(in[2]) << 8) | in[3];
+	}
+
+	//the output is sized for the worst case up front, the loop never checks for space
+	template <std::uint32_t Channels>
+	std::uint8_t *encodePixels(resample::Pixels const &src, std::uint8_t *out)
+	{
+		Pixel index[64] = {};
+		Pixel prev = pack(0, 0, 0, 255);
+		std::uint32_t run = 0;
+
+		for(std::uint32_t y = 0; y < src.height; ++y)
+		{
+			std::uint8_t const *in = src.data + y * src.step;
+			for(std::uint32_t x = 0; x < src.width; ++x, in += Channels)
+			{
+				Pixel px = load<Channels>(in);
+				if(px == prev)
+				{
+					if(++run == 62)
+					{
+						*out++ = OP_RUN | (run - 1);
+						run = 0;
+					}
+					continue;
+				}
+
+				if(run)
+				{
+					*out++ = OP_RUN | (run - 1);
+					run = 0;
+				}
+
+				std::uint32_t h = hash(px);
+				if(index[h] == px)
+				{
+					*out++ = OP_INDEX | h;
+				}
+				else
+				{
+					index[h] = px;
+					if(channel(px, 3) == channel(prev, 3))
+					{
+						std::int8_t vr = static_cast<std::int8_t>(channel(px, 0) - channel(prev, 0));
+						std::int8_t vg = static_cast<std::int8_t>(channel(px, 1) - channel(prev, 1));
+						std::int8_t vb = static_cast<std::int8_t>(channel(px, 2) - channel(prev, 2));
+						std::int8_t vgr = static_cast<std::int8_t>(vr - vg);
+						std::int8_t vgb = static_cast<std::int8_t>(vb - vg);
+
+						if(vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2)
+						{
+							*out++ = OP_DIFF | ((vr + 2) << 4) | ((vg + 2) << 2) | (vb + 2);
+						}
+						else if(vgr > -9 && vgr < 8 && vg > -33 && vg < 32 && vgb > -9 && vgb < 8)
+						{
+							*out++ = OP_LUMA | (vg + 32);
+							*out++ = static_cast<std::uint8_t>(((vgr + 8) << 4) | (vgb + 8));
+						}
+						else
+						{
+							*out++ = OP_RGB;
+							*out++ = static_cast<std::uint8_t>(channel(px, 0));
+							*out++ = static_cast<std::uint8_t>(channel(px, 1));
+							*out++ = static_cast<std::uint8_t>(channel(px, 2));
+						}
+					}
+					else
+					{
+						*out++ = OP_RGBA;
+						*out++ = static_cast<std::uint8_t>(channel(px, 0));
+						*out++ = static_cast<std::uint8_t>(channel(px, 1));
+						*out++ = static_cast<std::uint8_t>(channel(px, 2));
+						*out++ = static_cast<std::uint8_t>(channel(px, 3));
+					}
+				}
+				prev = px;
+			}
+		}
+
+		if(run)
+			*out++ = OP_RUN | (run - 1);
+		return out;
+	}
+
+	template <std::uint32_t Channels>
+	inline void store(std::uint8_t *p, Pixel px)
+	{
+		p[0] = static_cast<std::uint8_t>(channel(px, 0));
+		if(Channels == 1)
+			return;
+		p[1] = static_cast<std::uint8_t>(channel(px, 1));
+		p[2] = static_cast<std::uint8_t>(channel(px, 2));
+		if(Channels == 4)
+			p[3] = static_cast<std::uint8_t>(channel(px, 3));
+	}
+
+	//the stream ends with 8 bytes of padding, an op never reads past them
+	template <std::uint32_t Channels>
+	bool decodePixels(std::uint8_t const *in, std::uint8_t const *end, std::uint8_t *out, std::size_t count)
+	{
+		Pixel index[64] = {};
+		Pixel px = pack(0, 0, 0, 255);
+		std::uint32_t run = 0;
+
+		for(std::size_t i = 0; i < count; ++i, out += Channels)
+		{
+			if(run)
+			{
+				--run;
+			}
+			else if(in < end)
+			{
+				std::uint8_t op = *in++;
+				if(op == OP_RGB)
+				{
+					px = pack(in[0], in[1], in[2], channel(px, 3));
+					in += 3;
+				}
+				else if(op == OP_RGBA)
+				{
+					px = pack(in[0], in[1], in[2], in[3]);
+					in += 4;
+				}
+				else if((op & MASK) == OP_INDEX)
+				{
+					px = index[op];
+				}
+				else if((op & MASK) == OP_DIFF)
+				{
+					px = pack(
+						(channel(px, 0) + ((op >> 4) & 0x03) - 2) & 0xff,
+						(channel(px, 1) + ((op >> 2) & 0x03) - 2) & 0xff,
+						(channel(px, 2) + (op & 0x03) - 2) & 0xff,
+						channel(px, 3)
+					);
+				}
+				else if((op & MASK) == OP_LUMA)
+				{
+					std::uint8_t next = *in++;
+					std::int32_t vg = static_cast<std::int32_t>(op & 0x3f) - 32;
+					px = pack(
+						(channel(px, 0) + vg - 8 + ((next >> 4) & 0x0f)) & 0xff,
+						(channel(px, 1) + vg) & 0xff,
+						(channel(px, 2) + vg - 8 + (next & 0x0f)) & 0xff,
+						channel(px, 3)
+					);
+				}
+				else
+				{
+					run = op & 0x3f;
+				}
+				index[hash(px)] = px;
+			}
+			else
+			{
+				return false;
+			}
+			store<Channels>(out, px);
+		}
+		return true;
+	}
+
+} //namespace anonymous
+
+bool supports(std::string const &encoding)
+{
+	color::Layout layout;
+	return color::sourceLayout(encoding, layout);
+}
+
+void encode(resample::Pixels const &src, std::vector<std::uint8_t> &qoi)
+{
+	std::uint32_t streamChannels = src.channels == 4 ? 4 : 3;
+	qoi.resize(HEADER_SIZE + std::size_t(src.width) * src.height * (streamChannels + 1) + sizeof(PADDING));
+
+	std::uint8_t *out = qoi.data();
+	std::memcpy(out, "qoif", 4);
+	out = write32(out + 4, src.width);
+	out = write32(out, src.height);
+	*out++ = static_cast<std::uint8_t>(streamChannels);
+	*out++ = 0;
+
+	if(src.channels == 1)
+		out = encodePixels<1>(src, out);
+	else if(src.channels == 3)
+		out = encodePixels<3>(src, out);
+	else
+		out = encodePixels<4>(src, out);
+
+	std::memcpy(out, PADDING, sizeof(PADDING));
+	qoi.resize(out + sizeof(PADDING) - qoi.data());
+}
+
+bool decode(std::uint8_t const *data, std::size_t size, std::uint32_t channels, std::vector<std::uint8_t> &pixels, std::uint32_t &width, std::uint32_t &height)
+{
+	if(size < HEADER_SIZE + sizeof(PADDING) || std::memcmp(data, "qoif", 4))
+		return false;
+
+	width = read32(data + 4);
+	height = read32(data + 8);
+	if(!width || !height || std::uint64_t(width) * height > MAX_PIXELS)
+		return false;
+
+	std::size_t count = std::size_t(width) * height;
+	pixels.resize(count * channels);
+
+	std::uint8_t const *in = data + HEADER_SIZE;
+	std::uint8_t const *end = data + size - sizeof(PADDING);
+	if(channels == 1)
+		return decodePixels<1>(in, end, pixels.data(), count);
+	if(channels == 3)
+		return decodePixels<3>(in, end, pixels.data(), count);
+	if(channels == 4)
+		return decodePixels<4>(in, end, pixels.data(), count);
+	return false;
+}
+
+} //namespace qoi
+} //namespace srv
@@ -0,0 +1,24 @@
+#ifndef QOI_HPP
+#define QOI_HPP
+
+#include "Config.hpp"
+#include "Resample.hpp"
+
+namespace srv { namespace qoi {
+
+	//lossless "Quite OK Image" stream, mono8 is sent as gray rgb and decoded back to one channel
+	extern char const FORMAT[];
+
+	//mono8, rgb8, bgr8, rgba8 and bgra8, the channel order is kept as is
+	extern bool supports(std::string const &encoding);
+
+	//src has 1, 3 or 4 channels, qoi is overwritten
+	extern void encode(resample::Pixels const &src, std::vector<std::uint8_t> &qoi);
+
+	//pixels get channels bytes per pixel, false for a malformed stream
+	extern bool decode(std::uint8_t const *data, std::size_t size, std::uint32_t channels, std::vector<std::uint8_t> &pixels, std::uint32_t &width, std::uint32_t &height);
+
+} //namespace qoi
+} //namespace srv
+
+#endif //QOI_HPP
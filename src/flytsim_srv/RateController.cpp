@@ -0,0 +1,114 @@
+#include "RateController.hpp"
+#include <algorithm>
+
+namespace srv {
+
+namespace {
+
+	//weight of the newest sample in the smoothed estimates
+	double const SMOOTHING = 0.25;
+
+	//a write this long was held back by the link, it measures the link rate
+	std::chrono::milliseconds const SATURATED_WRITE(2);
+
+	//stepping down reacts quickly, stepping up waits for the link to stay calm
+	std::chrono::milliseconds const DOWN_HOLD(500);
+	std::chrono::milliseconds const UP_HOLD(3000);
+
+	double milliseconds(RateController::Clock::duration d)
+	{
+		return std::chrono::duration<double, std::milli>(d).count();
+	}
+
+} //namespace anonymous
+
+RateController::Level const RateController::LADDER[RateController::LEVELS] =
+{
+	{ 1.0f,  0,  0.0f },
+	{ 1.0f,  90, 0.0f },
+	{ 1.0f,  75, 0.0f },
+	{ 0.5f,  75, 0.0f },
+	{ 0.5f,  50, 15.0f },
+	{ 0.25f, 50, 10.0f },
+	{ 0.25f, 30, 5.0f }
+};
+
+std::size_t const RateController::LEVELS;
+std::uint32_t const RateController::DEFAULT_TARGET_MS;
+
+RateController::RateController()
+	: m_TargetMs(DEFAULT_TARGET_MS)
+	, m_Level(0)
+	, m_Goodput(0.0)
+	, m_Delay(0.0)
+	, m_LastChange()
+	, m_CalmSince()
+{
+}
+
+void RateController::reset(std::uint32_t targetMs)
+{
+	m_TargetMs = targetMs;
+	m_Level = 0;
+	m_Goodput = 0.0;
+	m_Delay = 0.0;
+	m_LastChange = Clock::now();
+	m_CalmSince = m_LastChange;
+}
+
+bool RateController::onPushWritten(std::size_t bytes, Clock::duration elapsed, std::size_t unsent, Clock::time_point now)
+{
+	if(elapsed >= SATURATED_WRITE)
+	{
+		double rate = bytes / std::chrono::duration<double>(elapsed).count();
+		m_Goodput = m_Goodput > 0.0 ? m_Goodput + SMOOTHING * (rate - m_Goodput) : rate;
+	}
+
+	//bytes the kernel still holds leave at the link rate, a command written now waits for them too
+	double queued = m_Goodput > 0.0 ? unsent * 1000.0 / m_Goodput : 0.0;
+	double sample = milliseconds(elapsed) + queued;
+	m_Delay += SMOOTHING * (sample - m_Delay);
+
+	if(m_Delay > m_TargetMs)
+	{
+		m_CalmSince = now;
+		if(now - m_LastChange >= DOWN_HOLD && m_Level + 1 < LEVELS)
+			return change(m_Level + 1, now);
+		return false;
+	}
+
+	if(m_Delay > m_TargetMs / 3.0)
+	{
+		m_CalmSince = now;
+		return false;
+	}
+
+	if(now - m_CalmSince >= UP_HOLD && now - m_LastChange >= UP_HOLD && m_Level > 0)
+		return change(m_Level - 1, now);
+	return false;
+}
+
+std::size_t RateController::level() const
+{
+	return m_Level;
+}
+
+double RateController::goodput() const
+{
+	return m_Goodput;
+}
+
+double RateController::delay() const
+{
+	return m_Delay;
+}
+
+bool RateController::change(std::size_t level, Clock::time_point now)
+{
+	m_Level = level;
+	m_LastChange = now;
+	m_CalmSince = now;
+	return true;
+}
+
+} //namespace srv
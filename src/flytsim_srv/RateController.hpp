@@ -0,0 +1,54 @@
+#ifndef RATE_CONTROLLER_HPP
+#define RATE_CONTROLLER_HPP
+
+#include "Config.hpp"
+
+namespace srv {
+
+//operating point of an adaptive image subscription, chosen from how long its pushes take to leave
+class RateController
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	//scale of the subscribed size, jpeg quality with 0 for the subscribed format, 0 fps for no limit
+	struct Level
+	{
+		float scale;
+		std::uint32_t quality;
+		float maxFps;
+	};
+
+	static std::size_t const LEVELS = 7;
+	static Level const LADDER[LEVELS];
+
+	static std::uint32_t const DEFAULT_TARGET_MS = 50;
+
+	RateController();
+
+	//starts again from the best level
+	void reset(std::uint32_t targetMs);
+
+	//a write holding pushed frames took elapsed, unsent is what the socket still queues after it,
+	//true when the level changed
+	bool onPushWritten(std::size_t bytes, Clock::duration elapsed, std::size_t unsent, Clock::time_point now);
+
+	std::size_t level() const;
+	double goodput() const;		//bytes per second while the link was the bottleneck, 0 until it was
+	double delay() const;		//milliseconds a command queued behind the pushes waits
+
+private:
+	bool change(std::size_t level, Clock::time_point now);
+
+private:
+	std::uint32_t m_TargetMs;
+	std::size_t m_Level;
+	double m_Goodput;
+	double m_Delay;
+	Clock::time_point m_LastChange;
+	Clock::time_point m_CalmSince;		//delay well under the target without a break
+};
+
+} //namespace srv
+
+#endif //RATE_CONTROLLER_HPP
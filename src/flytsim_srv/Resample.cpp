@@ -0,0 +1,161 @@
+#include "Resample.hpp"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace srv { namespace resample {
+
+namespace {
+
+	//bilinear weights are fixed point with 8 fractional bits
+	std::int32_t const ONE = 256;
+
+	void addRow(std::uint32_t *sums, std::uint8_t const *row, std::size_t size)
+	{
+		std::size_t i = 0;
+#if defined(__SSE2__)
+		__m128i const zero = _mm_setzero_si128();
+		for(; i + 16 <= size; i += 16)
+		{
+			__m128i bytes = _mm_loadu_si128(reinterpret_cast<__m128i const *>(row + i));
+			__m128i lo = _mm_unpacklo_epi8(bytes, zero);
+			__m128i hi = _mm_unpackhi_epi8(bytes, zero);
+
+			__m128i *s = reinterpret_cast<__m128i *>(sums + i);
+			_mm_storeu_si128(s + 0, _mm_add_epi32(_mm_loadu_si128(s + 0), _mm_unpacklo_epi16(lo, zero)));
+			_mm_storeu_si128(s + 1, _mm_add_epi32(_mm_loadu_si128(s + 1), _mm_unpackhi_epi16(lo, zero)));
+			_mm_storeu_si128(s + 2, _mm_add_epi32(_mm_loadu_si128(s + 2), _mm_unpacklo_epi16(hi, zero)));
+			_mm_storeu_si128(s + 3, _mm_add_epi32(_mm_loadu_si128(s + 3), _mm_unpackhi_epi16(hi, zero)));
+		}
+#endif
+		for(; i < size; ++i)
+			sums[i] += row[i];
+	}
+
+	void blendRows(std::uint8_t *dst, std::uint8_t const *row0, std::uint8_t const *row1, std::int32_t weight, std::size_t size)
+	{
+		std::size_t i = 0;
+#if defined(__SSE2__)
+		__m128i const zero = _mm_setzero_si128();
+		__m128i const w0 = _mm_set1_epi16(static_cast<short>(ONE - weight));
+		__m128i const w1 = _mm_set1_epi16(static_cast<short>(weight));
+		__m128i const half = _mm_set1_epi16(ONE / 2);
+		for(; i + 16 <= size; i += 16)
+		{
+			__m128i a = _mm_loadu_si128(reinterpret_cast<__m128i const *>(row0 + i));
+			__m128i b = _mm_loadu_si128(reinterpret_cast<__m128i const *>(row1 + i));
+
+			//255 * 256 + 128 still fits unsigned 16 bits
+			__m128i lo = _mm_add_epi16(
+				_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), w0),
+				_mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), w1)
+			);
+			__m128i hi = _mm_add_epi16(
+				_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), w0),
+				_mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), w1)
+			);
+			lo = _mm_srli_epi16(_mm_add_epi16(lo, half), 8);
+			hi = _mm_srli_epi16(_mm_add_epi16(hi, half), 8);
+
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(lo, hi));
+		}
+#endif
+		for(; i < size; ++i)
+			dst[i] = static_cast<std::uint8_t>((row0[i] * (ONE - weight) + row1[i] * weight + ONE / 2) >> 8);
+	}
+
+	//pixel centers are aligned, the position is clamped to the source edges
+	std::int64_t sourcePosition(std::uint32_t dst, std::uint32_t srcSize, std::uint32_t dstSize)
+	{
+		std::int64_t pos = (std::int64_t(2 * dst + 1) * srcSize * ONE) / (2 * std::int64_t(dstSize)) - ONE / 2;
+		return std::min<std::int64_t>(std::max<std::int64_t>(pos, 0), std::int64_t(srcSize - 1) * ONE);
+	}
+
+} //namespace anonymous
+
+void copy(Pixels const &src, std::uint8_t *dst, std::size_t dstStep)
+{
+	std::size_t rowSize = std::size_t(src.width) * src.channels;
+	for(std::uint32_t y = 0; y < src.height; ++y)
+		std::memcpy(dst + y * dstStep, src.data + y * src.step, rowSize);
+}
+
+void box(Pixels const &src, std::uint8_t *dst, std::size_t dstStep, std::uint32_t dstWidth, std::uint32_t dstHeight, std::uint32_t rowBegin, std::uint32_t rowEnd)
+{
+	std::uint32_t const channels = src.channels;
+	std::size_t rowSize = std::size_t(src.width) * channels;
+
+	std::vector<std::uint32_t> columns(dstWidth + 1);
+	for(std::uint32_t x = 0; x <= dstWidth; ++x)
+		columns[x] = static_cast<std::uint32_t>(std::uint64_t(x) * src.width / dstWidth);
+
+	std::vector<std::uint32_t> sums(rowSize);
+	for(std::uint32_t y = rowBegin; y < rowEnd; ++y)
+	{
+		std::uint32_t y0 = static_cast<std::uint32_t>(std::uint64_t(y) * src.height / dstHeight);
+		std::uint32_t y1 = std::max(static_cast<std::uint32_t>(std::uint64_t(y + 1) * src.height / dstHeight), y0 + 1);
+
+		//vertical sums of the covered rows, then horizontal sums of the covered columns
+		std::fill(sums.begin(), sums.end(), 0);
+		for(std::uint32_t sy = y0; sy < y1; ++sy)
+			addRow(sums.data(), src.data + sy * src.step, rowSize);
+
+		std::uint8_t *out = dst + y * dstStep;
+		for(std::uint32_t x = 0; x < dstWidth; ++x)
+		{
+			std::uint32_t x0 = columns[x];
+			std::uint32_t x1 = std::max(columns[x + 1], x0 + 1);
+			std::uint32_t count = (x1 - x0) * (y1 - y0);
+
+			for(std::uint32_t c = 0; c < channels; ++c)
+			{
+				std::uint32_t sum = 0;
+				for(std::uint32_t sx = x0; sx < x1; ++sx)
+					sum += sums[sx * channels + c];
+				*out++ = static_cast<std::uint8_t>((sum + count / 2) / count);
+			}
+		}
+	}
+}
+
+void bilinear(Pixels const &src, std::uint8_t *dst, std::size_t dstStep, std::uint32_t dstWidth, std::uint32_t dstHeight, std::uint32_t rowBegin, std::uint32_t rowEnd)
+{
+	std::uint32_t const channels = src.channels;
+	std::size_t rowSize = std::size_t(src.width) * channels;
+
+	std::vector<std::uint32_t> columns(dstWidth);
+	std::vector<std::int32_t> weights(dstWidth);
+	for(std::uint32_t x = 0; x < dstWidth; ++x)
+	{
+		std::int64_t pos = sourcePosition(x, src.width, dstWidth);
+		columns[x] = static_cast<std::uint32_t>(pos / ONE);
+		weights[x] = static_cast<std::int32_t>(pos % ONE);
+	}
+
+	std::vector<std::uint8_t> row(rowSize);
+	for(std::uint32_t y = rowBegin; y < rowEnd; ++y)
+	{
+		//rows are blended vertically first, the horizontal pass then reads a single row
+		std::int64_t pos = sourcePosition(y, src.height, dstHeight);
+		std::uint32_t y0 = static_cast<std::uint32_t>(pos / ONE);
+		std::uint32_t y1 = std::min(y0 + 1, src.height - 1);
+		blendRows(row.data(), src.data + y0 * src.step, src.data + y1 * src.step, static_cast<std::int32_t>(pos % ONE), rowSize);
+
+		std::uint8_t *out = dst + y * dstStep;
+		for(std::uint32_t x = 0; x < dstWidth; ++x)
+		{
+			std::uint8_t const *p0 = row.data() + columns[x] * channels;
+			std::uint8_t const *p1 = row.data() + std::min(columns[x] + 1, src.width - 1) * channels;
+			std::int32_t weight = weights[x];
+
+			for(std::uint32_t c = 0; c < channels; ++c)
+				*out++ = static_cast<std::uint8_t>((p0[c] * (ONE - weight) + p1[c] * weight + ONE / 2) >> 8);
+		}
+	}
+}
+
+} //namespace resample
+} //namespace srv
@@ -0,0 +1,31 @@
+#ifndef RESAMPLE_HPP
+#define RESAMPLE_HPP
+
+#include "Config.hpp"
+
+namespace srv { namespace resample {
+
+	//interleaved 8 bit channels, rows are step bytes apart
+	struct Pixels
+	{
+		std::uint8_t const *data;
+		std::size_t step;
+		std::uint32_t width;
+		std::uint32_t height;
+		std::uint32_t channels;
+	};
+
+	extern void copy(Pixels const &src, std::uint8_t *dst, std::size_t dstStep);
+
+	//the scalers write destination rows rowBegin to rowEnd only, stripes of one image may run in parallel
+
+	//averages every source pixel covered by the destination one, meant for shrinking 2x and more
+	extern void box(Pixels const &src, std::uint8_t *dst, std::size_t dstStep, std::uint32_t dstWidth, std::uint32_t dstHeight, std::uint32_t rowBegin, std::uint32_t rowEnd);
+
+	//interpolates the 4 nearest source pixels, meant for mild shrinking and enlarging
+	extern void bilinear(Pixels const &src, std::uint8_t *dst, std::size_t dstStep, std::uint32_t dstWidth, std::uint32_t dstHeight, std::uint32_t rowBegin, std::uint32_t rowEnd);
+
+} //namespace resample
+} //namespace srv
+
+#endif //RESAMPLE_HPP
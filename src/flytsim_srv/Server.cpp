@@ -1,22 +1,127 @@
 #include "Server.hpp"
 #include "Connection.hpp"
+#include "Shard.hpp"
+#include <thread>
+#include <algorithm>
 
 namespace srv {
 
+namespace {
+
+	//new frames are encoded on arrival while get_image was called this recently
+	std::chrono::seconds const EAGER_ENCODE_WINDOW(2);
+	std::chrono::seconds const CAMERA_IDLE_CHECK_INTERVAL(1);
+
+} //namespace anonymous
+
+LatencyProfile::LatencyProfile()
+	: lowLatency(false)
+	, busyPollUSec(0)
+	, ioCpus()
+	, rosCpus()
+	, workerCpus()
+{
+}
+
+std::ostream& operator<<(std::ostream &os, LatencyProfile const &profile)
+{
+	return os <<
+		"low-latency:" << (profile.lowLatency ? "on" : "off") <<
+		" busy-poll:" << profile.busyPollUSec << "us" <<
+		" io-cpus:" << formatCpuSet(profile.ioCpus) <<
+		" ros-cpus:" << formatCpuSet(profile.rosCpus) <<
+		" worker-cpus:" << formatCpuSet(profile.workerCpus);
+}
+
+ConnectionProfile::ConnectionProfile()
+	: engine(STACKFUL)
+	, stackSize(0)
+{
+}
+
+std::ostream& operator<<(std::ostream &os, ConnectionProfile const &profile)
+{
+	os << "engine:" << (profile.engine == ConnectionProfile::STACKLESS ? "stackless" : "stackful");
+	if(profile.engine == ConnectionProfile::STACKFUL)
+		os << " stack-size:" << (profile.stackSize ? std::to_string(profile.stackSize) : std::string("default"));
+	return os;
+}
+
+SpinnerProfile::SpinnerProfile()
+	: globalThreads(1)
+	, imageThreads(1)
+	, telemetryThreads(1)
+{
+}
+
+std::ostream& operator<<(std::ostream &os, SpinnerProfile const &profile)
+{
+	return os <<
+		"global:" << profile.globalThreads <<
+		" image:" << profile.imageThreads <<
+		" telemetry:" << profile.telemetryThreads;
+}
+
+RecordingProfile::RecordingProfile()
+	: recordPath()
+	, playPath()
+	, playRate(1.0)
+	, playLoop(false)
+{
+}
+
+std::ostream& operator<<(std::ostream &os, RecordingProfile const &profile)
+{
+	os << "record:" << (profile.recordPath.empty() ? std::string("off") : profile.recordPath);
+	os << " play:" << (profile.playPath.empty() ? std::string("off") : profile.playPath);
+	if(!profile.playPath.empty())
+		os << " play-rate:" << profile.playRate << " play-loop:" << (profile.playLoop ? "on" : "off");
+	return os;
+}
+
+std::uint32_t const Server::DEFAULT_CAMERA_QUEUE;
+std::uint32_t const Server::DEFAULT_CAMERA_IDLE_SECONDS;
+std::size_t const Server::SYNC_HISTORY_FRAMES;
+
 Server::Server()
-	: m_IOS()
-	, m_Work(m_IOS)
+	: m_Shards()
 	, m_ListenEndpoint(asio::ip::tcp::v4(), DEFAULT_LISTEN_PORT)
-	, m_Acceptor(m_IOS)
-	, m_AcceptSocket(m_IOS)
 	, m_bRunning(false)
+	, m_LatencyProfile()
+	, m_ConnectionProfile()
+	, m_SpinnerProfile()
+	, m_RecordingProfile()
+	, m_MemoryBudget()
+	, m_WorkersCount(DEFAULT_WORKERS_COUNT)
+	, m_Workers()
+	, m_Pipeline(m_Workers)
 	, m_ROSMasterUri(DEFAULT_ROS_MASTER_URI)
 	, m_ROSHandle()
 	, m_ROSSpinner()
+	, m_ROSImageQueue()
+	, m_ROSImageHandle()
+	, m_ROSImageSpinner()
+	, m_ROSTelemetryQueue()
+	, m_ROSTelemetryHandle()
+	, m_ROSTelemetrySpinner()
 	, m_ROSImageTransport()
-	, m_ROSImageTransortSubscriber()
-	, m_ROSImage()
+	, m_Cameras()
+	, m_CameraMutex()
+	, m_CameraIdleTimer()
+	, m_HistoryFrames(0)
+	, m_HistorySeconds(0.0)
+	, m_Recorder()
+	, m_Player()
+	, m_FrameWaitersMutex()
+	, m_FrameWaiters()
+	, m_ImagesWaiters()
+	, m_LastImageRequest(0)
+	, m_ImageBroadcaster()
+	, m_TelemetryNamespace(DEFAULT_TELEMETRY_NAMESPACE)
+	, m_TelemetryBroadcaster()
 {
+	setShardsCount(DEFAULT_SHARDS_COUNT);
+	setCameraProfiles(std::vector<CameraProfile>(1));
 }
 
 Server::~Server()
@@ -57,14 +162,298 @@ system::error_code Server::setROSMasterUri(std::string uri)
 	return system::error_code();
 }
 
+std::string Server::getTelemetryNamespace() const
+{
+	return m_TelemetryNamespace;
+}
+
+system::error_code Server::setTelemetryNamespace(std::string ns)
+{
+	if(m_bRunning)
+		return make_error_code(system::errc::already_connected);
+
+	m_TelemetryNamespace = ns;
+	return system::error_code();
+}
+
+LatencyProfile const& Server::getLatencyProfile() const
+{
+	return m_LatencyProfile;
+}
+
+system::error_code Server::setLatencyProfile(LatencyProfile const &profile)
+{
+	if(m_bRunning)
+		return make_error_code(system::errc::already_connected);
+
+	m_LatencyProfile = profile;
+	return system::error_code();
+}
+
+ConnectionProfile const& Server::getConnectionProfile() const
+{
+	return m_ConnectionProfile;
+}
+
+system::error_code Server::setConnectionProfile(ConnectionProfile const &profile)
+{
+	if(m_bRunning)
+		return make_error_code(system::errc::already_connected);
+
+	if(profile.stackSize && profile.stackSize < boost::coroutines::stack_traits::minimum_size())
+		return make_error_code(system::errc::invalid_argument);
+
+	m_ConnectionProfile = profile;
+	return system::error_code();
+}
+
+SpinnerProfile const& Server::getSpinnerProfile() const
+{
+	return m_SpinnerProfile;
+}
+
+system::error_code Server::setSpinnerProfile(SpinnerProfile const &profile)
+{
+	if(m_bRunning)
+		return make_error_code(system::errc::already_connected);
+
+	m_SpinnerProfile = profile;
+	return system::error_code();
+}
+
+RecordingProfile const& Server::getRecordingProfile() const
+{
+	return m_RecordingProfile;
+}
+
+system::error_code Server::setRecordingProfile(RecordingProfile const &profile)
+{
+	if(m_bRunning)
+		return make_error_code(system::errc::already_connected);
+
+	//played frames are recorded already
+	if(!profile.recordPath.empty() && !profile.playPath.empty())
+		return make_error_code(system::errc::invalid_argument);
+
+	if(!(profile.playRate > 0.0))
+		return make_error_code(system::errc::invalid_argument);
+
+	m_RecordingProfile = profile;
+	return system::error_code();
+}
+
+system::error_code Server::setCameraProfiles(std::vector<CameraProfile> const &profiles)
+{
+	if(m_bRunning)
+		return make_error_code(system::errc::already_connected);
+
+	if(profiles.empty())
+		return make_error_code(system::errc::invalid_argument);
+
+	for(CameraProfile const &profile : profiles)
+	{
+		if(profile.topic.empty() || !profile.queue)
+			return make_error_code(system::errc::invalid_argument);
+		if(profile.transport != Camera::RAW_TRANSPORT && profile.transport != Camera::COMPRESSED_TRANSPORT)
+			return make_error_code(system::errc::invalid_argument);
+	}
+
+	m_Cameras.clear();
+	for(std::size_t c = 0; c < profiles.size(); ++c)
+	{
+		m_Cameras.emplace_back(
+			new Camera(
+				c,
+				profiles[c],
+				std::bind(
+					&Server::onROSImageReceived,
+					this,
+					std::placeholders::_1,
+					std::placeholders::_2
+				)
+			)
+		);
+	}
+
+	//every camera is created first, the history size depends on their count
+	for(std::unique_ptr<Camera> &camera : m_Cameras)
+		configureFrameHistory(*camera);
+	return system::error_code();
+}
+
+std::size_t Server::getCamerasCount() const
+{
+	return m_Cameras.size();
+}
+
+Camera& Server::camera(std::size_t index)
+{
+	return *m_Cameras[index];
+}
+
+std::size_t Server::getShardsCount() const
+{
+	return m_Shards.size();
+}
+
+system::error_code Server::setShardsCount(std::size_t count)
+{
+	if(m_bRunning)
+		return make_error_code(system::errc::already_connected);
+
+	if(!count)
+		return make_error_code(system::errc::invalid_argument);
+
+	m_Shards.clear();
+	for(std::size_t s = 0; s < count; ++s)
+		m_Shards.emplace_back(new Shard(s));
+
+	return system::error_code();
+}
+
+std::size_t Server::getWorkersCount() const
+{
+	return m_WorkersCount;
+}
+
+system::error_code Server::setWorkersCount(std::size_t count)
+{
+	if(m_bRunning)
+		return make_error_code(system::errc::already_connected);
+
+	m_WorkersCount = count;
+	return system::error_code();
+}
+
+MemoryBudget& Server::memoryBudget()
+{
+	return m_MemoryBudget;
+}
+
+WorkerPool& Server::workerPool()
+{
+	return m_Workers;
+}
+
+FramePipeline& Server::framePipeline()
+{
+	return m_Pipeline;
+}
+
 std::shared_ptr<ros::NodeHandle> Server::getROSHandle() const
 {
 	return m_ROSHandle;
 }
 
-sensor_msgs::ImageConstPtr Server::getROSImage() const
+std::shared_ptr<ros::NodeHandle> Server::getROSTelemetryHandle() const
+{
+	return m_ROSTelemetryHandle;
+}
+
+FramePtr Server::getFrame() const
 {
-	return m_ROSImage;
+	return m_Cameras.front()->getFrame();
+}
+
+system::error_code Server::setFrameHistory(std::size_t frames, double seconds)
+{
+	if(m_bRunning)
+		return make_error_code(system::errc::already_connected);
+
+	//an age limit alone would keep nothing, the ring is sized by frames
+	if(seconds < 0.0 || (seconds > 0.0 && !frames))
+		return make_error_code(system::errc::invalid_argument);
+
+	m_HistoryFrames = frames;
+	m_HistorySeconds = seconds;
+	for(std::unique_ptr<Camera> &camera : m_Cameras)
+		configureFrameHistory(*camera);
+	return system::error_code();
+}
+
+system::error_code Server::configureFrameHistory(Camera &camera)
+{
+	//stamps of several cameras are matched from their recent frames
+	std::size_t frames = m_HistoryFrames;
+	if(m_Cameras.size() > 1)
+		frames = std::max(frames, SYNC_HISTORY_FRAMES);
+	return camera.frameHistory().configure(frames, m_HistorySeconds);
+}
+
+FrameHistory const& Server::frameHistory() const
+{
+	return m_Cameras.front()->frameHistory();
+}
+
+void Server::waitFrame(std::shared_ptr<Connection> const &conn)
+{
+	demandCamera();
+	std::lock_guard<std::mutex> lock(m_FrameWaitersMutex);
+	m_FrameWaiters.push_back(conn);
+}
+
+void Server::waitImages(std::shared_ptr<Connection> const &conn)
+{
+	std::lock_guard<std::mutex> lock(m_FrameWaitersMutex);
+	m_ImagesWaiters.push_back(conn);
+}
+
+void Server::demandCamera(std::size_t index)
+{
+	//the idle check holds the mutex while it reads the demand and unsubscribes, so it either sees this demand or runs before it
+	Camera &camera = *m_Cameras[index];
+	std::lock_guard<std::mutex> lock(m_CameraMutex);
+	camera.demand();
+	if(!camera.isSubscribed() && m_ROSImageTransport)
+		subscribeCamera(camera);
+}
+
+std::size_t Server::subscribedCameras() const
+{
+	std::size_t subscribed = 0;
+	for(std::unique_ptr<Camera> const &camera : m_Cameras)
+	{
+		if(camera->isSubscribed())
+			++subscribed;
+	}
+	return subscribed;
+}
+
+EncodedImagePtr Server::getEncodedImage(FramePtr const &frame, cmd::ImageParams const &params)
+{
+	m_LastImageRequest = std::chrono::steady_clock::now().time_since_epoch().count();
+	return m_Cameras.front()->encodedImageCache().get(frame, params);
+}
+
+EncodedImagePtr Server::getEncodedImage(FramePtr const &frame, cmd::ImageParams const &params, EncodedImageCache::EncodedHandler const &handler, bool &pending)
+{
+	m_LastImageRequest = std::chrono::steady_clock::now().time_since_epoch().count();
+	return m_Cameras.front()->encodedImageCache().get(frame, params, handler, pending);
+}
+
+EncodedImageCache const& Server::encodedImageCache() const
+{
+	return m_Cameras.front()->encodedImageCache();
+}
+
+ImageBroadcaster& Server::imageBroadcaster()
+{
+	return m_ImageBroadcaster;
+}
+
+TelemetryBroadcaster& Server::telemetryBroadcaster()
+{
+	return m_TelemetryBroadcaster;
+}
+
+FrameRecorder const& Server::frameRecorder() const
+{
+	return m_Recorder;
+}
+
+FramePlayer const& Server::framePlayer() const
+{
+	return m_Player;
 }
 
 system::error_code Server::run()
@@ -77,25 +466,68 @@ system::error_code Server::run()
 
 	m_bRunning = true;
 
-	if(system::error_code re = startROS())
+	SERVER_LOG(info) << "latency profile: " << m_LatencyProfile << " shards:" << m_Shards.size() << " workers:" << m_WorkersCount;
+	SERVER_LOG(info) << "connection profile: " << m_ConnectionProfile;
+	SERVER_LOG(info) << "spinner profile: " << m_SpinnerProfile;
+	for(std::unique_ptr<Camera> const &camera : m_Cameras)
+		SERVER_LOG(info) << "camera " << camera->index() << " profile: " << camera->profile();
+	SERVER_LOG(info) << "memory budget: " << (m_MemoryBudget.getLimit() ? std::to_string(m_MemoryBudget.getLimit()) + " bytes" : std::string("unlimited"));
+	SERVER_LOG(info) << "frame history: " << frameHistory().capacity() << " frames" <<
+		(m_HistorySeconds > 0.0 ? ", " + std::to_string(m_HistorySeconds) + " seconds" : std::string());
+	SERVER_LOG(info) << "recording profile: " << m_RecordingProfile;
+
+	if(system::error_code oe = openRecording())
+	{
+		SERVER_LOG(error) << "failed to open recording: " << oe.message();
+		m_bRunning = false;
+		return oe;
+	}
+
+	m_Workers.start(m_WorkersCount, m_LatencyProfile.workerCpus);
+
+	//ROS spawns its poll and spinner threads while starting, they inherit the affinity of this thread
+	CpuSet defaultCpus;
+	getThreadAffinity(defaultCpus);
+	if(system::error_code ae = setThreadAffinity(m_LatencyProfile.rosCpus))
+		SERVER_LOG(warning) << "failed to set ROS threads affinity: " << ae;
+
+	system::error_code re = startROS();
+
+	setThreadAffinity(defaultCpus);
+
+	if(re)
 	{
 		SERVER_LOG(error) << "failed to start ROS!";
+		closeRecording();
+		m_Workers.stop();
 		m_bRunning = false;
 		return re;
 	}
 
-	if(system::error_code ae = startAcceptor())
+	if(system::error_code ae = startAcceptors())
 	{
 		SERVER_LOG(error) << "failed to start network!";
 		stopROS();
+		closeRecording();
+		m_Workers.stop();
 		m_bRunning = false;
 		return ae;
 	}
 
-	m_IOS.run();
+	//the first shard runs on the calling thread
+	std::vector<std::thread> shardThreads;
+	for(std::size_t s = 1; s < m_Shards.size(); ++s)
+		shardThreads.emplace_back(&Server::runShard, this, s, defaultCpus);
+
+	runShard(0, defaultCpus);
+
+	for(std::thread &shardThread : shardThreads)
+		shardThread.join();
 
-	stopAcceptor();
+	stopAcceptors();
 	stopROS();
+	closeRecording();
+	m_Workers.stop();
 	m_bRunning = false;
 
 	return system::error_code();
@@ -103,72 +535,53 @@ system::error_code Server::run()
 
 void Server::stop()
 {
-	m_IOS.stop();
+	for(std::unique_ptr<Shard> &shard : m_Shards)
+		shard->stop();
+}
+
+bool Server::isRunning() const
+{
+	return m_bRunning;
 }
 
 asio::io_service& Server::ios()
 {
-	return m_IOS;
+	return m_Shards.front()->ios();
 }
 
-system::error_code Server::startAcceptor()
+void Server::runShard(std::size_t index, CpuSet const &defaultCpus)
 {
-	SERVER_LOG(debug) << "starting to listen on: " << m_ListenEndpoint;
-	system::error_code err;
-	m_Acceptor.open(m_ListenEndpoint.protocol(), err);
-	if(err)
-	{
-		SERVER_LOG(error) << "failed to open listening socket: " << err;
-		return err;
-	}
+	CpuSet cpus = m_LatencyProfile.ioCpus;
 
-	m_Acceptor.set_option(asio::ip::tcp::socket::reuse_address(true));
-	m_Acceptor.bind(m_ListenEndpoint, err);
-	if(err)
-	{
-		SERVER_LOG(error) << "failed to bind listening socket: " << err;
-		m_Acceptor.close();
-		return err;
-	}
+	//with several shards each one gets its own cpu from the io set
+	if(m_Shards.size() > 1 && cpus.size() > 1)
+		cpus = CpuSet(1, cpus[index % cpus.size()]);
 
-	m_Acceptor.listen(asio::socket_base::max_connections, err);
-	if(err)
-	{
-		SERVER_LOG(error) << "failed to listen on listening socket: " << err;
-		m_Acceptor.close();
-		return err;
-	}
-	doAccept();
-	return system::error_code();
-}
+	if(system::error_code ae = setThreadAffinity(cpus.empty() ? defaultCpus : cpus))
+		SERVER_LOG(warning) << "failed to set io thread affinity of shard " << index << ": " << ae;
 
-void Server::stopAcceptor()
-{
-	m_Acceptor.close();
+	m_Shards[index]->run(m_LatencyProfile);
 }
 
-void Server::doAccept()
+system::error_code Server::startAcceptors()
 {
-	m_Acceptor.async_accept(
-		m_AcceptSocket,
-		[this](system::error_code e)
+	bool reusePort = m_Shards.size() > 1;
+	for(std::size_t s = 0; s < m_Shards.size(); ++s)
+	{
+		if(system::error_code ae = m_Shards[s]->startAcceptor(m_ListenEndpoint, reusePort))
 		{
-
-			if(!m_bRunning)
-				return;
-			if(e)
-			{
-				SERVER_LOG(warning) << "failed to accept connection: " << e;
-			}
-			else
-			{
-				SERVER_LOG(debug) << "remote peer connected: " << m_AcceptSocket.remote_endpoint().address();
-				std::shared_ptr<Connection> conn = std::make_shared<Connection>(std::move(m_AcceptSocket));
-				conn->startProcessingCommands();
-			}
-			doAccept();
+			for(std::size_t p = 0; p < s; ++p)
+				m_Shards[p]->stopAcceptor();
+			return ae;
 		}
-	);
+	}
+	return system::error_code();
+}
+
+void Server::stopAcceptors()
+{
+	for(std::unique_ptr<Shard> &shard : m_Shards)
+		shard->stopAcceptor();
 }
 
 system::error_code Server::startROS()
@@ -203,40 +616,233 @@ system::error_code Server::startROS()
 	}
 
 	m_ROSHandle = std::make_shared<ros::NodeHandle>();
-	m_ROSSpinner = std::make_shared<ros::AsyncSpinner>(0);
+	m_ROSSpinner = std::make_shared<ros::AsyncSpinner>(m_SpinnerProfile.globalThreads);
 	m_ROSSpinner->start();
 
-	m_ROSImageTransport = std::make_shared<image_transport::ImageTransport>(*m_ROSHandle);
-	m_ROSImageTransortSubscriber = std::make_shared<image_transport::Subscriber>(
-		m_ROSImageTransport->subscribe(
-			"/flytsim/iris/camera/camera_1/image_raw",
-			1,
+	m_ROSTelemetryHandle = std::make_shared<ros::NodeHandle>();
+	m_ROSTelemetryHandle->setCallbackQueue(&m_ROSTelemetryQueue);
+	m_ROSTelemetrySpinner = std::make_shared<ros::AsyncSpinner>(m_SpinnerProfile.telemetryThreads, &m_ROSTelemetryQueue);
+	m_ROSTelemetrySpinner->start();
+	m_TelemetryBroadcaster.start(m_ROSTelemetryHandle, m_TelemetryNamespace);
+
+	//the player takes the place of the camera topics, nothing subscribes them
+	if(m_Player.isOpen())
+	{
+		m_Player.start(
+			m_RecordingProfile.playRate,
+			m_RecordingProfile.playLoop,
 			std::bind(
-				&Server::onROSImageReceived,
-	            this,
-	            std::placeholders::_1
+				&Server::onPlaybackFrame,
+				this,
+				std::placeholders::_1,
+				std::placeholders::_2
 			)
-		)
-	);
-	m_ROSImage.reset();
-	system::error_code();
+		);
+		return system::error_code();
+	}
+
+	//the transport subscribes on the queue of the handle it is made from
+	m_ROSImageHandle = std::make_shared<ros::NodeHandle>();
+	m_ROSImageHandle->setCallbackQueue(&m_ROSImageQueue);
+	m_ROSImageSpinner = std::make_shared<ros::AsyncSpinner>(m_SpinnerProfile.imageThreads, &m_ROSImageQueue);
+	m_ROSImageSpinner->start();
+	m_ROSImageTransport = std::make_shared<image_transport::ImageTransport>(*m_ROSImageHandle);
+
+	//cameras without an idle timeout are subscribed for the whole run
+	std::lock_guard<std::mutex> lock(m_CameraMutex);
+	bool idleCheck = false;
+	for(std::unique_ptr<Camera> &camera : m_Cameras)
+	{
+		if(camera->profile().idleSeconds)
+			idleCheck = true;
+		else
+			subscribeCamera(*camera);
+	}
+	if(idleCheck)
+		startCameraIdleCheck();
+	return system::error_code();
 }
 
 void Server::stopROS()
 {
-	m_ROSImageTransortSubscriber->shutdown();
-	m_ROSImageTransortSubscriber.reset();
+	m_Player.stop();
+	{
+		std::lock_guard<std::mutex> lock(m_CameraMutex);
+		m_CameraIdleTimer.reset();
+		for(std::unique_ptr<Camera> &camera : m_Cameras)
+		{
+			if(camera->isSubscribed())
+				camera->unsubscribe();
+		}
+	}
 	m_ROSImageTransport.reset();
-	m_ROSImage.reset();
+	if(m_ROSImageSpinner)
+	{
+		m_ROSImageSpinner->stop();
+		m_ROSImageSpinner.reset();
+	}
+	m_ROSImageHandle.reset();
+	//pending callbacks hold frames
+	m_ROSImageQueue.clear();
+	m_TelemetryBroadcaster.stop();
+	m_ROSTelemetrySpinner->stop();
+	m_ROSTelemetrySpinner.reset();
+	m_ROSTelemetryHandle.reset();
+	m_ROSTelemetryQueue.clear();
 	m_ROSSpinner->stop();
 	m_ROSSpinner.reset();
 	m_ROSHandle.reset();
 }
 
-void Server::onROSImageReceived(sensor_msgs::ImageConstPtr const &img)
+void Server::subscribeCamera(Camera &camera)
+{
+	camera.subscribe(*m_ROSImageHandle, *m_ROSImageTransport);
+}
+
+void Server::startCameraIdleCheck()
+{
+	if(!m_CameraIdleTimer)
+		m_CameraIdleTimer.reset(new asio::steady_timer(ios()));
+
+	m_CameraIdleTimer->expires_from_now(CAMERA_IDLE_CHECK_INTERVAL);
+	m_CameraIdleTimer->async_wait(
+		std::bind(
+			&Server::onCameraIdleCheck,
+			this,
+			std::placeholders::_1
+		)
+	);
+}
+
+void Server::onCameraIdleCheck(system::error_code const &e)
+{
+	if(e == asio::error::operation_aborted)
+		return;
+
+	std::lock_guard<std::mutex> lock(m_CameraMutex);
+	if(!m_CameraIdleTimer)
+		return;
+
+	//long-polls and subscriptions are served by camera 0 only
+	bool waiting = false;
+	{
+		std::lock_guard<std::mutex> waitersLock(m_FrameWaitersMutex);
+		waiting = !m_FrameWaiters.empty();
+	}
+	waiting = waiting || m_ImageBroadcaster.hasSubscribers();
+
+	for(std::unique_ptr<Camera> &camera : m_Cameras)
+	{
+		std::uint32_t idleSeconds = camera->profile().idleSeconds;
+		if(!idleSeconds || !camera->isSubscribed() || (camera->index() == 0 && waiting))
+			continue;
+		if(camera->sinceDemand() > std::chrono::seconds(idleSeconds))
+			camera->unsubscribe();
+	}
+
+	startCameraIdleCheck();
+}
+
+system::error_code Server::openRecording()
+{
+	if(!m_RecordingProfile.recordPath.empty())
+		return m_Recorder.open(m_RecordingProfile.recordPath);
+	if(!m_RecordingProfile.playPath.empty())
+		return m_Player.open(m_RecordingProfile.playPath);
+	return system::error_code();
+}
+
+void Server::closeRecording()
 {
-	SERVER_LOG(trace) << "ROS image received!";
-	m_ROSImage = img;
+	if(m_Recorder.isOpen())
+	{
+		SERVER_LOG(info) << "recorded " << m_Recorder.frames() << " frames, " << m_Recorder.bytes() << " bytes";
+		m_Recorder.close();
+	}
+}
+
+void Server::onROSImageReceived(Camera &camera, FramePtr const &frame)
+{
+	if(m_Recorder.isOpen())
+	{
+		if(system::error_code re = m_Recorder.append(camera.index(), *frame))
+		{
+			SERVER_LOG(error) << "recording stopped: " << re.message();
+			closeRecording();
+		}
+	}
+
+	notifyImagesWaiters();
+
+	//the other cameras are only read by get_images
+	if(camera.index() != 0)
+		return;
+
+	notifyFrameWaiters();
+
+	//encode ahead only while someone is watching, get_image then finds the frame ready
+	std::chrono::steady_clock::duration sinceRequest = std::chrono::steady_clock::now().time_since_epoch() -
+		std::chrono::steady_clock::duration(m_LastImageRequest.load());
+	bool requested = sinceRequest <= EAGER_ENCODE_WINDOW;
+	if(!requested && !m_ImageBroadcaster.hasSubscribers())
+		return;
+
+	if(m_Workers.size())
+		m_Workers.post(std::bind(&Server::encodeImage, this, frame, requested));
+	else
+		encodeImage(frame, requested);
+}
+
+void Server::onPlaybackFrame(std::size_t camera, std::shared_ptr<Frame> const &frame)
+{
+	//a recording of more cameras than configured plays the ones there are
+	if(camera < m_Cameras.size())
+		m_Cameras[camera]->play(frame);
+}
+
+void Server::encodeImage(FramePtr const &frame, bool requested)
+{
+	//subscribers get the params they asked for, get_image finds the full frame ready
+	//a compressed frame is passed through as it is, decoding it ahead would cost more than the pass
+	EncodedImageCache &cache = m_Cameras.front()->encodedImageCache();
+	if(requested && frame->format.empty())
+		cache.get(frame);
+	m_ImageBroadcaster.broadcast(frame, cache);
+}
+
+void Server::notifyFrameWaiters()
+{
+	//the image threads may store frames at once, the waiters are taken into a local
+	std::vector< std::weak_ptr<Connection> > waiters;
+	{
+		std::lock_guard<std::mutex> lock(m_FrameWaitersMutex);
+		if(m_FrameWaiters.empty())
+			return;
+		waiters.swap(m_FrameWaiters);
+	}
+
+	for(std::weak_ptr<Connection> const &waiter : waiters)
+	{
+		if(std::shared_ptr<Connection> conn = waiter.lock())
+			conn->notifyFrame();
+	}
+}
+
+void Server::notifyImagesWaiters()
+{
+	std::vector< std::weak_ptr<Connection> > waiters;
+	{
+		std::lock_guard<std::mutex> lock(m_FrameWaitersMutex);
+		if(m_ImagesWaiters.empty())
+			return;
+		waiters.swap(m_ImagesWaiters);
+	}
+
+	for(std::weak_ptr<Connection> const &waiter : waiters)
+	{
+		if(std::shared_ptr<Connection> conn = waiter.lock())
+			conn->notifyImages();
+	}
 }
 
 } //namespace srv
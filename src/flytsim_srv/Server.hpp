@@ -2,12 +2,78 @@
 #define SERVER_HPP
 
 #include "Config.hpp"
+#include "Affinity.hpp"
+#include "MemoryBudget.hpp"
+#include "ImageBroadcaster.hpp"
+#include "TelemetryBroadcaster.hpp"
+#include "EncodedImage.hpp"
+#include "Frame.hpp"
+#include "FrameHistory.hpp"
+#include "WorkerPool.hpp"
+#include "FramePipeline.hpp"
+#include "Camera.hpp"
+#include "FrameRecording.hpp"
 
 #define SERVER_LOG(level) BOOST_LOG_TRIVIAL(level) << "[SERVER] "
 
 namespace srv {
 
 class Connection;
+class Shard;
+
+struct LatencyProfile
+{
+	LatencyProfile();
+
+	bool lowLatency;				//busy-poll the io thread and disable Nagle on accepted sockets
+	std::uint32_t busyPollUSec;		//SO_BUSY_POLL on accepted sockets, 0 disables it
+	CpuSet ioCpus;
+	CpuSet rosCpus;
+	CpuSet workerCpus;
+};
+
+extern std::ostream& operator<<(std::ostream &os, LatencyProfile const &profile);
+
+struct ConnectionProfile
+{
+	enum Engine
+	{
+		STACKFUL,	//asio::spawn coroutine per connection
+		STACKLESS	//completion handlers, buffers allocated only while a request is in flight
+	};
+
+	ConnectionProfile();
+
+	Engine engine;
+	std::size_t stackSize;		//coroutine stack of the stackful engine, 0 uses the boost default
+};
+
+extern std::ostream& operator<<(std::ostream &os, ConnectionProfile const &profile);
+
+//threads spinning each ROS callback queue, 0 spins one per core
+struct SpinnerProfile
+{
+	SpinnerProfile();
+
+	std::uint32_t globalThreads;		//services and anything without a queue of its own
+	std::uint32_t imageThreads;			//camera frames, a flood of them never delays the other queues
+	std::uint32_t telemetryThreads;
+};
+
+extern std::ostream& operator<<(std::ostream &os, SpinnerProfile const &profile);
+
+//camera traffic is recorded to a file, or played from one in place of the topics
+struct RecordingProfile
+{
+	RecordingProfile();
+
+	std::string recordPath;		//empty records nothing
+	std::string playPath;		//empty subscribes the camera topics
+	double playRate;			//times the recorded pace
+	bool playLoop;
+};
+
+extern std::ostream& operator<<(std::ostream &os, RecordingProfile const &profile);
 
 class Server
 {
@@ -18,7 +84,16 @@ public:
 	virtual ~Server();
 
 	static std::uint16_t const DEFAULT_LISTEN_PORT = 12321;
+	static std::size_t const DEFAULT_SHARDS_COUNT = 1;
+	static std::size_t const DEFAULT_WORKERS_COUNT = 1;
 	static constexpr char const * DEFAULT_ROS_MASTER_URI = "http://localhost:11311";
+	static constexpr char const * DEFAULT_CAMERA_TOPIC = "/flytsim/iris/camera/camera_1/image_raw";
+	static constexpr char const * DEFAULT_CAMERA_TRANSPORT = "raw";
+	static std::uint32_t const DEFAULT_CAMERA_QUEUE = 1;
+	static std::uint32_t const DEFAULT_CAMERA_IDLE_SECONDS = 30;
+	static constexpr char const * DEFAULT_TELEMETRY_NAMESPACE = "/flytsim";
+	//with several cameras each keeps at least this many frames to match stamps from
+	static std::size_t const SYNC_HISTORY_FRAMES = 8;
 
 	static Server& instance();
 
@@ -28,38 +103,136 @@ public:
 	std::string getROSMasterUri() const;
 	system::error_code setROSMasterUri(std::string uri);
 
+	//the FlytOS namespace the telemetry topics are published under
+	std::string getTelemetryNamespace() const;
+	system::error_code setTelemetryNamespace(std::string ns);
+
+	LatencyProfile const& getLatencyProfile() const;
+	system::error_code setLatencyProfile(LatencyProfile const &profile);
+
+	ConnectionProfile const& getConnectionProfile() const;
+	system::error_code setConnectionProfile(ConnectionProfile const &profile);
+
+	SpinnerProfile const& getSpinnerProfile() const;
+	system::error_code setSpinnerProfile(SpinnerProfile const &profile);
+
+	RecordingProfile const& getRecordingProfile() const;
+	system::error_code setRecordingProfile(RecordingProfile const &profile);
+
+	//camera 0 serves get_image and the image subscriptions, get_images reads any of them
+	system::error_code setCameraProfiles(std::vector<CameraProfile> const &profiles);
+	std::size_t getCamerasCount() const;
+	Camera& camera(std::size_t index);
+
+	std::size_t getShardsCount() const;
+	system::error_code setShardsCount(std::size_t count);
+
+	//workers encode frames as they arrive, 0 encodes them on the ROS thread
+	std::size_t getWorkersCount() const;
+	system::error_code setWorkersCount(std::size_t count);
+
+	MemoryBudget& memoryBudget();
+	WorkerPool& workerPool();
+	//stripes the per frame stages over the workers and keeps their latencies
+	FramePipeline& framePipeline();
+
 	std::shared_ptr<ros::NodeHandle> getROSHandle() const;
-	sensor_msgs::ImageConstPtr getROSImage() const;
+	//subscriptions made with it are spun by the telemetry threads only
+	std::shared_ptr<ros::NodeHandle> getROSTelemetryHandle() const;
+	FramePtr getFrame() const;
+
+	//the last frames frames no older than seconds are kept for get_image seq: and stamp:, by every camera
+	system::error_code setFrameHistory(std::size_t frames, double seconds);
+	FrameHistory const& frameHistory() const;
+
+	//the connection is notified once with the next frame
+	void waitFrame(std::shared_ptr<Connection> const &conn);
+	//and by get_images once with the next frame of any camera
+	void waitImages(std::shared_ptr<Connection> const &conn);
+
+	//image consumers call it, subscribes the camera unless it already is
+	void demandCamera(std::size_t index = 0);
+	std::size_t subscribedCameras() const;
+
+	//cached encoding of the frame, recent calls make new frames encoded on arrival
+	EncodedImagePtr getEncodedImage(FramePtr const &frame, cmd::ImageParams const &params = cmd::ImageParams());
+	//pending instead of waiting for another thread encoding the same, handler completes it
+	EncodedImagePtr getEncodedImage(FramePtr const &frame, cmd::ImageParams const &params, EncodedImageCache::EncodedHandler const &handler, bool &pending);
+	EncodedImageCache const& encodedImageCache() const;
+
+	//subscribed connections get new frames pushed as they arrive
+	ImageBroadcaster& imageBroadcaster();
+	//and telemetry updates, decimated to their rate
+	TelemetryBroadcaster& telemetryBroadcaster();
+
+	FrameRecorder const& frameRecorder() const;
+	FramePlayer const& framePlayer() const;
 
 
 	system::error_code run();
 	void stop();
+	bool isRunning() const;
 
 	asio::io_service& ios();
 
 protected:
-	system::error_code startAcceptor();
-	void stopAcceptor();
-	void doAccept();
+	system::error_code startAcceptors();
+	void stopAcceptors();
+	void runShard(std::size_t index, CpuSet const &defaultCpus);
 
 	system::error_code startROS();
 	void stopROS();
-	void onROSImageReceived(sensor_msgs::ImageConstPtr const &img);
+	system::error_code openRecording();
+	void closeRecording();
+	void onROSImageReceived(Camera &camera, FramePtr const &frame);
+	void onPlaybackFrame(std::size_t camera, std::shared_ptr<Frame> const &frame);
+	void subscribeCamera(Camera &camera);
+	system::error_code configureFrameHistory(Camera &camera);
+	void startCameraIdleCheck();
+	void onCameraIdleCheck(system::error_code const &e);
+	void encodeImage(FramePtr const &frame, bool requested);
+	void notifyFrameWaiters();
+	void notifyImagesWaiters();
 
 private:
-	asio::io_service m_IOS;
-	asio::io_service::work m_Work;
+	std::vector< std::unique_ptr<Shard> > m_Shards;
 	asio::ip::tcp::endpoint m_ListenEndpoint;
-	asio::ip::tcp::acceptor m_Acceptor;
-	asio::ip::tcp::socket m_AcceptSocket;
 	atomic<bool> m_bRunning;
+	LatencyProfile m_LatencyProfile;
+	ConnectionProfile m_ConnectionProfile;
+	SpinnerProfile m_SpinnerProfile;
+	RecordingProfile m_RecordingProfile;
+	MemoryBudget m_MemoryBudget;
+	std::size_t m_WorkersCount;
+	WorkerPool m_Workers;
+	FramePipeline m_Pipeline;
 
 	std::string m_ROSMasterUri;
 	std::shared_ptr<ros::NodeHandle> m_ROSHandle;
 	std::shared_ptr<ros::AsyncSpinner> m_ROSSpinner;
+	ros::CallbackQueue m_ROSImageQueue;
+	std::shared_ptr<ros::NodeHandle> m_ROSImageHandle;
+	std::shared_ptr<ros::AsyncSpinner> m_ROSImageSpinner;
+	ros::CallbackQueue m_ROSTelemetryQueue;
+	std::shared_ptr<ros::NodeHandle> m_ROSTelemetryHandle;
+	std::shared_ptr<ros::AsyncSpinner> m_ROSTelemetrySpinner;
 	std::shared_ptr<image_transport::ImageTransport> m_ROSImageTransport;
-	std::shared_ptr<image_transport::Subscriber> m_ROSImageTransortSubscriber;
-	sensor_msgs::ImageConstPtr m_ROSImage;
+	std::vector< std::unique_ptr<Camera> > m_Cameras;
+	std::mutex m_CameraMutex;
+	std::unique_ptr<asio::steady_timer> m_CameraIdleTimer;
+	std::size_t m_HistoryFrames;
+	double m_HistorySeconds;
+	FrameRecorder m_Recorder;
+	FramePlayer m_Player;
+
+	std::mutex m_FrameWaitersMutex;
+	std::vector< std::weak_ptr<Connection> > m_FrameWaiters;
+	std::vector< std::weak_ptr<Connection> > m_ImagesWaiters;
+
+	atomic<std::chrono::steady_clock::rep> m_LastImageRequest;
+	ImageBroadcaster m_ImageBroadcaster;
+	std::string m_TelemetryNamespace;
+	TelemetryBroadcaster m_TelemetryBroadcaster;
 };
 
 } //namespace srv
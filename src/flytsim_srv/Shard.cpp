@@ -0,0 +1,158 @@
+#include "Shard.hpp"
+#include "Server.hpp"
+#include "Connection.hpp"
+
+namespace srv {
+
+#if defined(SO_BUSY_POLL)
+typedef asio::detail::socket_option::integer<SOL_SOCKET, SO_BUSY_POLL> busy_poll;
+#endif
+
+#if defined(SO_REUSEPORT)
+typedef asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT> reuse_port;
+#endif
+
+Shard::Shard(std::size_t index)
+	: m_Index(index)
+	, m_IOS()
+	, m_Work(m_IOS)
+	, m_Acceptor(m_IOS)
+	, m_AcceptSocket(m_IOS)
+{
+}
+
+Shard::~Shard()
+{
+}
+
+std::size_t Shard::index() const
+{
+	return m_Index;
+}
+
+asio::io_service& Shard::ios()
+{
+	return m_IOS;
+}
+
+system::error_code Shard::startAcceptor(asio::ip::tcp::endpoint const &endpoint, bool reusePort)
+{
+	SHARD_LOG(debug) << "shard " << m_Index << " starting to listen on: " << endpoint;
+	system::error_code err;
+	m_Acceptor.open(endpoint.protocol(), err);
+	if(err)
+	{
+		SHARD_LOG(error) << "failed to open listening socket: " << err;
+		return err;
+	}
+
+	m_Acceptor.set_option(asio::ip::tcp::socket::reuse_address(true));
+
+	if(reusePort)
+	{
+#if defined(SO_REUSEPORT)
+		//every shard binds the same port, the kernel balances incoming connections between them
+		m_Acceptor.set_option(reuse_port(true), err);
+#else
+		err = make_error_code(system::errc::operation_not_supported);
+#endif
+		if(err)
+		{
+			SHARD_LOG(error) << "failed to set SO_REUSEPORT on listening socket: " << err;
+			m_Acceptor.close();
+			return err;
+		}
+	}
+
+	m_Acceptor.bind(endpoint, err);
+	if(err)
+	{
+		SHARD_LOG(error) << "failed to bind listening socket: " << err;
+		m_Acceptor.close();
+		return err;
+	}
+
+	m_Acceptor.listen(asio::socket_base::max_connections, err);
+	if(err)
+	{
+		SHARD_LOG(error) << "failed to listen on listening socket: " << err;
+		m_Acceptor.close();
+		return err;
+	}
+	doAccept();
+	return system::error_code();
+}
+
+void Shard::stopAcceptor()
+{
+	system::error_code err;
+	m_Acceptor.close(err);
+}
+
+void Shard::run(LatencyProfile const &profile)
+{
+	if(!profile.lowLatency)
+	{
+		m_IOS.run();
+		return;
+	}
+
+	//never sleep in epoll, trades a fully loaded core for wake-up latency
+	while(!m_IOS.stopped())
+		m_IOS.poll_one();
+}
+
+void Shard::stop()
+{
+	m_IOS.stop();
+}
+
+void Shard::doAccept()
+{
+	m_Acceptor.async_accept(
+		m_AcceptSocket,
+		[this](system::error_code e)
+		{
+			if(!Server::instance().isRunning())
+				return;
+			if(e)
+			{
+				SHARD_LOG(warning) << "failed to accept connection: " << e;
+			}
+			else
+			{
+				SHARD_LOG(debug) << "remote peer connected to shard " << m_Index << ": " << m_AcceptSocket.remote_endpoint().address();
+				setupAcceptedSocket(m_AcceptSocket);
+				std::shared_ptr<Connection> conn = std::make_shared<Connection>(m_IOS, std::move(m_AcceptSocket));
+				conn->startProcessingCommands();
+			}
+			doAccept();
+		}
+	);
+}
+
+void Shard::setupAcceptedSocket(asio::ip::tcp::socket &s)
+{
+	LatencyProfile const &profile = Server::instance().getLatencyProfile();
+
+	system::error_code err;
+	if(profile.lowLatency)
+	{
+		s.set_option(asio::ip::tcp::no_delay(true), err);
+		if(err)
+			SHARD_LOG(warning) << "failed to set TCP_NODELAY: " << err;
+	}
+
+	if(profile.busyPollUSec)
+	{
+#if defined(SO_BUSY_POLL)
+		s.set_option(busy_poll(static_cast<int>(profile.busyPollUSec)), err);
+		if(err)
+			SHARD_LOG(warning) << "failed to set SO_BUSY_POLL: " << err;
+#else
+		SHARD_LOG(warning) << "SO_BUSY_POLL is not supported!";
+#endif
+	}
+}
+
+} //namespace srv
@@ -0,0 +1,43 @@
+#ifndef SHARD_HPP
+#define SHARD_HPP
+
+#include "Config.hpp"
+
+#define SHARD_LOG(level) BOOST_LOG_TRIVIAL(level) << "[SHARD] "
+
+namespace srv {
+
+class Connection;
+struct LatencyProfile;
+
+//an io_service with its own acceptor, connections stay on the shard that accepted them
+class Shard
+{
+public:
+	Shard(std::size_t index);
+	~Shard();
+
+	std::size_t index() const;
+	asio::io_service& ios();
+
+	system::error_code startAcceptor(asio::ip::tcp::endpoint const &endpoint, bool reusePort);
+	void stopAcceptor();
+
+	void run(LatencyProfile const &profile);
+	void stop();
+
+private:
+	void doAccept();
+	void setupAcceptedSocket(asio::ip::tcp::socket &s);
+
+private:
+	std::size_t m_Index;
+	asio::io_service m_IOS;
+	asio::io_service::work m_Work;
+	asio::ip::tcp::acceptor m_Acceptor;
+	asio::ip::tcp::socket m_AcceptSocket;
+};
+
+} //namespace srv
+
+#endif //SHARD_HPP
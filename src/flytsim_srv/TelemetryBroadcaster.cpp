@@ -0,0 +1,291 @@
+#include "TelemetryBroadcaster.hpp"
+#include "Connection.hpp"
+#include "Server.hpp"
+#include <algorithm>
+#include <cstdio>
+
+namespace srv {
+
+namespace {
+
+	char const * const TOPIC_NAMES[TelemetryBroadcaster::TOPICS] = { "position", "attitude", "imu", "battery", "global" };
+
+	//FlytOS publishes these under its namespace
+	char const * const ROS_TOPICS[TelemetryBroadcaster::TOPICS] =
+	{
+		"/mavros/local_position/local",
+		"/mavros/imu/data_euler",
+		"/mavros/imu/data",
+		"/mavros/battery",
+		"/mavros/global_position/global"
+	};
+
+	enum { FIELDS_SIZE = 256 };
+	enum { RECORD_SIZE = FIELDS_SIZE + 96 };
+
+} //namespace anonymous
+
+std::uint32_t const TelemetryBroadcaster::ROS_QUEUE;
+
+TelemetryBroadcaster::TelemetryBroadcaster()
+	: m_ROSMutex()
+	, m_ROSHandle()
+	, m_Namespace()
+	, m_ROSTopics(0)
+	, m_ROSSubscribers()
+	, m_SubscribersMutex()
+	, m_Subscribers()
+	, m_Seqs()
+	, m_Updates(0)
+	, m_UpdatesBroadcast(0)
+{
+}
+
+char const* TelemetryBroadcaster::topicName(Topic topic)
+{
+	return topic < TOPICS ? TOPIC_NAMES[topic] : "unknown";
+}
+
+bool TelemetryBroadcaster::parseTopic(std::string const &name, Topic &topic)
+{
+	for(int t = 0; t < TOPICS; ++t)
+	{
+		if(name == TOPIC_NAMES[t])
+		{
+			topic = static_cast<Topic>(t);
+			return true;
+		}
+	}
+	return false;
+}
+
+void TelemetryBroadcaster::start(std::shared_ptr<ros::NodeHandle> const &handle, std::string const &ns)
+{
+	std::uint32_t demanded = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_SubscribersMutex);
+		for(Subscriber const &subscriber : m_Subscribers)
+			demanded |= subscriber.topics;
+	}
+
+	std::lock_guard<std::mutex> lock(m_ROSMutex);
+	m_ROSHandle = handle;
+	m_Namespace = ns;
+	subscribeTopics(demanded);
+}
+
+void TelemetryBroadcaster::stop()
+{
+	std::lock_guard<std::mutex> lock(m_ROSMutex);
+	for(int t = 0; t < TOPICS; ++t)
+	{
+		if(m_ROSTopics & (1u << t))
+			m_ROSSubscribers[t].shutdown();
+		m_ROSSubscribers[t] = ros::Subscriber();
+	}
+	m_ROSTopics = 0;
+	m_ROSHandle.reset();
+}
+
+void TelemetryBroadcaster::subscribe(std::shared_ptr<Connection> const &conn, std::uint32_t topics, optional<float> const &rate)
+{
+	std::chrono::steady_clock::duration interval = rate ?
+		std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(1.0f / rate.get())) :
+		std::chrono::steady_clock::duration::zero();
+
+	{
+		std::lock_guard<std::mutex> lock(m_SubscribersMutex);
+		bool found = false;
+		for(Subscriber &subscriber : m_Subscribers)
+		{
+			if(subscriber.conn.lock() == conn)
+			{
+				subscriber.topics = topics;
+				subscriber.interval = interval;
+				found = true;
+				break;
+			}
+		}
+
+		if(!found)
+		{
+			Subscriber subscriber;
+			subscriber.conn = conn;
+			subscriber.topics = topics;
+			subscriber.interval = interval;
+			m_Subscribers.push_back(subscriber);
+		}
+	}
+
+	//topics stay subscribed once demanded, updates nobody wants are not encoded
+	std::lock_guard<std::mutex> lock(m_ROSMutex);
+	subscribeTopics(topics);
+}
+
+void TelemetryBroadcaster::unsubscribe(Connection const *conn)
+{
+	std::lock_guard<std::mutex> lock(m_SubscribersMutex);
+	m_Subscribers.erase(
+		std::remove_if(
+			m_Subscribers.begin(),
+			m_Subscribers.end(),
+			[conn](Subscriber const &subscriber)
+			{
+				std::shared_ptr<Connection> locked = subscriber.conn.lock();
+				return !locked || locked.get() == conn;
+			}
+		),
+		m_Subscribers.end()
+	);
+}
+
+std::uint64_t TelemetryBroadcaster::updates() const
+{
+	return m_Updates.load(boost::memory_order_relaxed);
+}
+
+std::uint64_t TelemetryBroadcaster::updatesBroadcast() const
+{
+	return m_UpdatesBroadcast.load(boost::memory_order_relaxed);
+}
+
+void TelemetryBroadcaster::subscribeTopics(std::uint32_t topics)
+{
+	if(!m_ROSHandle)
+		return;
+
+	for(int t = 0; t < TOPICS; ++t)
+	{
+		std::uint32_t bit = 1u << t;
+		if(!(topics & bit) || (m_ROSTopics & bit))
+			continue;
+
+		std::string topic = m_Namespace + ROS_TOPICS[t];
+		SERVER_LOG(info) << "subscribing telemetry " << TOPIC_NAMES[t] << ": " << topic;
+		switch(t)
+		{
+		case POSITION:
+			m_ROSSubscribers[t] = m_ROSHandle->subscribe(topic, ROS_QUEUE, &TelemetryBroadcaster::onPosition, this);
+			break;
+
+		case ATTITUDE:
+			m_ROSSubscribers[t] = m_ROSHandle->subscribe(topic, ROS_QUEUE, &TelemetryBroadcaster::onAttitude, this);
+			break;
+
+		case IMU:
+			m_ROSSubscribers[t] = m_ROSHandle->subscribe(topic, ROS_QUEUE, &TelemetryBroadcaster::onImu, this);
+			break;
+
+		case BATTERY:
+			m_ROSSubscribers[t] = m_ROSHandle->subscribe(topic, ROS_QUEUE, &TelemetryBroadcaster::onBattery, this);
+			break;
+
+		case GLOBAL:
+			m_ROSSubscribers[t] = m_ROSHandle->subscribe(topic, ROS_QUEUE, &TelemetryBroadcaster::onGlobal, this);
+			break;
+		}
+		m_ROSTopics |= bit;
+	}
+}
+
+void TelemetryBroadcaster::onPosition(geometry_msgs::TwistStampedConstPtr const &msg)
+{
+	//FlytOS carries the position in linear and the velocity in angular
+	geometry_msgs::Vector3 const &p = msg->twist.linear;
+	geometry_msgs::Vector3 const &v = msg->twist.angular;
+	char fields[FIELDS_SIZE];
+	std::snprintf(fields, sizeof(fields), "position:{%.7g,%.7g,%.7g} velocity:{%.7g,%.7g,%.7g}", p.x, p.y, p.z, v.x, v.y, v.z);
+	broadcast(POSITION, msg->header.stamp, fields);
+}
+
+void TelemetryBroadcaster::onAttitude(geometry_msgs::TwistStampedConstPtr const &msg)
+{
+	geometry_msgs::Vector3 const &a = msg->twist.linear;
+	geometry_msgs::Vector3 const &r = msg->twist.angular;
+	char fields[FIELDS_SIZE];
+	std::snprintf(fields, sizeof(fields), "rpy:{%.7g,%.7g,%.7g} rates:{%.7g,%.7g,%.7g}", a.x, a.y, a.z, r.x, r.y, r.z);
+	broadcast(ATTITUDE, msg->header.stamp, fields);
+}
+
+void TelemetryBroadcaster::onImu(sensor_msgs::ImuConstPtr const &msg)
+{
+	geometry_msgs::Quaternion const &o = msg->orientation;
+	geometry_msgs::Vector3 const &w = msg->angular_velocity;
+	geometry_msgs::Vector3 const &a = msg->linear_acceleration;
+	char fields[FIELDS_SIZE];
+	std::snprintf(fields, sizeof(fields),
+		"orientation:{%.7g,%.7g,%.7g,%.7g} angular_velocity:{%.7g,%.7g,%.7g} linear_acceleration:{%.7g,%.7g,%.7g}",
+		o.x, o.y, o.z, o.w, w.x, w.y, w.z, a.x, a.y, a.z);
+	broadcast(IMU, msg->header.stamp, fields);
+}
+
+void TelemetryBroadcaster::onBattery(sensor_msgs::BatteryStateConstPtr const &msg)
+{
+	char fields[FIELDS_SIZE];
+	std::snprintf(fields, sizeof(fields), "voltage:%.7g current:%.7g remaining:%.7g", msg->voltage, msg->current, msg->percentage);
+	broadcast(BATTERY, msg->header.stamp, fields);
+}
+
+void TelemetryBroadcaster::onGlobal(sensor_msgs::NavSatFixConstPtr const &msg)
+{
+	char fields[FIELDS_SIZE];
+	std::snprintf(fields, sizeof(fields), "latitude:%.10g longitude:%.10g altitude:%.7g", msg->latitude, msg->longitude, msg->altitude);
+	broadcast(GLOBAL, msg->header.stamp, fields);
+}
+
+void TelemetryBroadcaster::broadcast(Topic topic, ros::Time const &stamp, char const *fields)
+{
+	m_Updates.fetch_add(1, boost::memory_order_relaxed);
+
+	std::uint32_t bit = 1u << topic;
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	std::vector< std::shared_ptr<Connection> > recipients;
+	std::uint64_t seq = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_SubscribersMutex);
+		for(Subscriber &subscriber : m_Subscribers)
+		{
+			if(!(subscriber.topics & bit))
+				continue;
+
+			//decimated per connection, the first update of a topic always goes out
+			std::chrono::steady_clock::time_point const &last = subscriber.lastPush[topic];
+			if(last != std::chrono::steady_clock::time_point() && now - last < subscriber.interval)
+				continue;
+
+			std::shared_ptr<Connection> conn = subscriber.conn.lock();
+			if(!conn)
+				continue;
+
+			subscriber.lastPush[topic] = now;
+			recipients.push_back(conn);
+		}
+
+		if(recipients.empty())
+			return;
+		seq = ++m_Seqs[topic];
+	}
+
+	char record[RECORD_SIZE];
+	int size = std::snprintf(
+		record,
+		sizeof(record),
+		"push:telemetry\r\ntopic:%s seq:%llu stamp:%u.%09u %s\r\n",
+		TOPIC_NAMES[topic],
+		static_cast<unsigned long long>(seq),
+		static_cast<unsigned>(stamp.sec),
+		static_cast<unsigned>(stamp.nsec),
+		fields
+	);
+	//a cut record would break the framing of the stream
+	if(size <= 0 || static_cast<std::size_t>(size) >= sizeof(record))
+		return;
+
+	TelemetryRecordPtr shared = std::make_shared<std::string const>(record, size);
+	for(std::shared_ptr<Connection> const &conn : recipients)
+		conn->pushTelemetry(topic, shared);
+
+	m_UpdatesBroadcast.fetch_add(1, boost::memory_order_relaxed);
+}
+
+} //namespace srv
@@ -0,0 +1,86 @@
+#ifndef TELEMETRY_BROADCASTER_HPP
+#define TELEMETRY_BROADCASTER_HPP
+
+#include "Config.hpp"
+
+namespace srv {
+
+class Connection;
+
+//a pushed telemetry update, framing included, shared by every connection it is written to
+typedef std::shared_ptr<std::string const> TelemetryRecordPtr;
+
+//subscribes the FlytOS telemetry topics on demand and encodes every update once for all its subscribers
+class TelemetryBroadcaster
+{
+public:
+	enum Topic
+	{
+		POSITION,	//local position and velocity
+		ATTITUDE,	//roll, pitch, yaw and their rates
+		IMU,
+		BATTERY,
+		GLOBAL,		//latitude, longitude and altitude
+		TOPICS
+	};
+
+	//newer updates of a topic replace one queued by ROS
+	static std::uint32_t const ROS_QUEUE = 1;
+
+	TelemetryBroadcaster();
+
+	static char const* topicName(Topic topic);
+	//false for an unknown name
+	static bool parseTopic(std::string const &name, Topic &topic);
+
+	//the topics are looked up under ns, e.g. ns/mavros/imu/data
+	void start(std::shared_ptr<ros::NodeHandle> const &handle, std::string const &ns);
+	void stop();
+
+	//topics is a mask of 1 << Topic, subscribing again replaces it, a rate limits the updates per second of every topic
+	//the rate is validated by the connection, the interval it gives must fit a steady_clock duration
+	void subscribe(std::shared_ptr<Connection> const &conn, std::uint32_t topics, optional<float> const &rate);
+	void unsubscribe(Connection const *conn);
+
+	std::uint64_t updates() const;
+	std::uint64_t updatesBroadcast() const;
+
+private:
+	void subscribeTopics(std::uint32_t topics);
+
+	void onPosition(geometry_msgs::TwistStampedConstPtr const &msg);
+	void onAttitude(geometry_msgs::TwistStampedConstPtr const &msg);
+	void onImu(sensor_msgs::ImuConstPtr const &msg);
+	void onBattery(sensor_msgs::BatteryStateConstPtr const &msg);
+	void onGlobal(sensor_msgs::NavSatFixConstPtr const &msg);
+	//fields are the topic specific part of the record
+	void broadcast(Topic topic, ros::Time const &stamp, char const *fields);
+
+private:
+	struct Subscriber
+	{
+		std::weak_ptr<Connection> conn;
+		std::uint32_t topics;
+		std::chrono::steady_clock::duration interval;
+		std::chrono::steady_clock::time_point lastPush[TOPICS];
+	};
+
+private:
+	//ROS is subscribed and shut down under its own mutex, callbacks never take it
+	std::mutex m_ROSMutex;
+	std::shared_ptr<ros::NodeHandle> m_ROSHandle;
+	std::string m_Namespace;
+	std::uint32_t m_ROSTopics;
+	ros::Subscriber m_ROSSubscribers[TOPICS];
+
+	std::mutex m_SubscribersMutex;
+	std::vector<Subscriber> m_Subscribers;
+	std::uint64_t m_Seqs[TOPICS];
+
+	atomic<std::uint64_t> m_Updates;
+	atomic<std::uint64_t> m_UpdatesBroadcast;
+};
+
+} //namespace srv
+
+#endif //TELEMETRY_BROADCASTER_HPP
@@ -0,0 +1,172 @@
+#include "TileDelta.hpp"
+#include <sensor_msgs/image_encodings.h>
+#include <stdexcept>
+#include <cstring>
+
+namespace srv {
+
+namespace {
+
+	std::uint64_t const PRIME1 = 0x9e3779b185ebca87ULL;
+	std::uint64_t const PRIME2 = 0xc2b2ae3d27d4eb4fULL;
+	std::uint64_t const PRIME3 = 0x165667b19e3779f9ULL;
+
+	inline std::uint64_t rotl(std::uint64_t v, int bits)
+	{
+		return (v << bits) | (v >> (64 - bits));
+	}
+
+	inline std::uint64_t mix(std::uint64_t acc, std::uint64_t word)
+	{
+		return rotl(acc + word * PRIME2, 31) * PRIME1;
+	}
+
+	inline std::uint64_t load64(std::uint8_t const *p)
+	{
+		std::uint64_t v;
+		std::memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	//four independent lanes over 32 byte blocks, the multiplies of a block do not wait on each other
+	std::uint64_t hashTile(std::uint8_t const *data, std::size_t step, std::size_t rowSize, std::uint32_t rows)
+	{
+		std::uint64_t lanes[4] = { PRIME1 + PRIME2, PRIME2, 0, 0 - PRIME1 };
+		std::uint64_t tail = PRIME3;
+		for(std::uint32_t y = 0; y < rows; ++y)
+		{
+			std::uint8_t const *row = data + y * step;
+			std::size_t i = 0;
+			for(; i + 32 <= rowSize; i += 32)
+			{
+				lanes[0] = mix(lanes[0], load64(row + i));
+				lanes[1] = mix(lanes[1], load64(row + i + 8));
+				lanes[2] = mix(lanes[2], load64(row + i + 16));
+				lanes[3] = mix(lanes[3], load64(row + i + 24));
+			}
+			for(; i + 8 <= rowSize; i += 8)
+				tail = mix(tail, load64(row + i));
+			for(; i < rowSize; ++i)
+				tail = rotl(tail ^ (row[i] * PRIME3), 11) * PRIME1;
+		}
+
+		std::uint64_t hash = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18) + tail;
+		hash ^= hash >> 33;
+		hash *= PRIME2;
+		hash ^= hash >> 29;
+		return hash;
+	}
+
+	bool pixelSize(std::string const &encoding, std::uint32_t &size)
+	{
+		namespace enc = sensor_msgs::image_encodings;
+		try
+		{
+			std::uint32_t bits = static_cast<std::uint32_t>(enc::numChannels(encoding) * enc::bitDepth(encoding));
+			size = bits / 8;
+			return bits && bits % 8 == 0;
+		}
+		catch(std::runtime_error const &)
+		{
+			return false;
+		}
+	}
+
+	std::uint32_t tiles(std::uint32_t size)
+	{
+		return (size + DELTA_TILE_SIZE - 1) / DELTA_TILE_SIZE;
+	}
+
+} //namespace anonymous
+
+bool TileHashes::supports(std::string const &encoding)
+{
+	std::uint32_t size = 0;
+	return pixelSize(encoding, size);
+}
+
+TileHashes::TileHashes()
+	: m_Width(0)
+	, m_Height(0)
+	, m_PixelSize(0)
+	, m_Encoding()
+	, m_Hashes()
+{
+}
+
+system::error_code TileHashes::compute(Frame const &frame)
+{
+	if(!pixelSize(frame.encoding, m_PixelSize))
+	{
+		clear();
+		return make_error_code(system::errc::not_supported);
+	}
+
+	m_Width = frame.width;
+	m_Height = frame.height;
+	m_Encoding = frame.encoding;
+
+	std::uint32_t columns = tiles(m_Width);
+	m_Hashes.resize(std::size_t(columns) * tiles(m_Height));
+	for(std::size_t t = 0; t < m_Hashes.size(); ++t)
+	{
+		std::uint32_t x = static_cast<std::uint32_t>(t % columns) * DELTA_TILE_SIZE;
+		std::uint32_t y = static_cast<std::uint32_t>(t / columns) * DELTA_TILE_SIZE;
+		std::uint32_t w = std::min(DELTA_TILE_SIZE, m_Width - x);
+		std::uint32_t h = std::min(DELTA_TILE_SIZE, m_Height - y);
+		m_Hashes[t] = hashTile(frame.data + std::size_t(y) * frame.step + std::size_t(x) * m_PixelSize, frame.step, std::size_t(w) * m_PixelSize, h);
+	}
+	return system::error_code();
+}
+
+void TileHashes::clear()
+{
+	m_Width = 0;
+	m_Height = 0;
+	m_PixelSize = 0;
+	m_Encoding.clear();
+	m_Hashes.clear();
+}
+
+bool TileHashes::matches(TileHashes const &other) const
+{
+	return !m_Hashes.empty() && m_Width == other.m_Width && m_Height == other.m_Height && m_Encoding == other.m_Encoding;
+}
+
+std::size_t TileHashes::writeChanged(Frame const &frame, TileHashes const &previous, std::vector<std::uint8_t> &delta) const
+{
+	delta.clear();
+	std::size_t changed = 0;
+	std::uint32_t columns = tiles(m_Width);
+	for(std::size_t t = 0; t < m_Hashes.size(); ++t)
+	{
+		if(m_Hashes[t] == previous.m_Hashes[t])
+			continue;
+
+		std::uint32_t x = static_cast<std::uint32_t>(t % columns) * DELTA_TILE_SIZE;
+		std::uint32_t y = static_cast<std::uint32_t>(t / columns) * DELTA_TILE_SIZE;
+		std::size_t rowSize = std::size_t(std::min(DELTA_TILE_SIZE, m_Width - x)) * m_PixelSize;
+		std::uint32_t h = std::min(DELTA_TILE_SIZE, m_Height - y);
+
+		std::size_t offset = delta.size();
+		delta.resize(offset + 4 + rowSize * h);
+		std::uint8_t *out = delta.data() + offset;
+		*out++ = static_cast<std::uint8_t>(t >> 24);
+		*out++ = static_cast<std::uint8_t>(t >> 16);
+		*out++ = static_cast<std::uint8_t>(t >> 8);
+		*out++ = static_cast<std::uint8_t>(t);
+
+		std::uint8_t const *in = frame.data + std::size_t(y) * frame.step + std::size_t(x) * m_PixelSize;
+		for(std::uint32_t r = 0; r < h; ++r, out += rowSize)
+			std::memcpy(out, in + r * frame.step, rowSize);
+		++changed;
+	}
+	return changed;
+}
+
+std::size_t TileHashes::count() const
+{
+	return m_Hashes.size();
+}
+
+} //namespace srv
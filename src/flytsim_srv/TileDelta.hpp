@@ -0,0 +1,45 @@
+#ifndef TILE_DELTA_HPP
+#define TILE_DELTA_HPP
+
+#include "Config.hpp"
+#include "Frame.hpp"
+
+namespace srv {
+
+//square tiles compared for get_image delta:, edge tiles are clipped to the frame
+std::uint32_t const DELTA_TILE_SIZE = 64;
+//a full frame is sent after that many deltas, a lost base does not last forever
+std::uint32_t const DELTA_KEYFRAME_INTERVAL = 100;
+
+//64 bit hash of every tile of a frame, the pixels themselves are not kept
+class TileHashes
+{
+public:
+	TileHashes();
+
+	//false for planar and bit packed encodings, checked before a frame is transformed for a delta
+	static bool supports(std::string const &encoding);
+
+	//not_supported for planar and bit packed encodings
+	system::error_code compute(Frame const &frame);
+	void clear();
+
+	//same size and encoding, the tiles line up
+	bool matches(TileHashes const &other) const;
+
+	//big endian tile index followed by the tile rows for every tile that differs from previous
+	std::size_t writeChanged(Frame const &frame, TileHashes const &previous, std::vector<std::uint8_t> &delta) const;
+
+	std::size_t count() const;
+
+private:
+	std::uint32_t m_Width;
+	std::uint32_t m_Height;
+	std::uint32_t m_PixelSize;
+	std::string m_Encoding;
+	std::vector<std::uint64_t> m_Hashes;
+};
+
+} //namespace srv
+
+#endif //TILE_DELTA_HPP
@@ -0,0 +1,90 @@
+#include "WorkerPool.hpp"
+
+namespace srv {
+
+WorkerPool::WorkerPool()
+	: m_IOS()
+	, m_Work()
+	, m_Threads()
+{
+}
+
+WorkerPool::~WorkerPool()
+{
+	stop();
+}
+
+system::error_code WorkerPool::start(std::size_t count, CpuSet const &cpus)
+{
+	if(!m_Threads.empty())
+		return make_error_code(system::errc::already_connected);
+
+	m_IOS.reset();
+	m_Work.reset(new asio::io_service::work(m_IOS));
+	for(std::size_t w = 0; w < count; ++w)
+		m_Threads.emplace_back(&WorkerPool::run, this, w, count, cpus);
+
+	return system::error_code();
+}
+
+void WorkerPool::stop()
+{
+	m_Work.reset();
+	m_IOS.stop();
+	for(std::thread &thread : m_Threads)
+		thread.join();
+	m_Threads.clear();
+}
+
+std::size_t WorkerPool::size() const
+{
+	return m_Threads.size();
+}
+
+WorkerPool::ParallelFor::ParallelFor(std::size_t count, std::function<void (std::size_t)> f)
+	: f(std::move(f))
+	, count(count)
+	, next(0)
+	, done(0)
+	, mutex()
+	, finished()
+{
+}
+
+void WorkerPool::ParallelFor::run()
+{
+	//a helper that starts after the caller took all items just returns
+	std::size_t completed = 0;
+	for(std::size_t i = next++; i < count; i = next++)
+	{
+		f(i);
+		++completed;
+	}
+
+	if(completed && (done += completed) == count)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		finished.notify_all();
+	}
+}
+
+void WorkerPool::ParallelFor::wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	finished.wait(lock, [this] { return done == count; });
+}
+
+void WorkerPool::run(std::size_t index, std::size_t count, CpuSet const &cpus)
+{
+	//like the shards, several workers spread over the cpu set one per cpu
+	CpuSet workerCpus = cpus;
+	if(count > 1 && cpus.size() > 1)
+		workerCpus = CpuSet(1, cpus[index % cpus.size()]);
+
+	if(system::error_code ae = setThreadAffinity(workerCpus))
+		WORKER_LOG(warning) << "failed to set affinity of worker " << index << ": " << ae;
+
+	m_IOS.run();
+}
+
+} //namespace srv
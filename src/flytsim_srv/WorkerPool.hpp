@@ -0,0 +1,77 @@
+#ifndef WORKER_POOL_HPP
+#define WORKER_POOL_HPP
+
+#include "Config.hpp"
+#include "Affinity.hpp"
+#include <thread>
+#include <condition_variable>
+
+#define WORKER_LOG(level) BOOST_LOG_TRIVIAL(level) << "[WORKER] "
+
+namespace srv {
+
+//threads for cpu heavy work kept off the io and ROS threads
+class WorkerPool
+{
+public:
+	WorkerPool();
+	~WorkerPool();
+
+	system::error_code start(std::size_t count, CpuSet const &cpus);
+	void stop();
+
+	std::size_t size() const;
+
+	template <typename Handler>
+	void post(Handler handler)
+	{
+		m_IOS.post(std::move(handler));
+	}
+
+	//calls f(i) for i in [0, count), items are claimed one by one by idle workers and the caller,
+	//returns once all are done, so it may be called from a worker too
+	template <typename Function>
+	void parallelFor(std::size_t count, Function f)
+	{
+		if(count < 2 || m_Threads.empty())
+		{
+			for(std::size_t i = 0; i < count; ++i)
+				f(i);
+			return;
+		}
+
+		std::shared_ptr<ParallelFor> pf = std::make_shared<ParallelFor>(count, std::function<void (std::size_t)>(std::move(f)));
+		std::size_t helpers = std::min(count - 1, m_Threads.size());
+		for(std::size_t h = 0; h < helpers; ++h)
+			m_IOS.post([pf] { pf->run(); });
+		pf->run();
+		pf->wait();
+	}
+
+private:
+	struct ParallelFor
+	{
+		ParallelFor(std::size_t count, std::function<void (std::size_t)> f);
+
+		void run();
+		void wait();
+
+		std::function<void (std::size_t)> f;
+		std::size_t count;
+		atomic<std::size_t> next;
+		atomic<std::size_t> done;
+		std::mutex mutex;
+		std::condition_variable finished;
+	};
+
+	void run(std::size_t index, std::size_t count, CpuSet const &cpus);
+
+private:
+	asio::io_service m_IOS;
+	std::unique_ptr<asio::io_service::work> m_Work;
+	std::vector<std::thread> m_Threads;
+};
+
+} //namespace srv
+
+#endif //WORKER_POOL_HPP
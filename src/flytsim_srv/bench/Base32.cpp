@@ -0,0 +1,111 @@
+//measures the base32 kernels on random payloads of frame sizes, the stream coders are the baseline
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "../Base32.hpp"
+
+namespace po = boost::program_options;
+
+template <typename Function>
+static double secondsPerRun(std::size_t runs, Function function)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(std::size_t r = 0; r < runs; ++r)
+		function();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / runs;
+}
+
+static void report(std::string const &name, std::size_t size, double encodeSeconds, double decodeSeconds)
+{
+	double gb = size / 1e9;
+	std::cout << "  " << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(2) <<
+		" encode:" << std::setw(7) << gb / encodeSeconds << " GB/s" <<
+		" decode:" << std::setw(7) << gb / decodeSeconds << " GB/s\n";
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<std::size_t> poSizes;
+	std::size_t poRuns;
+
+	po::options_description desc("Allowed options");
+	desc.add_options()
+		("help", "produce help message")
+		("sizes", po::value< std::vector<std::size_t> >(&poSizes)->multitoken()->default_value(std::vector<std::size_t>{ 640 * 480 * 3, 1920 * 1080 * 3, 3840 * 2160 * 3 }, "vga, 1080p and 4k rgb8"), "payload sizes in bytes")
+		("runs,n", po::value<std::size_t>(&poRuns)->default_value(20), "timed runs per size and kernel");
+
+	po::variables_map vm;
+	try
+	{
+		po::store(po::parse_command_line(argc, argv, desc), vm);
+		if(vm.count("help"))
+		{
+			std::cout << "Usage: flytsim_srv_bench_base32 [options]\n" << desc;
+			return 0;
+		}
+		po::notify(vm);
+	}
+	catch(std::exception &e)
+	{
+		std::cout << e.what() << "\n" << desc;
+		return 1;
+	}
+
+	std::mt19937 random(5);
+	for(std::size_t size : poSizes)
+	{
+		std::vector<std::uint8_t> data(size), decoded(size);
+		for(std::uint8_t &byte : data)
+			byte = static_cast<std::uint8_t>(random());
+		std::string text(srv::base32::encodedSize(size), '\0');
+
+		std::cout << size << " bytes\n";
+
+		double streamEncode = secondsPerRun(poRuns, [&]() {
+			std::ostringstream oss;
+			srv::base32::encode(data.data(), size, oss);
+		});
+		srv::base32::encode(data.data(), size, &text[0]);
+		double streamDecode = secondsPerRun(poRuns, [&]() {
+			std::istringstream iss(text);
+			srv::base32::decode(decoded.data(), size, iss);
+		});
+		report("stream", size, streamEncode, streamDecode);
+
+		//every kernel has to produce the text of the scalar one
+		srv::base32::setKernel(srv::base32::SCALAR);
+		srv::base32::encode(data.data(), size, &text[0]);
+		std::string const reference = text;
+
+		for(int k = srv::base32::SCALAR; k < srv::base32::KERNELS; ++k)
+		{
+			srv::base32::Kernel kernel = static_cast<srv::base32::Kernel>(k);
+			if(!srv::base32::setKernel(kernel))
+			{
+				std::cout << "  " << srv::base32::kernelName(kernel) << " not supported by this cpu\n";
+				continue;
+			}
+
+			srv::base32::encode(data.data(), size, &text[0]);
+			if(text != reference || !srv::base32::decode(text.data(), text.size(), decoded.data(), size) || decoded != data)
+			{
+				std::cout << "  " << srv::base32::kernelName(kernel) << " round trip mismatch\n";
+				return 1;
+			}
+
+			double encode = secondsPerRun(poRuns, [&]() { srv::base32::encode(data.data(), size, &text[0]); });
+			double decode = secondsPerRun(poRuns, [&]() { srv::base32::decode(text.data(), text.size(), decoded.data(), size); });
+			report(srv::base32::kernelName(kernel), size, encode, decode);
+		}
+	}
+	return 0;
+}
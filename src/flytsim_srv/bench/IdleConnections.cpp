@@ -0,0 +1,116 @@
+//opens many idle connections to a running flytsim_srv and reports its resident memory per connection
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/program_options.hpp>
+
+namespace asio = boost::asio;
+namespace po = boost::program_options;
+
+static std::size_t readRSSKiB(int pid)
+{
+	std::ifstream status("/proc/" + std::to_string(pid) + "/status");
+	std::string key;
+	while(status >> key)
+	{
+		if(key == "VmRSS:")
+		{
+			std::size_t kib = 0;
+			status >> kib;
+			return kib;
+		}
+		status.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	std::string poAddress;
+	int poPort;
+	int poPid;
+	std::size_t poCount;
+	bool poWarmup;
+	int poSettleMs;
+
+	po::options_description desc("Allowed options");
+	desc.add_options()
+		("help", "produce help message")
+		("address,a", po::value<std::string>(&poAddress)->default_value("127.0.0.1"), "server address")
+		("port,p", po::value<int>(&poPort)->default_value(12321), "server port")
+		("pid", po::value<int>(&poPid)->required(), "server process id, used to sample its VmRSS")
+		("count,n", po::value<std::size_t>(&poCount)->default_value(1000), "number of idle connections")
+		("warmup", po::bool_switch(&poWarmup), "send one request on every connection before idling")
+		("settle", po::value<int>(&poSettleMs)->default_value(1000), "milliseconds to wait before sampling");
+
+	po::variables_map vm;
+	try
+	{
+		po::store(po::command_line_parser(argc, argv).options(desc).run(), vm);
+		if(vm.count("help"))
+		{
+			std::cout << "Usage: flytsim_srv_bench_idle [options]\n" << desc;
+			return 0;
+		}
+		po::notify(vm);
+	}
+	catch(std::exception &e)
+	{
+		std::cout << e.what() << "\n" << desc;
+		return 1;
+	}
+
+	asio::io_service ios;
+	asio::ip::tcp::endpoint endpoint(asio::ip::address::from_string(poAddress), poPort);
+
+	std::size_t rssBefore = readRSSKiB(poPid);
+
+	std::vector< std::unique_ptr<asio::ip::tcp::socket> > sockets;
+	sockets.reserve(poCount);
+	for(std::size_t c = 0; c < poCount; ++c)
+	{
+		std::unique_ptr<asio::ip::tcp::socket> s(new asio::ip::tcp::socket(ios));
+		boost::system::error_code err;
+		s->connect(endpoint, err);
+		if(err)
+		{
+			std::cout << "connection " << c << " failed: " << err.message() << "\n";
+			break;
+		}
+
+		if(poWarmup)
+		{
+			//unknown command, the server answers with a parse error and goes idle again
+			asio::write(*s, asio::buffer(std::string("noop\r\n")), err);
+			asio::streambuf response;
+			asio::read_until(*s, response, "\r\n\r\n", err);
+		}
+		sockets.push_back(std::move(s));
+	}
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(poSettleMs));
+	std::size_t rssAfter = readRSSKiB(poPid);
+
+	std::cout << "connections:    " << sockets.size() << "\n";
+	std::cout << "rss before:     " << rssBefore << " KiB\n";
+	std::cout << "rss after:      " << rssAfter << " KiB\n";
+	if(!sockets.empty())
+	{
+		double perConnection = (static_cast<double>(rssAfter) - static_cast<double>(rssBefore)) * 1024.0 / sockets.size();
+		std::cout << "rss/connection: " << static_cast<std::int64_t>(perConnection) << " bytes\n";
+	}
+	return 0;
+}
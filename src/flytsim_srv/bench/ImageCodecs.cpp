@@ -0,0 +1,161 @@
+//compares the ratio and speed of the get_image formats on recorded frames, PPM (rgb8) or PGM (mono8) files
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "../Frame.hpp"
+#include "../Jpeg.hpp"
+#include "../Qoi.hpp"
+
+namespace po = boost::program_options;
+
+struct Image
+{
+	std::string encoding;
+	std::uint32_t width;
+	std::uint32_t height;
+	std::uint32_t channels;
+	std::vector<std::uint8_t> pixels;
+};
+
+static bool readPnm(std::string const &path, Image &image)
+{
+	std::ifstream is(path, std::ios::binary);
+	std::string magic;
+	unsigned maxval = 0;
+	is >> magic >> image.width >> image.height >> maxval;
+	is.get();
+	if(!is || maxval != 255 || (magic != "P5" && magic != "P6"))
+		return false;
+
+	image.channels = magic == "P5" ? 1 : 3;
+	image.encoding = magic == "P5" ? "mono8" : "rgb8";
+	image.pixels.resize(std::size_t(image.width) * image.height * image.channels);
+	is.read(reinterpret_cast<char *>(image.pixels.data()), image.pixels.size());
+	return static_cast<bool>(is);
+}
+
+template <typename Function>
+static double secondsPerRun(std::size_t runs, Function function)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(std::size_t r = 0; r < runs; ++r)
+		function();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / runs;
+}
+
+static void report(std::string const &name, std::size_t rawSize, std::size_t size, double encodeSeconds, double decodeSeconds)
+{
+	double mb = rawSize / 1e6;
+	std::cout << "  " << std::left << std::setw(10) << name << std::right <<
+		" size:" << std::setw(10) << size <<
+		" ratio:" << std::setw(7) << std::fixed << std::setprecision(2) << double(rawSize) / size << std::setprecision(1);
+	if(encodeSeconds > 0)
+		std::cout << " encode:" << std::setw(8) << mb / encodeSeconds << " MB/s";
+	if(decodeSeconds > 0)
+		std::cout << " decode:" << std::setw(8) << mb / decodeSeconds << " MB/s";
+	std::cout << "\n";
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<std::string> poFrames;
+	std::size_t poRuns;
+	int poQuality;
+
+	po::options_description desc("Allowed options");
+	desc.add_options()
+		("help", "produce help message")
+		("frames", po::value< std::vector<std::string> >(&poFrames)->required(), "recorded frames, binary PPM or PGM")
+		("runs,n", po::value<std::size_t>(&poRuns)->default_value(20), "timed runs per frame and format")
+		("quality,q", po::value<int>(&poQuality)->default_value(srv::jpeg::DEFAULT_QUALITY), "jpeg quality");
+
+	po::positional_options_description positional;
+	positional.add("frames", -1);
+
+	po::variables_map vm;
+	try
+	{
+		po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+		if(vm.count("help"))
+		{
+			std::cout << "Usage: flytsim_srv_bench_codecs [options] frame.ppm...\n" << desc;
+			return 0;
+		}
+		po::notify(vm);
+	}
+	catch(std::exception &e)
+	{
+		std::cout << e.what() << "\n" << desc;
+		return 1;
+	}
+
+	for(std::string const &path : poFrames)
+	{
+		Image image;
+		if(!readPnm(path, image))
+		{
+			std::cout << path << ": not a binary 8 bit PPM or PGM\n";
+			continue;
+		}
+
+		std::size_t rawSize = image.pixels.size();
+		std::cout << path << " " << image.width << "x" << image.height << " " << image.encoding << "\n";
+
+		//sizes are before base32, which adds 3 bytes for every 5 to all formats alike
+		report("raw", rawSize, rawSize, 0, 0);
+
+		srv::resample::Pixels src;
+		src.data = image.pixels.data();
+		src.step = image.width * image.channels;
+		src.width = image.width;
+		src.height = image.height;
+		src.channels = image.channels;
+
+		std::vector<std::uint8_t> qoi, decoded;
+		std::uint32_t width = 0, height = 0;
+		srv::qoi::encode(src, qoi);
+		if(!srv::qoi::decode(qoi.data(), qoi.size(), image.channels, decoded, width, height) || decoded != image.pixels)
+		{
+			std::cout << "  qoi round trip mismatch\n";
+			return 1;
+		}
+		double qoiEncode = secondsPerRun(poRuns, [&]() { srv::qoi::encode(src, qoi); });
+		double qoiDecode = secondsPerRun(poRuns, [&]() { srv::qoi::decode(qoi.data(), qoi.size(), image.channels, decoded, width, height); });
+		report("qoi", rawSize, qoi.size(), qoiEncode, qoiDecode);
+
+		srv::Frame frame;
+		frame.width = image.width;
+		frame.height = image.height;
+		frame.step = static_cast<std::uint32_t>(src.step);
+		frame.encoding = image.encoding;
+		frame.data = image.pixels.data();
+		frame.size = rawSize;
+
+		std::vector<std::uint8_t> jpeg;
+		double jpegEncode = secondsPerRun(poRuns, [&]() { srv::jpeg::compress(frame, poQuality, jpeg); });
+
+		//decoded back to the encoding of the frame, as a compressed camera frame is for get_image
+		srv::Frame compressed = frame;
+		compressed.format = srv::jpeg::FORMAT;
+		compressed.data = jpeg.data();
+		compressed.size = jpeg.size();
+		decoded.resize(rawSize);
+		if(srv::jpeg::decompress(compressed, decoded.data(), frame.step))
+		{
+			std::cout << "  jpeg decode failed\n";
+			return 1;
+		}
+		double jpegDecode = secondsPerRun(poRuns, [&]() { srv::jpeg::decompress(compressed, decoded.data(), frame.step); });
+		report("jpeg q" + std::to_string(poQuality), rawSize, jpeg.size(), jpegEncode, jpegDecode);
+	}
+	return 0;
+}
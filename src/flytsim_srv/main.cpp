@@ -41,7 +41,31 @@ int main(int argc, char *argv[])
 
 	boost::log::trivial::severity_level poLogLevel;
 	int poListenPort;
+	int poShards;
 	std::string poROSMasterUri;
+	bool poLowLatency;
+	int poBusyPoll;
+	std::string poIOCpus;
+	std::string poROSCpus;
+	std::uint32_t poROSThreads;
+	std::uint32_t poImageThreads;
+	std::uint32_t poTelemetryThreads;
+	int poWorkers;
+	std::string poWorkerCpus;
+	std::string poEngine;
+	std::size_t poStackSize;
+	std::size_t poMemoryBudget;
+	std::size_t poHistoryFrames;
+	double poHistorySeconds;
+	std::vector<std::string> poCameraTopics;
+	std::string poCameraTransport;
+	std::uint32_t poCameraQueue;
+	std::uint32_t poCameraIdle;
+	std::string poTelemetryNamespace;
+	std::string poRecord;
+	std::string poPlay;
+	double poPlayRate;
+	bool poPlayLoop;
 	try
 	{
 		po::options_description desc("Allowed options");
@@ -60,10 +84,130 @@ int main(int argc, char *argv[])
 	        	po::value<int>(&poListenPort)->default_value(srv::Server::DEFAULT_LISTEN_PORT),
 	        	"listen on a port number"
 	        )
+			(
+				"shards,s",
+				po::value<int>(&poShards)->default_value(srv::Server::DEFAULT_SHARDS_COUNT),
+				"number of io threads, each with its own SO_REUSEPORT acceptor"
+			)
 	        (
 				"ros,r",
 				po::value<std::string>(&poROSMasterUri)->default_value(srv::Server::DEFAULT_ROS_MASTER_URI),
 				"ROS master uri"
+			)
+			(
+				"low-latency",
+				po::bool_switch(&poLowLatency),
+				"busy-poll the io thread and disable Nagle on accepted sockets"
+			)
+			(
+				"busy-poll",
+				po::value<int>(&poBusyPoll)->default_value(-1),
+				"SO_BUSY_POLL microseconds on accepted sockets (default: 50 with --low-latency, otherwise off)"
+			)
+			(
+				"io-cpus",
+				po::value<std::string>(&poIOCpus),
+				"cpu affinity of the io thread, e.g. 2 or 0-1,4"
+			)
+			(
+				"ros-cpus",
+				po::value<std::string>(&poROSCpus),
+				"cpu affinity of the ROS spinner threads, e.g. 3"
+			)
+			(
+				"ros-threads",
+				po::value<std::uint32_t>(&poROSThreads)->default_value(1),
+				"threads spinning the global ROS callback queue (0: one per core)"
+			)
+			(
+				"image-threads",
+				po::value<std::uint32_t>(&poImageThreads)->default_value(1),
+				"threads spinning the camera callback queue (0: one per core)"
+			)
+			(
+				"telemetry-threads",
+				po::value<std::uint32_t>(&poTelemetryThreads)->default_value(1),
+				"threads spinning the telemetry callback queue (0: one per core)"
+			)
+			(
+				"workers",
+				po::value<int>(&poWorkers)->default_value(srv::Server::DEFAULT_WORKERS_COUNT),
+				"number of threads encoding frames as they arrive (0: encode on the ROS thread)"
+			)
+			(
+				"worker-cpus",
+				po::value<std::string>(&poWorkerCpus),
+				"cpu affinity of the worker threads, e.g. 5-6"
+			)
+			(
+				"engine",
+				po::value<std::string>(&poEngine)->default_value("stackful"),
+				"connection engine: (stackful, stackless)"
+			)
+			(
+				"stack-size",
+				po::value<std::size_t>(&poStackSize)->default_value(0),
+				"coroutine stack size in bytes of the stackful engine (0: boost default)"
+			)
+			(
+				"memory-budget",
+				po::value<std::size_t>(&poMemoryBudget)->default_value(0),
+				"MiB held at most for encoded frames and pending output, image requests over it are rejected (0: unlimited)"
+			)
+			(
+				"history-frames",
+				po::value<std::size_t>(&poHistoryFrames)->default_value(0),
+				"number of recent frames kept for get_image seq: and stamp: (0: only the latest)"
+			)
+			(
+				"history-seconds",
+				po::value<double>(&poHistorySeconds)->default_value(0.0),
+				"drop history frames older than this behind the newest one, needs history-frames (0: no age limit)"
+			)
+			(
+				"camera-topic",
+				po::value< std::vector<std::string> >(&poCameraTopics)->multitoken()->default_value(std::vector<std::string>(1, srv::Server::DEFAULT_CAMERA_TOPIC), srv::Server::DEFAULT_CAMERA_TOPIC),
+				"image topics of the cameras, the first one serves get_image and subscribe_image, get_images cameras: indexes them"
+			)
+			(
+				"camera-transport",
+				po::value<std::string>(&poCameraTransport)->default_value(srv::Server::DEFAULT_CAMERA_TRANSPORT),
+				"raw, or compressed to pass the jpeg of topic/compressed through to clients asking for it as is"
+			)
+			(
+				"camera-queue",
+				po::value<std::uint32_t>(&poCameraQueue)->default_value(srv::Server::DEFAULT_CAMERA_QUEUE),
+				"image_transport subscriber queue depth"
+			)
+			(
+				"camera-idle",
+				po::value<std::uint32_t>(&poCameraIdle)->default_value(srv::Server::DEFAULT_CAMERA_IDLE_SECONDS),
+				"seconds without image requests, waits or subscriptions before the camera is unsubscribed (0: always subscribed)"
+			)
+			(
+				"telemetry-namespace",
+				po::value<std::string>(&poTelemetryNamespace)->default_value(srv::Server::DEFAULT_TELEMETRY_NAMESPACE),
+				"FlytOS namespace of the telemetry topics, e.g. /flytsim for /flytsim/mavros/imu/data"
+			)
+			(
+				"record",
+				po::value<std::string>(&poRecord),
+				"append every camera frame to this file, indexed in file.index"
+			)
+			(
+				"play",
+				po::value<std::string>(&poPlay),
+				"feed the cameras from a recording instead of their topics"
+			)
+			(
+				"play-rate",
+				po::value<double>(&poPlayRate)->default_value(1.0),
+				"times the recorded pace the frames are played at"
+			)
+			(
+				"play-loop",
+				po::bool_switch(&poPlayLoop),
+				"start the recording over after its last frame"
 			);
 
 		po::variables_map vm;
@@ -85,7 +229,94 @@ int main(int argc, char *argv[])
 
 		srv::Server::instance().setPort(poListenPort);
 		srv::Server::instance().setROSMasterUri(poROSMasterUri);
+		srv::Server::instance().setTelemetryNamespace(poTelemetryNamespace);
+
+		if(poShards < 1 || srv::Server::instance().setShardsCount(poShards))
+		{
+			std::cout << "invalid shards: " << poShards << "\n";
+			return 1;
+		}
+
+		if(poWorkers < 0 || srv::Server::instance().setWorkersCount(poWorkers))
+		{
+			std::cout << "invalid workers: " << poWorkers << "\n";
+			return 1;
+		}
 
+		srv::LatencyProfile latencyProfile;
+		latencyProfile.lowLatency = poLowLatency;
+		latencyProfile.busyPollUSec = poBusyPoll >= 0 ? poBusyPoll : (poLowLatency ? 50 : 0);
+		if(srv::parseCpuSet(poIOCpus, latencyProfile.ioCpus))
+		{
+			std::cout << "invalid io-cpus: " << poIOCpus << "\n";
+			return 1;
+		}
+		if(srv::parseCpuSet(poROSCpus, latencyProfile.rosCpus))
+		{
+			std::cout << "invalid ros-cpus: " << poROSCpus << "\n";
+			return 1;
+		}
+		if(srv::parseCpuSet(poWorkerCpus, latencyProfile.workerCpus))
+		{
+			std::cout << "invalid worker-cpus: " << poWorkerCpus << "\n";
+			return 1;
+		}
+		srv::Server::instance().setLatencyProfile(latencyProfile);
+
+		srv::ConnectionProfile connectionProfile;
+		if(poEngine == "stackless")
+			connectionProfile.engine = srv::ConnectionProfile::STACKLESS;
+		else
+		if(poEngine != "stackful")
+		{
+			std::cout << "invalid engine: " << poEngine << "\n";
+			return 1;
+		}
+		connectionProfile.stackSize = poStackSize;
+		if(srv::Server::instance().setConnectionProfile(connectionProfile))
+		{
+			std::cout << "invalid stack-size: " << poStackSize << " (minimum: " << boost::coroutines::stack_traits::minimum_size() << ")\n";
+			return 1;
+		}
+
+		srv::SpinnerProfile spinnerProfile;
+		spinnerProfile.globalThreads = poROSThreads;
+		spinnerProfile.imageThreads = poImageThreads;
+		spinnerProfile.telemetryThreads = poTelemetryThreads;
+		srv::Server::instance().setSpinnerProfile(spinnerProfile);
+
+		srv::Server::instance().memoryBudget().setLimit(poMemoryBudget * 1024 * 1024);
+
+		if(srv::Server::instance().setFrameHistory(poHistoryFrames, poHistorySeconds))
+		{
+			std::cout << "invalid history-seconds: " << poHistorySeconds << " (history-frames: " << poHistoryFrames << ")\n";
+			return 1;
+		}
+
+		std::vector<srv::CameraProfile> cameraProfiles(poCameraTopics.size());
+		for(std::size_t c = 0; c < poCameraTopics.size(); ++c)
+		{
+			cameraProfiles[c].topic = poCameraTopics[c];
+			cameraProfiles[c].transport = poCameraTransport;
+			cameraProfiles[c].queue = poCameraQueue;
+			cameraProfiles[c].idleSeconds = poCameraIdle;
+		}
+		if(srv::Server::instance().setCameraProfiles(cameraProfiles))
+		{
+			std::cout << "invalid camera-topic, camera-transport or camera-queue: " << poCameraTransport << ", " << poCameraQueue << "\n";
+			return 1;
+		}
+
+		srv::RecordingProfile recordingProfile;
+		recordingProfile.recordPath = poRecord;
+		recordingProfile.playPath = poPlay;
+		recordingProfile.playRate = poPlayRate;
+		recordingProfile.playLoop = poPlayLoop;
+		if(srv::Server::instance().setRecordingProfile(recordingProfile))
+		{
+			std::cout << "invalid play-rate or both record and play: " << poPlayRate << "\n";
+			return 1;
+		}
 
 
 	}